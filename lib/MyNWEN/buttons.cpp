@@ -0,0 +1,217 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifdef ARDUINO
+#include "buttons.h"
+
+#include <M5Stack.h>
+#include <esp_sleep.h>
+#include <esp_timer.h>
+
+static const uint8_t BUTTON_PINS[BUTTON_COUNT] = {BUTTON_A_PIN, BUTTON_B_PIN, BUTTON_C_PIN};
+
+/**
+ * A raw edge as seen by the ISR.
+ */
+struct ButtonEdge {
+    uint8_t button;
+    uint8_t level;
+    int64_t atUs;
+};
+
+/**
+ * Debounce states. A new level is only accepted once it has been stable for the debounce
+ * period, which filters contact bounce on both press and release.
+ */
+enum DebounceState : uint8_t {
+    DEBOUNCE_IDLE,
+    DEBOUNCE_PRESSING,
+    DEBOUNCE_PRESSED,
+    DEBOUNCE_RELEASING,
+};
+
+struct ButtonState {
+    DebounceState state;
+    int64_t changedUs;  // time of the last edge
+    int64_t pressedUs;  // time the press was accepted
+};
+
+static QueueHandle_t edgeQueue = NULL;
+static ButtonState buttons[BUTTON_COUNT];
+static int wokenBy = -1;
+static int swallowed = -1;  // the waking press, completed without an event
+static bool polling = false;
+
+/**
+ * GPIO ISR, only records the edge; all decisions happen in the consuming task.
+ */
+static void IRAM_ATTR onButtonEdge(void *arg) {
+    ButtonEdge edge;
+    edge.button = (uint8_t)(uintptr_t)arg;
+    edge.level = (uint8_t)digitalRead(BUTTON_PINS[edge.button]);
+    edge.atUs = esp_timer_get_time();
+
+    BaseType_t woken = pdFALSE;
+    xQueueSendFromISR(edgeQueue, &edge, &woken);
+    if (woken) portYIELD_FROM_ISR();
+}
+
+/**
+ * Feeds a raw edge into the state machine. Buttons are active low.
+ */
+static void feedEdge(const ButtonEdge &edge) {
+    ButtonState &b = buttons[edge.button];
+    bool pressed = edge.level == LOW;
+    b.changedUs = edge.atUs;
+
+    switch (b.state) {
+        case DEBOUNCE_IDLE:
+        case DEBOUNCE_PRESSING:
+            b.state = pressed ? DEBOUNCE_PRESSING : DEBOUNCE_IDLE;
+            break;
+        case DEBOUNCE_PRESSED:
+        case DEBOUNCE_RELEASING:
+            b.state = pressed ? DEBOUNCE_PRESSED : DEBOUNCE_RELEASING;
+            break;
+    }
+}
+
+/**
+ * Promotes any level that has settled. Returns true and fills event on a completed press.
+ */
+static bool settle(int64_t nowUs, ButtonEvent *event) {
+    const int64_t debounceUs = (int64_t)BUTTON_DEBOUNCE_MS * 1000;
+
+    for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+        ButtonState &b = buttons[i];
+        if (nowUs - b.changedUs < debounceUs) continue;
+
+        if (b.state == DEBOUNCE_PRESSING) {
+            b.state = DEBOUNCE_PRESSED;
+            b.pressedUs = b.changedUs;
+        } else if (b.state == DEBOUNCE_RELEASING) {
+            b.state = DEBOUNCE_IDLE;
+            if (swallowed == i) {
+                swallowed = -1;
+                continue;
+            }
+            event->button = (ButtonId)i;
+            event->heldMs = (uint32_t)((b.changedUs - b.pressedUs) / 1000);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Returns the time in microseconds until the next pending level settles, or -1 if none.
+ */
+static int64_t nextSettleUs(int64_t nowUs) {
+    const int64_t debounceUs = (int64_t)BUTTON_DEBOUNCE_MS * 1000;
+    int64_t next = -1;
+
+    for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+        const ButtonState &b = buttons[i];
+        if (b.state != DEBOUNCE_PRESSING && b.state != DEBOUNCE_RELEASING) continue;
+        int64_t left = b.changedUs + debounceUs - nowUs;
+        if (left < 0) left = 0;
+        if (next < 0 || left < next) next = left;
+    }
+    return next;
+}
+
+/**
+ * Feeds an edge for every button whose level disagrees with its state, as after an edge
+ * that arrived while the chip slept.
+ */
+static void pollLevels(int64_t nowUs) {
+    for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+        DebounceState state = buttons[i].state;
+        bool down = state == DEBOUNCE_PRESSING || state == DEBOUNCE_PRESSED;
+        uint8_t level = (uint8_t)digitalRead(BUTTON_PINS[i]);
+        if ((level == LOW) != down) feedEdge({i, level, nowUs});
+    }
+}
+
+void buttonsBegin() {
+    edgeQueue = xQueueCreate(16, sizeof(ButtonEdge));
+
+    int64_t now = esp_timer_get_time();
+    for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+        buttons[i] = {DEBOUNCE_IDLE, now, now};
+        pinMode(BUTTON_PINS[i], INPUT);
+        attachInterruptArg(digitalPinToInterrupt(BUTTON_PINS[i]), onButtonEdge,
+                           (void *)(uintptr_t)i, CHANGE);
+    }
+
+    buttonsWoke();
+}
+
+void buttonsWoke() {
+    // The press that woke us is already held (or has been released) by the time we get
+    // here, so treat it as accepted and let the release, if any, complete it. It only
+    // wakes the node, so the release emits no event.
+    int64_t now = esp_timer_get_time();
+    wokenBy = -1;
+    switch (esp_sleep_get_wakeup_cause()) {
+        case ESP_SLEEP_WAKEUP_EXT0:
+            wokenBy = BUTTON_A;
+            break;
+        case ESP_SLEEP_WAKEUP_EXT1:
+            if (esp_sleep_get_ext1_wakeup_status() & (1ULL << BUTTON_B_PIN)) wokenBy = BUTTON_B;
+            break;
+        default:
+            break;
+    }
+    if (wokenBy >= 0) {
+        ButtonState &b = buttons[wokenBy];
+        b.pressedUs = now;
+        b.changedUs = now;
+        b.state = digitalRead(BUTTON_PINS[wokenBy]) == LOW ? DEBOUNCE_PRESSED : DEBOUNCE_RELEASING;
+        swallowed = wokenBy;
+    }
+}
+
+bool buttonsWait(ButtonEvent *event, uint32_t timeoutMs) {
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeoutMs * 1000;
+
+    while (true) {
+        int64_t now = esp_timer_get_time();
+        if (settle(now, event)) return true;
+        if (now >= deadline) return false;
+
+        int64_t waitUs = deadline - now;
+        int64_t settleUs = nextSettleUs(now);
+        if (settleUs >= 0 && settleUs < waitUs) waitUs = settleUs;
+        if (polling && waitUs > (int64_t)BUTTON_POLL_MS * 1000) waitUs = (int64_t)BUTTON_POLL_MS * 1000;
+
+        ButtonEdge edge;
+        TickType_t ticks = pdMS_TO_TICKS((waitUs + 999) / 1000);
+        if (xQueueReceive(edgeQueue, &edge, ticks ? ticks : 1) == pdTRUE) {
+            feedEdge(edge);
+            while (xQueueReceive(edgeQueue, &edge, 0) == pdTRUE) feedEdge(edge);
+        }
+        if (polling) pollLevels(esp_timer_get_time());
+    }
+}
+
+void buttonsSetPolling(bool on) {
+    polling = on;
+}
+
+bool buttonsWokeNode() {
+    return wokenBy >= 0;
+}
+
+void buttonsEnableWakeup() {
+    esp_sleep_enable_ext0_wakeup((gpio_num_t)BUTTON_A_PIN, LOW);
+    esp_sleep_enable_ext1_wakeup(1ULL << BUTTON_B_PIN, ESP_EXT1_WAKEUP_ALL_LOW);
+}
+#endif
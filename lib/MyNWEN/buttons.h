@@ -0,0 +1,77 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_BUTTONS_H_
+#define LIB_MYNWEN_BUTTONS_H_
+
+#include <Arduino.h>
+
+/**
+ * Interrupt driven front panel buttons.
+ *
+ * Raw edges are queued from the GPIO ISRs and debounced by a small state machine in the
+ * consuming task, so the main loop can block until a press arrives instead of polling.
+ */
+enum ButtonId : uint8_t {
+    BUTTON_A = 0,
+    BUTTON_B,
+    BUTTON_C,
+    BUTTON_COUNT,
+};
+
+/**
+ * A debounced press, emitted once the button has been released.
+ */
+struct ButtonEvent {
+    ButtonId button;
+    uint32_t heldMs;
+};
+
+const uint32_t BUTTON_DEBOUNCE_MS = 20;  // level must be stable this long
+const uint32_t BUTTON_POLL_MS = 40;      // level check period while polling
+
+/**
+ * Attaches the GPIO interrupts. If the node was woken from deep sleep by a button, the
+ * waking press only wakes it: it is completed without an event.
+ */
+void buttonsBegin();
+
+/**
+ * Swallows the press that woke the node from a light sleep, as buttonsBegin() does after
+ * deep sleep.
+ */
+void buttonsWoke();
+
+/**
+ * Blocks for up to timeoutMs waiting for a debounced press. Returns true if one arrived.
+ */
+bool buttonsWait(ButtonEvent *event, uint32_t timeoutMs);
+
+/**
+ * GPIO edges that arrive while automatic light sleep has the chip asleep are lost. With
+ * polling on, buttonsWait() also reads the levels every BUTTON_POLL_MS and feeds any
+ * change the ISR missed as an edge; a press shorter than that may still be missed.
+ */
+void buttonsSetPolling(bool on);
+
+/**
+ * Returns true if the current boot was caused by a button press.
+ */
+bool buttonsWokeNode();
+
+/**
+ * Arms the buttons as deep sleep wake sources. BtnA uses ext0 and BtnB uses ext1.
+ *
+ * ext1 can only wake on "all low" or "any high" and the buttons are active low, so only
+ * one pin can be given to it; BtnC (reset) is left without a wake source.
+ */
+void buttonsEnableWakeup();
+
+#endif  // LIB_MYNWEN_BUTTONS_H_
@@ -0,0 +1,137 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#include "calibration.h"
+
+#include <string.h>
+
+#include "critical.h"
+#include "hotpath.h"
+#include "persist.h"
+#include "timesync.h"
+
+// Set from the console task while the loop corrects samples: tables are built aside and
+// copied in, and only read, under the lock.
+static CalibrationTable tables[SENSOR_COUNT];
+CRITICAL_DECLARE(tablesMux);
+
+static_assert(CALIBRATION_POINTS * sizeof(CalibrationPoint) <= PERSIST_VALUE_MAX,
+              "a sensor's points are one persisted value");
+
+int16_t HOT_IRAM_ATTR calibrationApply(const CalibrationTable &t, int16_t raw) {
+    if (!t.n) return raw;
+
+    uint8_t i = 0;
+    while (i + 2 < t.n && raw >= t.x[i + 1]) i++;
+    int64_t scaled = (int64_t)(raw - t.x[i]) * t.slope[i] + (1 << (CALIBRATION_SHIFT - 1));
+    int32_t value = t.y[i] + (int32_t)(scaled >> CALIBRATION_SHIFT);
+    return value > INT16_MAX ? INT16_MAX : (value < INT16_MIN ? INT16_MIN : value);
+}
+
+static void nvsKey(SensorId id, char *key) {
+    strcpy(key, "pts0");
+    key[3] += id;
+}
+
+/**
+ * Reads a sensor's stored points. Returns how many there are.
+ */
+static uint8_t load(SensorId id, CalibrationPoint *points) {
+    char key[8];
+    nvsKey(id, key);
+    return persistGet(key, points, CALIBRATION_POINTS * sizeof(CalibrationPoint)) /
+           sizeof(CalibrationPoint);
+}
+
+static void store(SensorId id, const CalibrationPoint *points, uint8_t n) {
+    char key[8];
+    nvsKey(id, key);
+    persistPut(key, points, n * sizeof(CalibrationPoint), timeSyncMonotonicMs());
+}
+
+void calibrationBegin(const CalibrationTable *factory) {
+    CalibrationPoint points[CALIBRATION_POINTS];
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        uint8_t n = load((SensorId)i, points);
+        if (n) {
+            tables[i] = calibrationTable(points, n);
+        } else if (factory) {
+            tables[i] = factory[i];
+        } else {
+            tables[i].n = 0;
+        }
+    }
+}
+
+void calibrationSet(SensorId id, const CalibrationPoint *points, uint8_t n) {
+    if (n > CALIBRATION_POINTS) n = CALIBRATION_POINTS;
+    CalibrationTable table = calibrationTable(points, n);
+    CRITICAL_ENTER(tablesMux);
+    tables[id] = table;
+    CRITICAL_EXIT(tablesMux);
+    store(id, points, n);
+}
+
+CalibrationTable calibrationGet(SensorId id) {
+    CRITICAL_ENTER(tablesMux);
+    CalibrationTable table = tables[id];
+    CRITICAL_EXIT(tablesMux);
+    return table;
+}
+
+int16_t HOT_IRAM_ATTR calibrationCorrect(SensorId id, int16_t raw) {
+    CRITICAL_ENTER(tablesMux);
+    int16_t value = calibrationApply(tables[id], raw);
+    CRITICAL_EXIT(tablesMux);
+    return value;
+}
+
+/**
+ * A thermistor-like curve: 3 % gain error, an offset and some bow, in hundredths of a
+ * degree. The polynomial is its least squares cubic, as a float calibration would use.
+ */
+static constexpr CalibrationPoint BENCH_POINTS[] = {
+    {-1000, -1075}, {0, -20}, {1000, 1010}, {2000, 2035}, {3000, 3070}, {4000, 4130},
+};
+static constexpr CalibrationTable BENCH_TABLE = calibrationTable(BENCH_POINTS);
+static_assert(BENCH_TABLE.n == 6 && BENCH_TABLE.slope[1] == 1030 * 65536 / 1000,
+              "calibration tables are built at compile time");
+static const float BENCH_POLY_F[] = {-20.635f, 1.03995f, -1.14881e-5f, 2.73148e-9f};
+static const double BENCH_POLY_D[] = {-20.635, 1.03995, -1.14881e-5, 2.73148e-9};
+static const uint16_t BENCH_INPUTS = 256;
+
+void calibrationBenchmark(uint32_t (*cycles)(), uint32_t samples, CalibrationBench *out) {
+    volatile int16_t inputs[BENCH_INPUTS];
+    for (uint16_t i = 0; i < BENCH_INPUTS; i++) inputs[i] = -1500 + i * 23;
+    volatile int32_t sink = 0;
+
+    uint32_t start = cycles();
+    for (uint32_t i = 0; i < samples; i++) {
+        sink = calibrationApply(BENCH_TABLE, inputs[i % BENCH_INPUTS]);
+    }
+    out->fixedCycles = (cycles() - start) / samples;
+
+    start = cycles();
+    for (uint32_t i = 0; i < samples; i++) {
+        float x = inputs[i % BENCH_INPUTS];
+        const float *c = BENCH_POLY_F;
+        sink = (int32_t)(c[0] + x * (c[1] + x * (c[2] + x * c[3])) + 0.5f);
+    }
+    out->floatCycles = (cycles() - start) / samples;
+
+    start = cycles();
+    for (uint32_t i = 0; i < samples; i++) {
+        double x = inputs[i % BENCH_INPUTS];
+        const double *c = BENCH_POLY_D;
+        sink = (int32_t)(c[0] + x * (c[1] + x * (c[2] + x * c[3])) + 0.5);
+    }
+    out->doubleCycles = (cycles() - start) / samples;
+    (void)sink;
+}
@@ -0,0 +1,121 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_CALIBRATION_H_
+#define LIB_MYNWEN_CALIBRATION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sensors.h"
+
+/**
+ * Per-device sensor calibration as a piecewise-linear correction in fixed point.
+ *
+ * A unit is calibrated by up to CALIBRATION_POINTS (raw, actual) pairs per sensor, kept
+ * in NVS. calibrationTable() sorts them and precomputes each segment's slope (Q16), so
+ * correcting a sample is a short search, a 32x32 to 64 bit multiply and a shift, with no
+ * floating point. It is constexpr, so factory tables can be built at compile time. One
+ * point is a plain offset; none leaves the sensor as it is. Beyond the end points the end
+ * segments are extended.
+ */
+const uint8_t CALIBRATION_POINTS = 8;
+const uint8_t CALIBRATION_SHIFT = 16;
+
+struct CalibrationPoint {
+    int16_t raw;
+    int16_t actual;
+};
+
+struct CalibrationTable {
+    uint8_t n;  // breakpoints, 0 for none
+    int16_t x[CALIBRATION_POINTS];      // raw, ascending
+    int16_t y[CALIBRATION_POINTS];      // actual
+    int32_t slope[CALIBRATION_POINTS];  // Q16, of the segment from x[i] (the last repeats)
+};
+
+constexpr CalibrationTable calibrationTable(const CalibrationPoint *points, uint8_t n) {
+    CalibrationTable t = {0, {}, {}, {}};
+    // Insertion sort by raw value, dropping repeated raw values.
+    for (uint8_t i = 0; i < n && i < CALIBRATION_POINTS; i++) {
+        uint8_t at = t.n;
+        while (at > 0 && t.x[at - 1] > points[i].raw) at--;
+        if (at > 0 && t.x[at - 1] == points[i].raw) continue;
+        for (uint8_t j = t.n; j > at; j--) {
+            t.x[j] = t.x[j - 1];
+            t.y[j] = t.y[j - 1];
+        }
+        t.x[at] = points[i].raw;
+        t.y[at] = points[i].actual;
+        t.n++;
+    }
+    for (uint8_t i = 0; i + 1 < t.n; i++) {
+        int64_t slope =
+            (int64_t)(t.y[i + 1] - t.y[i]) * (1 << CALIBRATION_SHIFT) / (t.x[i + 1] - t.x[i]);
+        t.slope[i] = slope > INT32_MAX ? INT32_MAX : (slope < INT32_MIN ? INT32_MIN : slope);
+    }
+    if (t.n) t.slope[t.n - 1] = t.n > 1 ? t.slope[t.n - 2] : 1 << CALIBRATION_SHIFT;
+    return t;
+}
+
+template <size_t N>
+constexpr CalibrationTable calibrationTable(const CalibrationPoint (&points)[N]) {
+    static_assert(N <= CALIBRATION_POINTS, "too many calibration points");
+    return calibrationTable(points, N);
+}
+
+/**
+ * Corrects a raw value.
+ */
+int16_t calibrationApply(const CalibrationTable &table, int16_t raw);
+
+/**
+ * Loads each sensor's points from NVS and builds its table. factory, indexed by
+ * SensorId, is used for sensors without stored points; NULL means none.
+ */
+void calibrationBegin(const CalibrationTable *factory = NULL);
+
+/**
+ * Replaces a sensor's points, staging them for NVS (see persist.h). No points removes its
+ * calibration.
+ */
+void calibrationSet(SensorId id, const CalibrationPoint *points, uint8_t n);
+
+/**
+ * A copy of a sensor's current table.
+ */
+CalibrationTable calibrationGet(SensorId id);
+
+/**
+ * Corrects a raw value of a sensor with its current table.
+ */
+int16_t calibrationCorrect(SensorId id, int16_t raw);
+
+/**
+ * A SensorRead reading Raw and correcting it, for the sensor table.
+ */
+template <SensorId Id, SensorRead Raw>
+int16_t calibratedRead() {
+    return calibrationCorrect(Id, Raw());
+}
+
+struct CalibrationBench {
+    uint32_t fixedCycles;   // per sample, piecewise linear
+    uint32_t floatCycles;   // cubic polynomial, single precision
+    uint32_t doubleCycles;  // cubic polynomial, double precision
+};
+
+/**
+ * Times the correction of samples raw values against a float and a double cubic
+ * polynomial, with cycles() as the clock. Results are per sample, loop included.
+ */
+void calibrationBenchmark(uint32_t (*cycles)(), uint32_t samples, CalibrationBench *out);
+
+#endif  // LIB_MYNWEN_CALIBRATION_H_
@@ -0,0 +1,224 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#include "canvas.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+Canvas::Canvas(uint16_t width, uint16_t height, const uint16_t *palette)
+    : width_(width),
+      height_(height),
+      tilesX_(width / TILE),
+      tilesY_(height / TILE),
+      palette_(palette),
+      pixels_(NULL),
+      tileHash_(NULL),
+      touched_(NULL),
+      dirty_(NULL),
+      staging_(NULL),
+      forceAll_(true) {}
+
+Canvas::~Canvas() {
+    free(pixels_);
+    free(tileHash_);
+    free(touched_);
+    free(dirty_);
+    free(staging_);
+}
+
+bool Canvas::begin() {
+    if (width_ % TILE || height_ % TILE) return false;
+
+    pixels_ = (uint8_t *)calloc((size_t)width_ * height_ / 2, 1);
+    tileHash_ = (uint32_t *)calloc((size_t)tilesX_ * tilesY_, sizeof(uint32_t));
+    touched_ = (uint8_t *)calloc(((size_t)tilesX_ * tilesY_ + 7) / 8, 1);
+    dirty_ = (uint8_t *)calloc(tilesX_, 1);
+    staging_ = (uint16_t *)malloc((size_t)width_ * TILE * sizeof(uint16_t));
+
+    forceAll_ = true;
+    return pixels_ && tileHash_ && touched_ && dirty_ && staging_;
+}
+
+/**
+ * Marks every tile overlapping the inclusive pixel rectangle as touched.
+ */
+void Canvas::touch(int16_t x0, int16_t y0, int16_t x1, int16_t y1) {
+    for (int16_t ty = y0 / TILE; ty <= y1 / TILE; ty++) {
+        for (int16_t tx = x0 / TILE; tx <= x1 / TILE; tx++) {
+            uint32_t i = (uint32_t)ty * tilesX_ + tx;
+            touched_[i >> 3] |= 1 << (i & 7);
+        }
+    }
+}
+
+void Canvas::drawPixel(int16_t x, int16_t y, uint8_t color) {
+    if (x < 0 || y < 0 || x >= width_ || y >= height_) return;
+
+    uint8_t *p = &pixels_[((uint32_t)y * width_ + x) >> 1];
+    *p = (x & 1) ? (*p & 0xF0) | (color & 0x0F) : (*p & 0x0F) | (color << 4);
+    touch(x, y, x, y);
+}
+
+void Canvas::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t color) {
+    int16_t x0 = x < 0 ? 0 : x;
+    int16_t y0 = y < 0 ? 0 : y;
+    int16_t x1 = x + w > width_ ? width_ : x + w;
+    int16_t y1 = y + h > height_ ? height_ : y + h;
+    if (x0 >= x1 || y0 >= y1) return;
+
+    uint8_t both = (color << 4) | (color & 0x0F);
+    for (int16_t row = y0; row < y1; row++) {
+        uint8_t *line = &pixels_[(uint32_t)row * width_ / 2];
+        int16_t col = x0;
+        if (col & 1) {
+            line[col >> 1] = (line[col >> 1] & 0xF0) | (color & 0x0F);
+            col++;
+        }
+        int16_t pairs = (x1 - col) / 2;
+        memset(&line[col >> 1], both, pairs);
+        col += pairs * 2;
+        if (col < x1) line[col >> 1] = (line[col >> 1] & 0x0F) | (color << 4);
+    }
+    touch(x0, y0, x1 - 1, y1 - 1);
+}
+
+void Canvas::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t color) {
+    int16_t dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+    int16_t dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+    int16_t err = dx + dy;
+
+    while (true) {
+        drawPixel(x0, y0, color);
+        if (x0 == x1 && y0 == y1) break;
+        int16_t e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+void Canvas::drawBitmap(int16_t x, int16_t y, const uint8_t *bits, uint16_t w, uint16_t h,
+                        uint8_t fg, uint8_t bg, uint8_t scale) {
+    uint16_t stride = (w + 7) / 8;
+    for (uint16_t row = 0; row < h; row++) {
+        for (uint16_t col = 0; col < w; col++) {
+            bool on = bits[row * stride + col / 8] & (0x80 >> (col & 7));
+            fillRect(x + col * scale, y + row * scale, scale, scale, on ? fg : bg);
+        }
+    }
+}
+
+void Canvas::blitBitmap(int16_t x, int16_t y, const uint8_t *bits, uint16_t w, uint16_t h,
+                        uint8_t fg, uint8_t bg) {
+    if ((x & 1) || (w & 7) || x < 0 || y < 0 || x + w > width_ || y + h > height_) {
+        drawBitmap(x, y, bits, w, h, fg, bg);
+        return;
+    }
+
+    // Destination byte for each pair of source bits.
+    fg &= 0x0F;
+    bg &= 0x0F;
+    const uint8_t pairs[4] = {
+        (uint8_t)(bg << 4 | bg),
+        (uint8_t)(bg << 4 | fg),
+        (uint8_t)(fg << 4 | bg),
+        (uint8_t)(fg << 4 | fg),
+    };
+
+    uint16_t stride = w / 8;
+    for (uint16_t row = 0; row < h; row++) {
+        uint8_t *out = &pixels_[((uint32_t)(y + row) * width_ + x) / 2];
+        const uint8_t *in = &bits[row * stride];
+        for (uint16_t i = 0; i < stride; i++) {
+            uint8_t b = in[i];
+            *out++ = pairs[b >> 6];
+            *out++ = pairs[(b >> 4) & 3];
+            *out++ = pairs[(b >> 2) & 3];
+            *out++ = pairs[b & 3];
+        }
+    }
+    touch(x, y, x + w - 1, y + h - 1);
+}
+
+void Canvas::invalidateAll() {
+    forceAll_ = true;
+}
+
+/**
+ * FNV-1a over the tile's bytes.
+ */
+uint32_t Canvas::hashTile(uint16_t tx, uint16_t ty) const {
+    uint32_t hash = 2166136261u;
+    for (uint16_t row = 0; row < TILE; row++) {
+        const uint8_t *p = &pixels_[((uint32_t)(ty * TILE + row) * width_ + tx * TILE) / 2];
+        for (uint8_t i = 0; i < TILE / 2; i++) {
+            hash ^= p[i];
+            hash *= 16777619u;
+        }
+    }
+    return hash;
+}
+
+/**
+ * Expands a block of palette pixels into the staging buffer in panel byte order.
+ */
+void Canvas::stageRun(uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+    uint16_t *out = staging_;
+    for (uint16_t row = y; row < y + h; row++) {
+        const uint8_t *line = &pixels_[(uint32_t)row * width_ / 2];
+        for (uint16_t col = x; col < x + w; col++) {
+            uint8_t index = (col & 1) ? line[col >> 1] & 0x0F : line[col >> 1] >> 4;
+            uint16_t c = palette_[index];
+            *out++ = (c >> 8) | (c << 8);
+        }
+    }
+}
+
+uint32_t Canvas::flush(PushFn push) {
+    uint32_t bytes = 0;
+
+    for (uint16_t ty = 0; ty < tilesY_; ty++) {
+        for (uint16_t tx = 0; tx < tilesX_; tx++) {
+            uint32_t i = (uint32_t)ty * tilesX_ + tx;
+            dirty_[tx] = 0;
+            if (!forceAll_ && !(touched_[i >> 3] & (1 << (i & 7)))) continue;
+
+            uint32_t hash = hashTile(tx, ty);
+            if (forceAll_ || hash != tileHash_[i]) dirty_[tx] = 1;
+            tileHash_[i] = hash;
+        }
+
+        // Merge neighbouring dirty tiles into a single window write.
+        for (uint16_t tx = 0; tx < tilesX_;) {
+            if (!dirty_[tx]) {
+                tx++;
+                continue;
+            }
+            uint16_t end = tx;
+            while (end < tilesX_ && dirty_[end]) end++;
+
+            uint16_t x = tx * TILE, y = ty * TILE, w = (end - tx) * TILE;
+            stageRun(x, y, w, TILE);
+            push(x, y, w, TILE, staging_);
+            bytes += (uint32_t)w * TILE * sizeof(uint16_t);
+            tx = end;
+        }
+    }
+
+    memset(touched_, 0, ((size_t)tilesX_ * tilesY_ + 7) / 8);
+    forceAll_ = false;
+    return bytes;
+}
@@ -0,0 +1,90 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_CANVAS_H_
+#define LIB_MYNWEN_CANVAS_H_
+
+#include <stdint.h>
+
+/**
+ * Off-screen 4 bit palette canvas with dirty tile tracking.
+ *
+ * Drawing only touches the in-memory buffer. On flush() every tile that was drawn to is
+ * hashed and compared against the hash of what was last pushed; only tiles whose content
+ * actually changed are converted to RGB565 and sent to the panel, merged into horizontal
+ * runs so each run is a single window write.
+ */
+class Canvas {
+   public:
+    static const uint8_t TILE = 16;  // tile edge in pixels
+
+    /**
+     * Receives a block of byte-swapped (panel order) RGB565 pixels to write to the panel.
+     */
+    typedef void (*PushFn)(int16_t x, int16_t y, uint16_t w, uint16_t h, const uint16_t *pixels);
+
+    Canvas(uint16_t width, uint16_t height, const uint16_t *palette);
+    ~Canvas();
+
+    /**
+     * Allocates the buffers. Width and height must be multiples of TILE.
+     */
+    bool begin();
+
+    uint16_t width() const { return width_; }
+    uint16_t height() const { return height_; }
+
+    void drawPixel(int16_t x, int16_t y, uint8_t color);
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t color);
+    void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t color);
+
+    /**
+     * Draws a 1 bit bitmap (rows byte aligned, MSB first), scaling each bit to a square.
+     */
+    void drawBitmap(int16_t x, int16_t y, const uint8_t *bits, uint16_t w, uint16_t h,
+                    uint8_t fg, uint8_t bg, uint8_t scale = 1);
+
+    /**
+     * Unscaled 1 bit blit, expanding two source bits per destination byte. Falls back to
+     * drawBitmap() when x is odd or the bitmap is clipped.
+     */
+    void blitBitmap(int16_t x, int16_t y, const uint8_t *bits, uint16_t w, uint16_t h,
+                    uint8_t fg, uint8_t bg);
+
+    /**
+     * Forces every tile to be pushed on the next flush, eg. after the panel was cleared.
+     */
+    void invalidateAll();
+
+    /**
+     * Pushes changed tiles to the panel. Returns the number of pixel bytes sent.
+     */
+    uint32_t flush(PushFn push);
+
+   private:
+    void touch(int16_t x0, int16_t y0, int16_t x1, int16_t y1);
+    uint32_t hashTile(uint16_t tx, uint16_t ty) const;
+    void stageRun(uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+
+    uint16_t width_;
+    uint16_t height_;
+    uint16_t tilesX_;
+    uint16_t tilesY_;
+    const uint16_t *palette_;
+
+    uint8_t *pixels_;     // two pixels per byte, high nibble first
+    uint32_t *tileHash_;  // hash of each tile as last pushed
+    uint8_t *touched_;    // one bit per tile drawn to since the last flush
+    uint8_t *dirty_;      // scratch, one byte per tile in a row
+    uint16_t *staging_;   // one tile row of RGB565 pixels
+    bool forceAll_;
+};
+
+#endif  // LIB_MYNWEN_CANVAS_H_
@@ -0,0 +1,128 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#include "coalesce.h"
+
+#include <string.h>
+
+#include "diagnostics.h"
+
+static const size_t PACKET_MAX = COALESCE_MTU_MAX - 3;
+static const size_t SAMPLES_MAX = (PACKET_MAX - COALESCE_HEADER) / COALESCE_SAMPLE;
+
+static CoalesceFlush flushOut = NULL;
+static volatile uint32_t budget = COALESCE_BUDGET_DEFAULT_MS;
+static volatile uint16_t mtu = COALESCE_MTU_DEFAULT;
+
+static uint8_t packet[PACKET_MAX];
+static uint64_t sampleTimes[SAMPLES_MAX];  // for latency accounting
+static uint8_t pending = 0;
+static uint64_t baseMs = 0;  // base time of the packet on the monotonic clock
+// Set from the BLE task on a disconnect, applied by the loop, which owns the packet.
+static volatile bool discard = false;
+
+static CoalesceStats stats;
+
+void coalesceBegin(CoalesceFlush flush, uint32_t budgetMs) {
+    flushOut = flush;
+    budget = budgetMs;
+    pending = 0;
+    discard = false;
+    coalesceResetStats();
+}
+
+/**
+ * Drops the pending samples if a discard was posted since the last call.
+ */
+static void applyDiscard() {
+    if (!discard) return;
+    discard = false;
+    pending = 0;
+}
+
+void coalesceSetMtu(uint16_t value) {
+    mtu = value < COALESCE_MTU_DEFAULT ? COALESCE_MTU_DEFAULT
+                                       : (value > COALESCE_MTU_MAX ? COALESCE_MTU_MAX : value);
+}
+
+void coalesceSetBudget(uint32_t budgetMs) {
+    budget = budgetMs;
+}
+
+void coalesceFlush(uint64_t now) {
+    applyDiscard();
+    if (!pending) return;
+
+    packet[4] = pending;
+    if (flushOut) flushOut(packet, COALESCE_HEADER + pending * COALESCE_SAMPLE);
+
+    stats.packets++;
+    stats.samples += pending;
+    for (uint8_t i = 0; i < pending; i++) {
+        uint32_t latency = now - sampleTimes[i];
+        stats.latencySumMs += latency;
+        if (latency > stats.latencyMaxMs) stats.latencyMaxMs = latency;
+    }
+    pending = 0;
+
+    diagSet("notify.packets", stats.packets);
+    diagSet("notify.samples", stats.samples);
+    diagSet("notify.lat.ms", stats.latencySumMs / stats.samples);
+}
+
+void coalesceDiscard() {
+    discard = true;
+}
+
+void coalesceAdd(uint8_t sensor, uint32_t seq, int16_t value, uint64_t now, uint64_t wallMs) {
+    applyDiscard();
+    size_t capacity = (mtu - 3 - COALESCE_HEADER) / COALESCE_SAMPLE;
+    if (pending >= capacity || (pending && (now - baseMs) / 100 > UINT16_MAX)) coalesceFlush(now);
+
+    // The base is the wall clock second of the first sample, taken back to the monotonic
+    // clock, so later samples are never before it.
+    if (!pending) {
+        baseMs = now - wallMs % 1000;
+        uint32_t base = wallMs / 1000;
+        for (uint8_t i = 0; i < 4; i++) packet[i] = base >> (8 * i);
+    }
+
+    uint16_t offset = (now - baseMs) / 100;
+    uint8_t *p = &packet[COALESCE_HEADER + pending * COALESCE_SAMPLE];
+    p[0] = sensor;
+    p[1] = seq;
+    p[2] = seq >> 8;
+    p[3] = offset;
+    p[4] = offset >> 8;
+    p[5] = value;
+    p[6] = value >> 8;
+    sampleTimes[pending++] = now;
+
+    if (pending >= capacity || budget == 0) coalesceFlush(now);
+}
+
+uint32_t coalesceMsUntilFlush(uint64_t now) {
+    applyDiscard();
+    if (!pending) return UINT32_MAX;
+    uint64_t due = sampleTimes[0] + budget;
+    return due <= now ? 0 : due - now;
+}
+
+void coalescePoll(uint64_t now) {
+    if (pending && coalesceMsUntilFlush(now) == 0) coalesceFlush(now);
+}
+
+const CoalesceStats &coalesceStats() {
+    return stats;
+}
+
+void coalesceResetStats() {
+    memset(&stats, 0, sizeof(stats));
+}
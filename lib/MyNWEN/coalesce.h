@@ -0,0 +1,96 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_COALESCE_H_
+#define LIB_MYNWEN_COALESCE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Notification coalescing, Nagle's algorithm for GATT. Samples are packed into one
+ * packet until either it would no longer fit in a notification (ATT MTU - 3) or the
+ * oldest sample has waited the latency budget, then the packet is flushed.
+ *
+ *   packet: [u32 base time, seconds] [u8 n]
+ *           n x [u8 sensor] [u16 sequence number, low bits]
+ *               [u16 offset from base, tenths of a second] [i16 value]
+ *
+ * A budget of 0 sends every sample on its own. Publishes notify.packets, notify.samples
+ * and notify.lat.ms (mean sample to flush latency) to diagnostics.
+ *
+ * Times passed as now are on the monotonic clock, so the budget and the latencies are
+ * not moved by a time sync. Wall clock time only sets a packet's base; the offsets of
+ * its samples follow the monotonic clock from there.
+ */
+const uint8_t COALESCE_HEADER = 5;
+const uint8_t COALESCE_SAMPLE = 7;
+const uint16_t COALESCE_MTU_DEFAULT = 23;
+const uint16_t COALESCE_MTU_MAX = 515;  // 512 byte payload, the attribute value limit
+const uint32_t COALESCE_BUDGET_DEFAULT_MS = 30000;
+
+/**
+ * Sends one packet as a notification.
+ */
+typedef void (*CoalesceFlush)(const uint8_t *packet, size_t len);
+
+struct CoalesceStats {
+    uint32_t packets;
+    uint32_t samples;
+    uint64_t latencySumMs;  // flush time - sample time, summed over samples
+    uint32_t latencyMaxMs;
+};
+
+void coalesceBegin(CoalesceFlush flush, uint32_t budgetMs = COALESCE_BUDGET_DEFAULT_MS);
+
+/**
+ * Sets the negotiated ATT MTU, which only grows during a connection. Safe to call from
+ * the BLE task; it takes effect from the next sample.
+ */
+void coalesceSetMtu(uint16_t mtu);
+
+/**
+ * Sets the latency budget. Like the MTU it may be set from the BLE task and is applied
+ * by the next coalescePoll().
+ */
+void coalesceSetBudget(uint32_t budgetMs);
+
+/**
+ * Queues a sample taken at now, wallMs on the wall clock, flushing first if it would not
+ * fit.
+ */
+void coalesceAdd(uint8_t sensor, uint32_t seq, int16_t value, uint64_t now, uint64_t wallMs);
+
+/**
+ * Flushes if the oldest pending sample has used its latency budget.
+ */
+void coalescePoll(uint64_t now);
+
+/**
+ * Sends whatever is pending, eg. before a deep sleep.
+ */
+void coalesceFlush(uint64_t now);
+
+/**
+ * Discards pending samples, eg. when the client disconnects. Safe from any task: the
+ * samples are dropped by the next call on the task that adds them.
+ */
+void coalesceDiscard();
+
+/**
+ * Milliseconds until the pending packet is due, or UINT32_MAX if nothing is pending.
+ */
+uint32_t coalesceMsUntilFlush(uint64_t now);
+
+const CoalesceStats &coalesceStats();
+
+void coalesceResetStats();
+
+#endif  // LIB_MYNWEN_COALESCE_H_
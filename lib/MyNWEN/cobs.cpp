@@ -0,0 +1,81 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#include "cobs.h"
+
+size_t cobsEncode(const uint8_t *in, size_t len, uint8_t *out) {
+    size_t code = 0;  // index of the current code byte
+    size_t o = 1;
+    uint8_t run = 1;
+
+    for (size_t i = 0; i < len; i++) {
+        if (in[i] == 0) {
+            out[code] = run;
+            code = o++;
+            run = 1;
+            continue;
+        }
+        out[o++] = in[i];
+        if (++run == 0xFF) {
+            out[code] = run;
+            code = o++;
+            run = 1;
+        }
+    }
+    out[code] = run;
+    return o;
+}
+
+size_t cobsDecode(const uint8_t *in, size_t len, uint8_t *out) {
+    size_t i = 0, o = 0;
+
+    while (i < len) {
+        uint8_t code = in[i++];
+        if (code == 0 || i + code - 1 > len) return 0;
+        for (uint8_t k = 1; k < code; k++) {
+            if (in[i] == 0) return 0;
+            out[o++] = in[i++];
+        }
+        if (code != 0xFF && i < len) out[o++] = 0;
+    }
+    return o;
+}
+
+uint16_t crc16(const uint8_t *data, size_t len, uint16_t crc) {
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (uint8_t b = 0; b < 8; b++) crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+size_t frameEncode(const uint8_t *payload, size_t len, uint8_t *out) {
+    // Encode payload and CRC as one block; the CRC is appended after the payload in a
+    // scratch area at the end of out, which COBS never overtakes (it only grows).
+    uint16_t crc = crc16(payload, len);
+    size_t max = cobsMaxEncoded(len + 2);
+    uint8_t *scratch = out + max + 1 - (len + 2);
+    for (size_t i = len; i-- > 0;) scratch[i] = payload[i];
+    scratch[len] = crc & 0xFF;
+    scratch[len + 1] = crc >> 8;
+
+    size_t n = cobsEncode(scratch, len + 2, out);
+    out[n] = 0;
+    return n + 1;
+}
+
+int frameDecode(uint8_t *frame, size_t len) {
+    size_t n = cobsDecode(frame, len, frame);
+    if (n < 2) return -1;
+
+    uint16_t crc = frame[n - 2] | (uint16_t)frame[n - 1] << 8;
+    if (crc16(frame, n - 2) != crc) return -1;
+    return (int)(n - 2);
+}
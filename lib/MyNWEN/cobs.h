@@ -0,0 +1,59 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_COBS_H_
+#define LIB_MYNWEN_COBS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Consistent Overhead Byte Stuffing and the frame checksum used on the serial links.
+ *
+ * A frame on the wire is COBS(payload + CRC-16 little endian) followed by a 0x00
+ * delimiter, so a receiver can always resynchronise on the next zero byte.
+ */
+
+/**
+ * Worst case encoded size of len bytes, excluding the delimiter.
+ */
+constexpr size_t cobsMaxEncoded(size_t len) {
+    return len + len / 254 + 1;
+}
+
+/**
+ * Encodes len bytes from in into out. Returns the encoded length (no delimiter).
+ */
+size_t cobsEncode(const uint8_t *in, size_t len, uint8_t *out);
+
+/**
+ * Decodes len bytes (no delimiter) from in into out. Returns the decoded length, or 0 if
+ * the input is malformed. in and out may be the same buffer.
+ */
+size_t cobsDecode(const uint8_t *in, size_t len, uint8_t *out);
+
+/**
+ * CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF).
+ */
+uint16_t crc16(const uint8_t *data, size_t len, uint16_t crc = 0xFFFF);
+
+/**
+ * Builds a complete frame (COBS(payload + CRC) + 0x00) into out, which must hold
+ * cobsMaxEncoded(len + 2) + 1 bytes. Returns the frame length.
+ */
+size_t frameEncode(const uint8_t *payload, size_t len, uint8_t *out);
+
+/**
+ * Decodes a frame without its delimiter in place and checks the CRC. Returns the payload
+ * length, or -1 if the frame is malformed or the CRC does not match.
+ */
+int frameDecode(uint8_t *frame, size_t len);
+
+#endif  // LIB_MYNWEN_COBS_H_
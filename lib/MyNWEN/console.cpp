@@ -0,0 +1,157 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifdef ARDUINO
+#include "console.h"
+
+#include <Arduino.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "calibration.h"
+#include "persist.h"
+#include "protocol.h"
+#include "stream.h"
+#include "timesync.h"
+#include "trace.h"
+#include "workload.h"
+
+static SemaphoreHandle_t serialLock = NULL;  // NULL until the console task exists
+
+bool consoleLock() {
+    if (serialLock) xSemaphoreTake(serialLock, portMAX_DELAY);
+    return !streamActive();
+}
+
+void consoleUnlock() {
+    if (serialLock) xSemaphoreGive(serialLock);
+}
+
+static void serialWrite(const uint8_t *data, size_t len) {
+    if (consoleLock()) Serial.write(data, len);
+    consoleUnlock();
+}
+
+static void serialLine(const char *line) {
+    if (consoleLock()) Serial.println(line);
+    consoleUnlock();
+}
+
+/**
+ * Trace lines come from the loop. They are written whole under the lock, so they never
+ * split a frame, and not at all while the host speaks the binary protocol, as its reader
+ * would take a line between two frames for the start of the second.
+ */
+static void traceLine(const char *line) {
+    if (consoleLock() && !protocolBinary()) Serial.println(line);
+    consoleUnlock();
+}
+
+static void reply(const char *format, ...) {
+    char line[80];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    serialLine(line);
+}
+
+static uint32_t cycleCount() {
+    return ESP.getCycleCount();
+}
+
+/**
+ * "calib <sensor> [raw:actual ...]", values in the sensor's history unit. Settings made
+ * from the console are committed at once rather than with the next batch.
+ */
+static void calibrate(const char *args) {
+    char *end;
+    unsigned long id = strtoul(args, &end, 10);
+    if (end == args || id >= SENSOR_COUNT) return;
+
+    CalibrationPoint points[CALIBRATION_POINTS];
+    uint8_t n = 0;
+    for (const char *p = end; n < CALIBRATION_POINTS;) {
+        long raw = strtol(p, &end, 10);
+        if (end == p || *end != ':') break;
+        p = end + 1;
+        long actual = strtol(p, &end, 10);
+        if (end == p) break;
+        p = end;
+        points[n++] = {(int16_t)raw, (int16_t)actual};
+    }
+    calibrationSet((SensorId)id, points, n);
+    persistFlush();
+    reply("calib %lu: %u points", id, calibrationGet((SensorId)id).n);
+}
+
+/**
+ * "stream [hz]", at STREAM_DEFAULT_HZ without a rate. A rate that is not a number in
+ * 1..STREAM_MAX_HZ is refused rather than clamped.
+ */
+static void stream(const char *args) {
+    char *end;
+    long hz = strtol(args, &end, 10);
+    if (end == args) hz = STREAM_DEFAULT_HZ;
+    while (*end == ' ') end++;
+    if (*end || hz < 1 || hz > STREAM_MAX_HZ) {
+        reply("stream: rate must be 1..%u Hz", (unsigned)STREAM_MAX_HZ);
+        return;
+    }
+    streamStart(hz);
+}
+
+static void onLine(const char *line) {
+    if (strncmp(line, "stream", 6) == 0) {
+        stream(line + 6);
+    } else if (strncmp(line, "seed", 4) == 0) {
+        uint32_t seed = strtoul(line + 4, NULL, 0);
+        workloadSetSeed(seed);
+        persistPut("seed", &seed, sizeof(seed), timeSyncMonotonicMs());
+        persistFlush();
+        reply("seed %u", workloadSeed());
+    } else if (strncmp(line, "calib", 5) == 0) {
+        calibrate(line + 5);
+    } else if (strcmp(line, "bench calib") == 0) {
+        CalibrationBench b;
+        calibrationBenchmark(cycleCount, 10000, &b);
+        reply("calib cycles/sample: fixed %u float %u double %u", b.fixedCycles, b.floatCycles,
+              b.doubleCycles);
+    } else if (strcmp(line, "record off") == 0) {
+        traceRecordBegin(NULL);
+    } else if (strcmp(line, "record") == 0) {
+        traceRecordBegin(traceLine);
+    }
+}
+
+static void consoleTask(void *arg) {
+    uint8_t buf[64];
+
+    while (true) {
+        // Under the lock, as streaming ends and restarts Serial from other tasks.
+        int n = consoleLock() ? Serial.available() : 0;
+        if (n > 0) n = Serial.readBytes(buf, n < (int)sizeof(buf) ? n : sizeof(buf));
+        consoleUnlock();
+        if (n <= 0) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+        protocolFeed(buf, n);
+    }
+}
+
+void consoleBegin() {
+    serialLock = xSemaphoreCreateMutex();
+    protocolBegin(serialWrite, onLine);
+    xTaskCreatePinnedToCore(consoleTask, "console", 4096, NULL, 1, NULL, APP_CPU_NUM);
+}
+#endif
@@ -0,0 +1,38 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_CONSOLE_H_
+#define LIB_MYNWEN_CONSOLE_H_
+
+/**
+ * Serial console. A task reads Serial and passes it through the command protocol, so
+ * binary requests (see protocol.h) and text lines share the port:
+ *
+ *   stream [hz]   start UART streaming (see stream.h)
+ *   seed <n>      reseed the synthetic sensor traces (see workload.h)
+ *   record [off]  print every raw sample as a trace line (see trace.h)
+ *   calib <sensor> [raw:actual ...]   set (or with no points clear) a sensor's
+ *                 calibration (see calibration.h)
+ *   bench calib   cycles per sample, fixed point calibration against polynomials
+ *
+ * The console is idle while streaming owns the UART.
+ */
+void consoleBegin();
+
+/**
+ * Serial is shared by the console, debug messages from any task and streaming. Hold the
+ * console lock while writing, so text never lands inside a protocol frame. Returns false
+ * while streaming owns the UART, when nothing may be written; unlock either way. The
+ * native build has stand-ins (see host.h).
+ */
+bool consoleLock();
+void consoleUnlock();
+
+#endif  // LIB_MYNWEN_CONSOLE_H_
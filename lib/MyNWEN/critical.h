@@ -0,0 +1,43 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_CRITICAL_H_
+#define LIB_MYNWEN_CRITICAL_H_
+
+/**
+ * Short critical sections shared between tasks and ISRs.
+ *
+ * On the device these are FreeRTOS spinlocks. Host builds are single threaded so they
+ * compile away, which lets the portable modules be reused there unchanged.
+ */
+#ifdef ARDUINO
+#include <esp_attr.h>
+#include <freertos/FreeRTOS.h>
+
+#define CRITICAL_DECLARE(name) static portMUX_TYPE name = portMUX_INITIALIZER_UNLOCKED
+#define CRITICAL_ENTER(name) portENTER_CRITICAL(&name)
+#define CRITICAL_EXIT(name) portEXIT_CRITICAL(&name)
+#else
+#define CRITICAL_DECLARE(name) static int name __attribute__((unused))
+#define CRITICAL_ENTER(name)
+#define CRITICAL_EXIT(name)
+
+#ifndef RTC_DATA_ATTR
+#define RTC_DATA_ATTR
+#endif
+#ifndef RTC_NOINIT_ATTR
+#define RTC_NOINIT_ATTR
+#endif
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+#endif
+
+#endif  // LIB_MYNWEN_CRITICAL_H_
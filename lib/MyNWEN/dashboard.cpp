@@ -0,0 +1,291 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#include "dashboard.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "canvas.h"
+#include "critical.h"
+#include "diagnostics.h"
+#include "glyphs.h"
+#include "history.h"
+#include "lcd.h"
+
+/**
+ * Palette indices used by the dashboard.
+ */
+enum : uint8_t {
+    COLOR_BG = 0,
+    COLOR_FG,
+    COLOR_DIM,
+    COLOR_ACCENT,
+    COLOR_GOOD,
+    COLOR_WARN,
+    COLOR_BAD,
+};
+
+static const uint16_t PALETTE[16] = {
+    0x0000,  // black
+    0xFFFF,  // white
+    0x4208,  // grey
+    0x07FF,  // cyan
+    0x07E0,  // green
+    0xFD20,  // orange
+    0xF800,  // red
+};
+
+/**
+ * Widget bits used to track which parts of the screen need redrawing.
+ */
+enum : uint8_t {
+    WIDGET_TEMP = 1 << 0,
+    WIDGET_SPARKLINE = 1 << 1,
+    WIDGET_CONNECTION = 1 << 2,
+    WIDGET_BATTERY = 1 << 3,
+    WIDGET_ALL = 0x0F,
+};
+
+/**
+ * 3x5 font, one byte per row with the pixels in the top three bits.
+ */
+static const char FONT_CHARS[] = "0123456789-%Co ";
+static const uint8_t FONT[][5] = {
+    {0xE0, 0xA0, 0xA0, 0xA0, 0xE0},  // 0
+    {0x40, 0xC0, 0x40, 0x40, 0xE0},  // 1
+    {0xE0, 0x20, 0xE0, 0x80, 0xE0},  // 2
+    {0xE0, 0x20, 0xE0, 0x20, 0xE0},  // 3
+    {0xA0, 0xA0, 0xE0, 0x20, 0x20},  // 4
+    {0xE0, 0x80, 0xE0, 0x20, 0xE0},  // 5
+    {0xE0, 0x80, 0xE0, 0xA0, 0xE0},  // 6
+    {0xE0, 0x20, 0x20, 0x20, 0x20},  // 7
+    {0xE0, 0xA0, 0xE0, 0xA0, 0xE0},  // 8
+    {0xE0, 0xA0, 0xE0, 0x20, 0xE0},  // 9
+    {0x00, 0x00, 0xE0, 0x00, 0x00},  // -
+    {0xA0, 0x20, 0x40, 0x80, 0xA0},  // %
+    {0xE0, 0x80, 0x80, 0x80, 0xE0},  // C
+    {0x40, 0xA0, 0x40, 0x00, 0x00},  // degree
+    {0x00, 0x00, 0x00, 0x00, 0x00},  // space
+};
+
+static const int16_t TEMP_Y = 48;
+static const uint8_t UNIT_SCALE = 4;
+static const int16_t SPARK_X = 8, SPARK_Y = 144, SPARK_W = 304, SPARK_H = 88;
+
+static Canvas canvas(320, 240, PALETTE);
+CRITICAL_DECLARE(stateMux);
+
+static volatile uint8_t changed = WIDGET_ALL;
+static int16_t temperature = 0;
+static bool hasTemperature = false;
+static bool connected = false;
+static int8_t battery = -1;
+
+/**
+ * Draws a string in the 3x5 font. Unknown characters render as spaces.
+ */
+static int16_t drawText(int16_t x, int16_t y, const char *text, uint8_t scale, uint8_t color) {
+    for (; *text; text++) {
+        const char *found = strchr(FONT_CHARS, *text);
+        uint8_t glyph = found ? found - FONT_CHARS : sizeof(FONT_CHARS) - 2;
+        canvas.drawBitmap(x, y, FONT[glyph], 3, 5, color, COLOR_BG, scale);
+        x += 4 * scale;
+    }
+    return x;
+}
+
+/**
+ * Formats a temperature in hundredths of a degree as whole degrees, or "--" if unknown.
+ */
+static void formatTemperature(char *text, size_t size, bool known, int16_t temp) {
+    if (known) {
+        snprintf(text, size, "%d", (temp + (temp < 0 ? -50 : 50)) / 100);
+    } else {
+        strncpy(text, "--", size);
+    }
+}
+
+/**
+ * Blits the digits from the pre-rendered glyph table. x is kept even so every row is a
+ * straight byte expansion in the canvas.
+ */
+static void drawTemperature(int16_t temp) {
+    canvas.fillRect(0, TEMP_Y, 320, GLYPH_H, COLOR_BG);
+
+    char text[8];
+    formatTemperature(text, sizeof(text), hasTemperature, temp);
+
+    int16_t width = strlen(text) * GLYPH_ADVANCE + 4 * UNIT_SCALE * 2;
+    int16_t x = ((320 - width) / 2) & ~1;
+    for (const char *c = text; *c; c++, x += GLYPH_ADVANCE) {
+        const uint8_t *bits = glyphBitmap(*c);
+        if (bits) canvas.blitBitmap(x, TEMP_Y, bits, GLYPH_W, GLYPH_H, COLOR_FG, COLOR_BG);
+    }
+    drawText(x, TEMP_Y, "oC", UNIT_SCALE, COLOR_ACCENT);
+}
+
+static void drawSparkline() {
+    HistoryRecord records[SPARKLINE_SAMPLES];
+    uint8_t count = historyLatest(records, SPARKLINE_SAMPLES);
+
+    canvas.fillRect(SPARK_X, SPARK_Y, SPARK_W, SPARK_H, COLOR_BG);
+    canvas.drawLine(SPARK_X, SPARK_Y + SPARK_H - 1, SPARK_X + SPARK_W - 1, SPARK_Y + SPARK_H - 1,
+                    COLOR_DIM);
+    if (count < 2) return;
+
+    int16_t lo = records[0].value, hi = records[0].value;
+    for (uint8_t i = 1; i < count; i++) {
+        if (records[i].value < lo) lo = records[i].value;
+        if (records[i].value > hi) hi = records[i].value;
+    }
+    if (hi - lo < 400) hi = lo + 400;
+
+    int16_t px = 0, py = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        int16_t x = SPARK_X + (int32_t)i * (SPARK_W - 1) / (SPARKLINE_SAMPLES - 1);
+        int16_t y = SPARK_Y + SPARK_H - 2 -
+                    (int32_t)(records[i].value - lo) * (SPARK_H - 3) / (hi - lo);
+        if (i) canvas.drawLine(px, py, x, y, COLOR_ACCENT);
+        px = x;
+        py = y;
+    }
+}
+
+static void drawConnection(bool isConnected) {
+    uint8_t color = isConnected ? COLOR_GOOD : COLOR_DIM;
+    canvas.fillRect(8, 8, 24, 16, COLOR_BG);
+    for (uint8_t bar = 0; bar < 3; bar++) {
+        int16_t h = 6 + bar * 5;
+        canvas.fillRect(8 + bar * 8, 24 - h, 5, h, color);
+    }
+}
+
+static void drawBattery(int8_t level) {
+    canvas.fillRect(224, 8, 96, 16, COLOR_BG);
+
+    uint8_t color = level < 0 ? COLOR_DIM : level <= 25 ? COLOR_BAD : level <= 50 ? COLOR_WARN : COLOR_GOOD;
+    canvas.fillRect(224, 8, 40, 16, COLOR_FG);
+    canvas.fillRect(226, 10, 36, 12, COLOR_BG);
+    canvas.fillRect(264, 12, 3, 8, COLOR_FG);
+    if (level > 0) canvas.fillRect(227, 11, 34 * level / 100, 10, color);
+
+    char text[6];
+    if (level < 0) {
+        strcpy(text, "--%");
+    } else {
+        snprintf(text, sizeof(text), "%d%%", level);
+    }
+    drawText(272, 11, text, 2, COLOR_FG);
+}
+
+/**
+ * Writes a block of panel ordered pixels straight to the LCD.
+ */
+static void pushToLcd(int16_t x, int16_t y, uint16_t w, uint16_t h, const uint16_t *pixels) {
+    LCD.pushImage(x, y, w, h, (uint16_t *)pixels);
+}
+
+bool dashboardBegin() {
+    return canvas.begin();
+}
+
+void dashboardSetTemperature(int16_t temp) {
+    CRITICAL_ENTER(stateMux);
+    if (!hasTemperature || temp != temperature) changed |= WIDGET_TEMP;
+    temperature = temp;
+    hasTemperature = true;
+    changed |= WIDGET_SPARKLINE;
+    CRITICAL_EXIT(stateMux);
+}
+
+void dashboardSetConnected(bool isConnected) {
+    CRITICAL_ENTER(stateMux);
+    if (isConnected != connected) changed |= WIDGET_CONNECTION;
+    connected = isConnected;
+    CRITICAL_EXIT(stateMux);
+}
+
+void dashboardSetBattery(int8_t level) {
+    CRITICAL_ENTER(stateMux);
+    if (level != battery) changed |= WIDGET_BATTERY;
+    battery = level;
+    CRITICAL_EXIT(stateMux);
+}
+
+void dashboardInvalidate() {
+    CRITICAL_ENTER(stateMux);
+    changed = WIDGET_ALL;
+    CRITICAL_EXIT(stateMux);
+    canvas.invalidateAll();
+}
+
+uint32_t dashboardRefresh() {
+    // Snapshot the state so the setters are never blocked behind drawing.
+    CRITICAL_ENTER(stateMux);
+    uint8_t widgets = changed;
+    changed = 0;
+    int16_t temp = temperature;
+    bool isConnected = connected;
+    int8_t level = battery;
+    CRITICAL_EXIT(stateMux);
+
+    if (!widgets) return 0;
+    uint32_t start = micros();
+    if (widgets & WIDGET_TEMP) drawTemperature(temp);
+    if (widgets & WIDGET_SPARKLINE) drawSparkline();
+    if (widgets & WIDGET_CONNECTION) drawConnection(isConnected);
+    if (widgets & WIDGET_BATTERY) drawBattery(level);
+
+    uint32_t bytes = canvas.flush(pushToLcd);
+    diagSet("dash.render.us", micros() - start);
+    diagSet("dash.spi.bytes", bytes);
+    return bytes;
+}
+
+bool dashboardLoadScene() {
+    static bool started = false;
+    if (!started) started = dashboardBegin();
+
+    historyReset();
+    for (uint16_t i = 0; i < SPARKLINE_SAMPLES; i++) {
+        historyAppend(i * 60, 1800 + (int16_t)((i * 37) % 500) - 250);
+    }
+    dashboardSetTemperature(2150);
+    dashboardSetConnected(true);
+    dashboardSetBattery(75);
+    return started;
+}
+
+void dashboardBenchmark(uint16_t iterations) {
+    char text[8];
+
+    // Before: the LCD font engine drawing the seven segment font straight to the panel.
+    LCD.setTextColor(WHITE, BLACK);
+    uint32_t start = micros();
+    for (uint16_t i = 0; i < iterations; i++) {
+        formatTemperature(text, sizeof(text), true, (int16_t)(i % 50 - 10) * 100);
+        LCD.drawString(text, 80, TEMP_Y, 7);
+    }
+    diagSet("dash.font.us", (micros() - start) / iterations);
+
+    // After: glyph table blit into the canvas and a flush of the changed tiles.
+    bool known = hasTemperature;
+    hasTemperature = true;
+    start = micros();
+    for (uint16_t i = 0; i < iterations; i++) {
+        drawTemperature((int16_t)(i % 50 - 10) * 100);
+        canvas.flush(pushToLcd);
+    }
+    diagSet("dash.glyph.us", (micros() - start) / iterations);
+    hasTemperature = known;
+
+    dashboardInvalidate();
+}
@@ -0,0 +1,58 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_DASHBOARD_H_
+#define LIB_MYNWEN_DASHBOARD_H_
+
+#include <stdint.h>
+
+/**
+ * Dashboard screen: current temperature, trend sparkline, connection and battery status.
+ *
+ * The setters are cheap and safe to call from any task; they only record the value.
+ * dashboardRefresh() redraws the widgets whose value changed into an off-screen canvas
+ * and pushes just the changed tiles over SPI.
+ */
+const uint8_t SPARKLINE_SAMPLES = 64;  // newest history records shown in the trend
+
+bool dashboardBegin();
+
+/**
+ * Sets the current temperature in hundredths of a degree. The sparkline is read from the
+ * sample history, so the sample should already have been appended there.
+ */
+void dashboardSetTemperature(int16_t temp);
+void dashboardSetConnected(bool connected);
+void dashboardSetBattery(int8_t level);
+
+/**
+ * Forces a full repaint on the next refresh, eg. after the panel was cleared.
+ */
+void dashboardInvalidate();
+
+/**
+ * Redraws changed widgets and flushes them. Returns the number of pixel bytes sent.
+ */
+uint32_t dashboardRefresh();
+
+/**
+ * Fills the history and dashboard with a fixed scene, so renders are reproducible. For the
+ * simulator and the snapshot test; the history is reset.
+ */
+bool dashboardLoadScene();
+
+/**
+ * Times redrawing the temperature with the LCD font engine against the glyph cache and
+ * publishes the average microseconds per update to diagnostics. Leaves the canvas
+ * invalidated, so call dashboardRefresh() afterwards if the dashboard is showing.
+ */
+void dashboardBenchmark(uint16_t iterations);
+
+#endif  // LIB_MYNWEN_DASHBOARD_H_
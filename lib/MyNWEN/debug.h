@@ -28,34 +28,48 @@
 #define DEBUG 0
 #endif
 
-#include <M5Stack.h>
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+#include "console.h"
+#include "host.h"
 
 /**
  * This macro acts as a conditional debug wrapper to `Serial.print()`.
  **/
 #ifndef DEBUG_MSG
-#define DEBUG_MSG(level, ...)      \
-    if (DEBUG && level <= DEBUG) { \
-        M5.Lcd.print(__VA_ARGS__); \
-    }
+#define DEBUG_MSG(level, ...)                             \
+    do {                                                  \
+        if (DEBUG && level <= DEBUG) {                    \
+            if (consoleLock()) Serial.print(__VA_ARGS__); \
+            consoleUnlock();                              \
+        }                                                 \
+    } while (0)
 #endif
 /**
  * This macro acts as a conditional debug wrapper to `Serial.println()`.
  **/
 #ifndef DEBUG_MSG_LN
-#define DEBUG_MSG_LN(level, ...)     \
-    if (DEBUG && level <= DEBUG) {   \
-        M5.Lcd.println(__VA_ARGS__); \
-    }
+#define DEBUG_MSG_LN(level, ...)                            \
+    do {                                                    \
+        if (DEBUG && level <= DEBUG) {                      \
+            if (consoleLock()) Serial.println(__VA_ARGS__); \
+            consoleUnlock();                                \
+        }                                                   \
+    } while (0)
 #endif
 /**
  * This macro acts as a conditional debug wrapper to `Serial.printf()`.
  **/
 #ifndef DEBUG_MSG_F
-#define DEBUG_MSG_F(level, ...)     \
-    if (DEBUG && level <= DEBUG) {  \
-        M5.Lcd.printf(__VA_ARGS__); \
-    }
+#define DEBUG_MSG_F(level, ...)                            \
+    do {                                                   \
+        if (DEBUG && level <= DEBUG) {                     \
+            if (consoleLock()) Serial.printf(__VA_ARGS__); \
+            consoleUnlock();                               \
+        }                                                  \
+    } while (0)
 #endif
 
 #endif  // LIB_SOFTWARE_SRC_DEBUG_H_
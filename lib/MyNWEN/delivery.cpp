@@ -0,0 +1,145 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#include "delivery.h"
+
+#include <string.h>
+
+#include "critical.h"
+#include "diagnostics.h"
+#include "hotpath.h"
+
+struct Slot {
+    uint8_t addr[6];
+    bool used;
+    uint32_t connected;                  // connection counter, for replacement
+    uint32_t delivered;
+    uint32_t since[HISTORY_CHANNELS];    // first sequence number after the client appeared
+    uint32_t high[HISTORY_CHANNELS];     // one past the newest delivered
+    uint32_t window[HISTORY_CHANNELS][DELIVERY_WINDOW / 32];  // bit per sequence number
+};
+
+RTC_DATA_ATTR static Slot slots[DELIVERY_CLIENTS];
+RTC_DATA_ATTR static uint32_t connections = 0;
+static int8_t current = -1;  // connections do not survive deep sleep
+
+CRITICAL_DECLARE(deliveryMux);  // reads are recorded from the BLE task
+
+static uint32_t produced(const Slot &slot) {
+    uint32_t total = 0;
+    for (uint8_t c = 0; c < HISTORY_CHANNELS; c++) total += historyNextSeq(c) - slot.since[c];
+    return total;
+}
+
+static void publish() {
+    if (current < 0) return;
+    diagSet("dlv.produced", produced(slots[current]));
+    diagSet("dlv.delivered", slots[current].delivered);
+}
+
+/**
+ * Free slots first, then the least recently connected.
+ */
+static uint32_t rank(const Slot &slot) {
+    return slot.used ? slot.connected : 0;
+}
+
+void deliveryConnect(const uint8_t addr[6]) {
+    CRITICAL_ENTER(deliveryMux);
+    int8_t found = -1, victim = 0;
+    for (int8_t i = 0; i < DELIVERY_CLIENTS; i++) {
+        if (slots[i].used && memcmp(slots[i].addr, addr, 6) == 0) found = i;
+        if (rank(slots[i]) < rank(slots[victim])) victim = i;
+    }
+    if (found < 0) {
+        Slot &slot = slots[found = victim];
+        memset(&slot, 0, sizeof(slot));
+        memcpy(slot.addr, addr, 6);
+        slot.used = true;
+        for (uint8_t c = 0; c < HISTORY_CHANNELS; c++) slot.since[c] = slot.high[c] = historyNextSeq(c);
+    }
+    slots[found].connected = ++connections;
+    current = found;
+    CRITICAL_EXIT(deliveryMux);
+    publish();
+}
+
+void deliveryDisconnect() {
+    CRITICAL_ENTER(deliveryMux);
+    current = -1;
+    CRITICAL_EXIT(deliveryMux);
+}
+
+static bool HOT_IRAM_ATTR testAndSet(uint32_t *window, uint32_t seq) {
+    uint32_t bit = seq % DELIVERY_WINDOW;
+    uint32_t mask = 1u << (bit % 32);
+    bool set = window[bit / 32] & mask;
+    window[bit / 32] |= mask;
+    return set;
+}
+
+static void HOT_IRAM_ATTR clear(uint32_t *window, uint32_t seq) {
+    uint32_t bit = seq % DELIVERY_WINDOW;
+    window[bit / 32] &= ~(1u << (bit % 32));
+}
+
+void HOT_IRAM_ATTR deliveryRecord(uint8_t sensor, uint32_t seq, uint16_t n) {
+    if (sensor >= HISTORY_CHANNELS) return;
+
+    CRITICAL_ENTER(deliveryMux);
+    if (current >= 0) {
+        Slot &slot = slots[current];
+        uint32_t *window = slot.window[sensor];
+        for (uint32_t s = seq; s != seq + n; s++) {
+            if (s - slot.since[sensor] > INT32_MAX) continue;  // before the client appeared
+            if (s - slot.high[sensor] < INT32_MAX) {
+                // Newer than anything delivered: slide the window up to it.
+                uint32_t gap = s + 1 - slot.high[sensor];
+                if (gap > DELIVERY_WINDOW) gap = DELIVERY_WINDOW;
+                for (uint32_t i = 0; i < gap; i++) clear(window, s - i);
+                slot.high[sensor] = s + 1;
+            } else if (slot.high[sensor] - s > DELIVERY_WINDOW) {
+                continue;  // too old to tell whether it was already delivered
+            }
+            if (!testAndSet(window, s)) slot.delivered++;
+        }
+    }
+    CRITICAL_EXIT(deliveryMux);
+    publish();
+}
+
+uint8_t deliveryClients(DeliveryClient *out, uint8_t max) {
+    uint8_t n = 0;
+    CRITICAL_ENTER(deliveryMux);
+    // Selection by connection counter, newest first; there are only a few slots.
+    uint32_t below = UINT32_MAX;
+    while (n < max) {
+        int8_t best = -1;
+        for (int8_t i = 0; i < DELIVERY_CLIENTS; i++) {
+            if (!slots[i].used || slots[i].connected >= below) continue;
+            if (best < 0 || slots[i].connected > slots[best].connected) best = i;
+        }
+        if (best < 0) break;
+        memcpy(out[n].addr, slots[best].addr, 6);
+        out[n].produced = produced(slots[best]);
+        out[n].delivered = slots[best].delivered;
+        below = slots[best].connected;
+        n++;
+    }
+    CRITICAL_EXIT(deliveryMux);
+    return n;
+}
+
+void deliveryReset() {
+    CRITICAL_ENTER(deliveryMux);
+    memset(slots, 0, sizeof(slots));
+    current = -1;
+    CRITICAL_EXIT(deliveryMux);
+}
@@ -0,0 +1,62 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_DELIVERY_H_
+#define LIB_MYNWEN_DELIVERY_H_
+
+#include <stdint.h>
+
+#include "history.h"
+
+/**
+ * Per-client delivery accounting. For each client (by BLE address) seen since a cold boot
+ * it counts the samples produced since the client first connected against the distinct
+ * samples it has received, by read, notification or history, so the delivery efficiency
+ * of each gateway can be measured.
+ *
+ * Samples are told apart by their history sequence numbers. A window of the newest
+ * DELIVERY_WINDOW sequence numbers per sensor remembers which were delivered, so a
+ * sample read twice counts once; anything older than the window is not counted.
+ *
+ * Publishes dlv.produced and dlv.delivered for the connected client.
+ */
+const uint8_t DELIVERY_CLIENTS = 4;         // least recently connected is replaced
+const uint16_t DELIVERY_WINDOW = HISTORY_CAPACITY;
+
+struct DeliveryClient {
+    uint8_t addr[6];
+    uint32_t produced;
+    uint32_t delivered;
+};
+
+/**
+ * Makes addr the current client, adding it if new.
+ */
+void deliveryConnect(const uint8_t addr[6]);
+
+void deliveryDisconnect();
+
+/**
+ * Records that the current client received n consecutive samples of a sensor starting
+ * at seq. Ignored when no client is connected.
+ */
+void deliveryRecord(uint8_t sensor, uint32_t seq, uint16_t n = 1);
+
+/**
+ * Copies up to max clients, most recently connected first. Returns the number copied.
+ */
+uint8_t deliveryClients(DeliveryClient *clients, uint8_t max);
+
+/**
+ * Forgets every client.
+ */
+void deliveryReset();
+
+#endif  // LIB_MYNWEN_DELIVERY_H_
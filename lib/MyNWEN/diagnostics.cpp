@@ -0,0 +1,78 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#include "diagnostics.h"
+
+#include <string.h>
+
+#include "critical.h"
+
+struct DiagEntry {
+    const char *key;
+    int32_t value;
+};
+
+static DiagEntry entries[DIAG_CAPACITY];
+static uint8_t count = 0;
+
+CRITICAL_DECLARE(diagMux);
+
+/**
+ * Finds or creates the entry for key. Must hold diagMux. Returns NULL once full.
+ */
+static DiagEntry *lookup(const char *key) {
+    for (uint8_t i = 0; i < count; i++) {
+        if (entries[i].key == key || strcmp(entries[i].key, key) == 0) return &entries[i];
+    }
+    if (count == DIAG_CAPACITY) return NULL;
+
+    entries[count] = {key, 0};
+    return &entries[count++];
+}
+
+void diagSet(const char *key, int32_t value) {
+    CRITICAL_ENTER(diagMux);
+    DiagEntry *e = lookup(key);
+    if (e) e->value = value;
+    CRITICAL_EXIT(diagMux);
+}
+
+void diagAdd(const char *key, int32_t delta) {
+    CRITICAL_ENTER(diagMux);
+    DiagEntry *e = lookup(key);
+    if (e) e->value += delta;
+    CRITICAL_EXIT(diagMux);
+}
+
+int32_t diagGet(const char *key) {
+    int32_t value = 0;
+    CRITICAL_ENTER(diagMux);
+    for (uint8_t i = 0; i < count; i++) {
+        if (strcmp(entries[i].key, key) == 0) value = entries[i].value;
+    }
+    CRITICAL_EXIT(diagMux);
+    return value;
+}
+
+uint8_t diagCount() {
+    return count;
+}
+
+bool diagEntry(uint8_t index, const char **key, int32_t *value) {
+    bool found = false;
+    CRITICAL_ENTER(diagMux);
+    if (index < count) {
+        *key = entries[index].key;
+        *value = entries[index].value;
+        found = true;
+    }
+    CRITICAL_EXIT(diagMux);
+    return found;
+}
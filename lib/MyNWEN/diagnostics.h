@@ -0,0 +1,40 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_DIAGNOSTICS_H_
+#define LIB_MYNWEN_DIAGNOSTICS_H_
+
+#include <stdint.h>
+
+/**
+ * Diagnostics surface, a small table of named integer values that any module can publish
+ * and that is shown on the diagnostics screen.
+ *
+ * Keys are stored by pointer and must be string literals. Values are plain integers so
+ * units belong in the key, eg. "lcd.dim.mA10" for tenths of a milliamp.
+ */
+const uint8_t DIAG_CAPACITY = 56;
+
+void diagSet(const char *key, int32_t value);
+void diagAdd(const char *key, int32_t delta);
+
+/**
+ * Returns the value for key, or 0 if it was never set.
+ */
+int32_t diagGet(const char *key);
+
+uint8_t diagCount();
+
+/**
+ * Reads the entry at index in insertion order. Returns false if out of range.
+ */
+bool diagEntry(uint8_t index, const char **key, int32_t *value);
+
+#endif  // LIB_MYNWEN_DIAGNOSTICS_H_
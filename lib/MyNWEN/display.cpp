@@ -0,0 +1,183 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifdef ARDUINO
+#include "display.h"
+
+#include <M5Stack.h>
+
+#include "dashboard.h"
+#include "diagnostics.h"
+#include "display_power.h"
+#include "history_graph.h"
+
+enum DisplayCommand : uint8_t {
+    DISPLAY_SAMPLE,
+    DISPLAY_BATTERY,
+    DISPLAY_NEXT_SCREEN,
+    DISPLAY_WAKE,
+};
+
+struct DisplayMessage {
+    DisplayCommand command;
+    int16_t value;
+};
+
+static const uint32_t DISPLAY_TASK_STACK = 4096;
+static const UBaseType_t DISPLAY_TASK_PRIORITY = 1;  // below BLE and the main loop
+static const uint16_t BENCHMARK_ITERATIONS = 20;
+static const uint8_t DIAG_ROWS = 240 / 8 - 1;  // size 1 text, the last row for the page
+
+static QueueHandle_t displayQueue = NULL;
+static SemaphoreHandle_t drawLock = NULL;  // held by the display task while it works
+static Screen screen = SCREEN_DASHBOARD;
+static bool stale = true;  // screen content is out of date while the panel is dark
+static uint8_t diagPage = 0;
+
+static void post(DisplayCommand command, int16_t value) {
+    DisplayMessage msg = {command, value};
+    if (displayQueue) xQueueSend(displayQueue, &msg, 0);
+}
+
+static uint8_t diagPages() {
+    uint8_t n = diagCount();
+    return n ? (n + DIAG_ROWS - 1) / DIAG_ROWS : 1;
+}
+
+/**
+ * Prints a page of the diagnostics table, one entry per line, and the page number.
+ */
+static void drawDiagnostics() {
+    M5.Lcd.setTextColor(WHITE, BLACK);
+    M5.Lcd.setTextSize(1);
+    M5.Lcd.setCursor(0, 0);
+
+    const char *key;
+    int32_t value;
+    uint8_t first = diagPage * DIAG_ROWS;
+    for (uint8_t i = first; i < first + DIAG_ROWS && diagEntry(i, &key, &value); i++) {
+        M5.Lcd.printf("%-24s %10ld\n", key, (long)value);
+    }
+    M5.Lcd.setCursor(0, DIAG_ROWS * 8);
+    M5.Lcd.printf("page %u/%u", diagPage + 1, diagPages());
+}
+
+static void showScreen(Screen next) {
+    if (screen == SCREEN_HISTORY) historyGraphHide();
+    screen = next;
+    stale = false;
+
+    if (screen == SCREEN_HISTORY) {
+        historyGraphShow();
+    } else if (screen == SCREEN_DIAGNOSTICS) {
+        // Rendering cost is only measured on demand, when a technician opens diagnostics.
+        static bool benchmarked = false;
+        if (!benchmarked) {
+            dashboardBenchmark(BENCHMARK_ITERATIONS);
+            benchmarked = true;
+        }
+        if (diagPage >= diagPages()) diagPage = 0;
+        M5.Lcd.fillScreen(BLACK);
+        dashboardInvalidate();
+    } else {
+        M5.Lcd.fillScreen(BLACK);
+        dashboardInvalidate();
+    }
+}
+
+static void handle(const DisplayMessage &msg) {
+    switch (msg.command) {
+        case DISPLAY_SAMPLE:
+            dashboardSetTemperature(msg.value);
+            if (screen == SCREEN_HISTORY && !stale) historyGraphAppend(msg.value);
+            break;
+        case DISPLAY_BATTERY:
+            dashboardSetBattery(msg.value);
+            break;
+        case DISPLAY_NEXT_SCREEN:
+            // A press on a dark panel only wakes it. Diagnostics steps through its pages
+            // before moving on.
+            if (displayPowerWake(millis())) {
+                showScreen(screen);
+            } else if (screen == SCREEN_DIAGNOSTICS && diagPage + 1 < diagPages()) {
+                diagPage++;
+                showScreen(screen);
+            } else {
+                diagPage = 0;
+                showScreen((Screen)((screen + 1) % SCREEN_COUNT));
+            }
+            break;
+        case DISPLAY_WAKE:
+            if (displayPowerWake(millis())) showScreen(screen);
+            break;
+    }
+}
+
+static void displayTask(void *arg) {
+    DisplayMessage msg;
+
+    while (true) {
+        TickType_t refresh = pdMS_TO_TICKS(DISPLAY_REFRESH_MS);
+        bool received = xQueueReceive(displayQueue, &msg, refresh) == pdTRUE;
+        xSemaphoreTake(drawLock, portMAX_DELAY);
+        if (received) handle(msg);
+
+        displayPowerTick(millis());
+        if (!displayPowerVisible()) {
+            stale = true;
+        } else if (screen == SCREEN_DASHBOARD) {
+            dashboardRefresh();
+        } else if (screen == SCREEN_DIAGNOSTICS) {
+            drawDiagnostics();
+        }
+        xSemaphoreGive(drawLock);
+    }
+}
+
+void displayBegin(bool interactive) {
+    displayPowerBegin(interactive, millis());
+    stale = !displayPowerVisible();
+
+    displayQueue = xQueueCreate(16, sizeof(DisplayMessage));
+    drawLock = xSemaphoreCreateMutex();
+    xTaskCreatePinnedToCore(displayTask, "display", DISPLAY_TASK_STACK, NULL,
+                            DISPLAY_TASK_PRIORITY, NULL, APP_CPU_NUM);
+}
+
+void displayPostSample(int16_t value) {
+    post(DISPLAY_SAMPLE, value);
+}
+
+void displayPostBattery(int16_t percent) {
+    post(DISPLAY_BATTERY, percent);
+}
+
+void displayNextScreen() {
+    post(DISPLAY_NEXT_SCREEN, 0);
+}
+
+void displayWake() {
+    post(DISPLAY_WAKE, 0);
+}
+
+bool displayDark() {
+    return !displayPowerVisible();  // a single byte, safe to read from any task
+}
+
+void displaySuspend() {
+    if (!drawLock) return;
+    xSemaphoreTake(drawLock, portMAX_DELAY);
+    displayPowerSleep(millis());  // the display task is held off, so this is its call
+}
+
+void displayResume() {
+    if (drawLock) xSemaphoreGive(drawLock);
+}
+#endif
@@ -0,0 +1,69 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_DISPLAY_H_
+#define LIB_MYNWEN_DISPLAY_H_
+
+#include <stdint.h>
+
+/**
+ * Display task. All LCD rendering happens here, at low priority, so neither the BLE
+ * callbacks nor the sampling path ever wait on SPI. Other tasks only post messages.
+ */
+enum Screen : uint8_t {
+    SCREEN_DASHBOARD = 0,
+    SCREEN_HISTORY,
+    SCREEN_DIAGNOSTICS,
+    SCREEN_COUNT,
+};
+
+const uint32_t DISPLAY_REFRESH_MS = 500;  // status refresh when no messages arrive
+
+/**
+ * Starts the display task. The panel only lights up if the wake is interactive.
+ */
+void displayBegin(bool interactive);
+
+/**
+ * Queues a new sample for the dashboard and history graph. Never blocks; the sample is
+ * dropped from the screen (not from history) if the queue is full.
+ */
+void displayPostSample(int16_t value);
+
+/**
+ * Queues a new battery level, in percent, for the dashboard. The loop owns the power IC's
+ * I2C bus, so the display never reads it itself.
+ */
+void displayPostBattery(int16_t percent);
+
+/**
+ * Cycles to the next screen, or the next page of the diagnostics screen.
+ */
+void displayNextScreen();
+
+/**
+ * True while the backlight is off, when a press should only wake the panel.
+ */
+bool displayDark();
+
+/**
+ * Registers an interaction, bringing the panel back to full brightness.
+ */
+void displayWake();
+
+/**
+ * Waits for the display task to finish what it is drawing, holds it off and puts the
+ * panel to sleep, before a light sleep. displayResume() lets it run again; the panel
+ * stays asleep until the next displayWake().
+ */
+void displaySuspend();
+void displayResume();
+
+#endif  // LIB_MYNWEN_DISPLAY_H_
@@ -0,0 +1,106 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifdef ARDUINO
+#include "display_power.h"
+
+#include <M5Stack.h>
+
+#include "diagnostics.h"
+#include "energy.h"
+#include "timesync.h"
+
+struct PowerStage {
+    uint8_t brightness;
+    EnergyState energy;
+    uint32_t timeoutMs;  // idle time before stepping down, 0 for never
+    int32_t currentMa10;  // estimated panel + backlight draw, tenths of a mA
+    const char *timeKey;
+    const char *currentKey;
+};
+
+/**
+ * Current estimates for the M5Stack Core panel and backlight LED driver only, derived from
+ * the datasheets and the backlight PWM duty. Replace them with supply measurements.
+ */
+static const PowerStage STAGES[DISPLAY_POWER_COUNT] = {
+    {75, ENERGY_LCD_ACTIVE, DISPLAY_ACTIVE_MS, 300, "lcd.active.ms", "lcd.active.mA10"},
+    {15, ENERGY_LCD_DIM, DISPLAY_DIM_MS, 80, "lcd.dim.ms", "lcd.dim.mA10"},
+    {0, ENERGY_LCD_OFF, DISPLAY_OFF_MS, 40, "lcd.off.ms", "lcd.off.mA10"},
+    {0, ENERGY_LCD_SLEEP, 0, 1, "lcd.sleep.ms", "lcd.sleep.mA10"},
+};
+
+static DisplayPower state = DISPLAY_POWER_ACTIVE;
+static uint32_t enteredMs = 0;      // when the current state was entered
+static uint32_t accountedMs = 0;    // up to when time has been accounted
+static uint64_t chargeMa10Ms = 0;   // accumulated tenths-of-mA milliseconds
+
+/**
+ * Charges the time since the last accounting to the current state.
+ */
+static void account(uint32_t nowMs) {
+    uint32_t elapsed = nowMs - accountedMs;
+    accountedMs = nowMs;
+
+    diagAdd(STAGES[state].timeKey, elapsed);
+    chargeMa10Ms += (uint64_t)elapsed * STAGES[state].currentMa10;
+    diagSet("lcd.uAh", (int32_t)(chargeMa10Ms / 36000));
+}
+
+static void enter(DisplayPower next, uint32_t nowMs) {
+    account(nowMs);
+    DisplayPower prev = state;
+    state = next;
+    enteredMs = nowMs;
+    energyEnter(STAGES[next].energy, timeSyncMonotonicMs());
+
+    if (prev == DISPLAY_POWER_SLEEP && next != DISPLAY_POWER_SLEEP) M5.Lcd.wakeup();
+    M5.Lcd.setBrightness(STAGES[next].brightness);
+    if (next == DISPLAY_POWER_SLEEP) M5.Lcd.sleep();
+}
+
+void displayPowerBegin(bool interactive, uint32_t nowMs) {
+    for (uint8_t i = 0; i < DISPLAY_POWER_COUNT; i++) {
+        diagSet(STAGES[i].currentKey, STAGES[i].currentMa10);
+        diagSet(STAGES[i].timeKey, 0);
+    }
+
+    accountedMs = nowMs;
+    state = DISPLAY_POWER_ACTIVE;
+    enter(interactive ? DISPLAY_POWER_ACTIVE : DISPLAY_POWER_SLEEP, nowMs);
+}
+
+void displayPowerTick(uint32_t nowMs) {
+    const PowerStage &stage = STAGES[state];
+    if (stage.timeoutMs && nowMs - enteredMs >= stage.timeoutMs) {
+        enter((DisplayPower)(state + 1), nowMs);
+    } else {
+        account(nowMs);
+    }
+}
+
+bool displayPowerWake(uint32_t nowMs) {
+    bool wasVisible = displayPowerVisible();
+    enter(DISPLAY_POWER_ACTIVE, nowMs);
+    return !wasVisible;
+}
+
+void displayPowerSleep(uint32_t nowMs) {
+    if (state != DISPLAY_POWER_SLEEP) enter(DISPLAY_POWER_SLEEP, nowMs);
+}
+
+DisplayPower displayPowerState() {
+    return state;
+}
+
+bool displayPowerVisible() {
+    return state == DISPLAY_POWER_ACTIVE || state == DISPLAY_POWER_DIM;
+}
+#endif
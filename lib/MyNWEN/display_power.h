@@ -0,0 +1,64 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_DISPLAY_POWER_H_
+#define LIB_MYNWEN_DISPLAY_POWER_H_
+
+#include <stdint.h>
+
+/**
+ * Display power manager. Steps the backlight down in stages after the last interaction
+ * and finally puts the panel itself to sleep. Only call these from the display task.
+ */
+enum DisplayPower : uint8_t {
+    DISPLAY_POWER_ACTIVE = 0,
+    DISPLAY_POWER_DIM,
+    DISPLAY_POWER_OFF,    // backlight off, panel still scanning
+    DISPLAY_POWER_SLEEP,  // panel in sleep mode
+    DISPLAY_POWER_COUNT,
+};
+
+/**
+ * Time spent idle in each state before stepping down to the next one.
+ */
+const uint32_t DISPLAY_ACTIVE_MS = 15000;
+const uint32_t DISPLAY_DIM_MS = 15000;
+const uint32_t DISPLAY_OFF_MS = 5000;
+
+/**
+ * Starts in the active state when someone is likely looking (button wake, cold boot or a
+ * DEBUG build), otherwise straight to sleep so timer wakes never light the panel.
+ */
+void displayPowerBegin(bool interactive, uint32_t nowMs);
+
+/**
+ * Steps down if the current state has timed out and accounts the time spent in it.
+ */
+void displayPowerTick(uint32_t nowMs);
+
+/**
+ * Registers an interaction. Returns true if the panel was not visible before, in which
+ * case the caller should repaint rather than act on the press.
+ */
+bool displayPowerWake(uint32_t nowMs);
+
+/**
+ * Puts the panel to sleep now, as before a light sleep.
+ */
+void displayPowerSleep(uint32_t nowMs);
+
+DisplayPower displayPowerState();
+
+/**
+ * True while the backlight is on and drawing is worth doing.
+ */
+bool displayPowerVisible();
+
+#endif  // LIB_MYNWEN_DISPLAY_POWER_H_
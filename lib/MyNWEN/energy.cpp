@@ -0,0 +1,142 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#include "energy.h"
+
+#include <string.h>
+
+#include "critical.h"
+#include "diagnostics.h"
+
+static const char *NAMES[ENERGY_STATES] = {
+    "cpu sleep", "cpu light sleep", "cpu boot", "cpu run", "cpu idle", "cpu doze",
+    "radio off", "radio init", "radio advertising", "radio connected",
+    "lcd sleep", "lcd off", "lcd dim", "lcd active",
+};
+
+static const char *DIAG_KEYS[ENERGY_COMPONENTS + 1] = {
+    "energy.cpu.uAh/d", "energy.radio.uAh/d", "energy.lcd.uAh/d", "energy.total.uAh/d",
+};
+
+static uint16_t currents[ENERGY_STATES];
+
+RTC_DATA_ATTR static EnergyTotals totals[ENERGY_STATES];
+RTC_DATA_ATTR static EnergyState current[ENERGY_COMPONENTS];
+RTC_DATA_ATTR static uint64_t since[ENERGY_COMPONENTS];  // of the component's last change
+RTC_DATA_ATTR static uint64_t startMs = 0;
+RTC_DATA_ATTR static bool started = false;
+
+// The display task moves the LCD while the loop moves the rest.
+CRITICAL_DECLARE(lock);
+
+EnergyComponent energyComponent(EnergyState state) {
+    if (state < ENERGY_RADIO_OFF) return ENERGY_CPU;
+    return state < ENERGY_LCD_SLEEP ? ENERGY_RADIO : ENERGY_LCD;
+}
+
+const char *energyStateName(EnergyState state) {
+    return NAMES[state];
+}
+
+/**
+ * Charges a component's current state up to now. Call with the lock held.
+ */
+static void charge(EnergyComponent c, uint64_t now) {
+    if (now <= since[c]) return;
+    uint64_t elapsed = now - since[c];
+    totals[current[c]].ms += elapsed;
+    totals[current[c]].chargeMa10Ms += elapsed * currents[current[c]];
+    since[c] = now;
+}
+
+void energyReset(uint64_t now) {
+    CRITICAL_ENTER(lock);
+    memset(totals, 0, sizeof(totals));
+    current[ENERGY_CPU] = ENERGY_CPU_BOOT;
+    current[ENERGY_RADIO] = ENERGY_RADIO_OFF;
+    current[ENERGY_LCD] = ENERGY_LCD_SLEEP;
+    for (uint64_t &s : since) s = now;
+    startMs = now;
+    started = true;
+    CRITICAL_EXIT(lock);
+}
+
+void energyBegin(uint64_t now, const uint16_t *currentsMa10) {
+    memcpy(currents, currentsMa10 ? currentsMa10 : ENERGY_DEFAULT_MA10, sizeof(currents));
+    if (!started) energyReset(now);
+}
+
+void energyEnter(EnergyState state, uint64_t now) {
+    EnergyComponent c = energyComponent(state);
+    CRITICAL_ENTER(lock);
+    charge(c, now);
+    current[c] = state;
+    CRITICAL_EXIT(lock);
+}
+
+void energyWake(uint64_t now, uint32_t bootMs) {
+    CRITICAL_ENTER(lock);
+    if (current[ENERGY_CPU] == ENERGY_CPU_SLEEP) {
+        charge(ENERGY_CPU, now > bootMs ? now - bootMs : 0);
+        current[ENERGY_CPU] = ENERGY_CPU_BOOT;
+    }
+    charge(ENERGY_CPU, now);
+    current[ENERGY_CPU] = ENERGY_CPU_RUN;
+    CRITICAL_EXIT(lock);
+}
+
+void energySleep(uint64_t now) {
+    energyEnter(ENERGY_CPU_SLEEP, now);
+    energyEnter(ENERGY_RADIO_OFF, now);
+    energyEnter(ENERGY_LCD_SLEEP, now);
+}
+
+uint16_t energyCurrentMa10(EnergyState state) {
+    return currents[state];
+}
+
+EnergyTotals energyTotals(EnergyState state, uint64_t now) {
+    EnergyComponent c = energyComponent(state);
+    CRITICAL_ENTER(lock);
+    EnergyTotals t = totals[state];
+    if (current[c] == state && now > since[c]) {
+        t.ms += now - since[c];
+        t.chargeMa10Ms += (now - since[c]) * currents[state];
+    }
+    CRITICAL_EXIT(lock);
+    return t;
+}
+
+static uint64_t chargeOf(EnergyComponent component, uint64_t now) {
+    uint64_t charge = 0;
+    for (uint8_t s = 0; s < ENERGY_STATES; s++) {
+        if (component != ENERGY_COMPONENTS && energyComponent((EnergyState)s) != component) continue;
+        charge += energyTotals((EnergyState)s, now).chargeMa10Ms;
+    }
+    return charge;
+}
+
+uint64_t energyChargeMa10Ms(uint64_t now) {
+    return chargeOf(ENERGY_COMPONENTS, now);
+}
+
+uint32_t energyMicroAhPerDay(EnergyComponent component, uint64_t now) {
+    if (now <= startMs) return 0;
+
+    uint64_t charge = chargeOf(component, now);
+    // mA10 ms to µAh is / 36000, and a day is 86400000 ms.
+    return charge * 2400 / (now - startMs);
+}
+
+void energyPublish(uint64_t now) {
+    for (uint8_t c = 0; c <= ENERGY_COMPONENTS; c++) {
+        diagSet(DIAG_KEYS[c], energyMicroAhPerDay((EnergyComponent)c, now));
+    }
+}
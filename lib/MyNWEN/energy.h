@@ -0,0 +1,124 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_ENERGY_H_
+#define LIB_MYNWEN_ENERGY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Energy accounting against a per-state current model.
+ *
+ * Each component (CPU, radio, LCD) is in one state at a time. Every change charges the
+ * time since the component's last change to its old state, at that state's current from
+ * the table, so the draw of a duty cycle is split into boot, BLE init, advertising,
+ * connection, LCD and the loop, running or blocked. Components draw at the same time and
+ * add up. Totals are kept in RTC memory, so deep sleep, measured on the monotonic clock
+ * across it, is accounted too. Results are mAh per day over the time accounted, on the
+ * diagnostics surface and in the host simulator (energy-sim).
+ */
+enum EnergyComponent : uint8_t {
+    ENERGY_CPU = 0,
+    ENERGY_RADIO,
+    ENERGY_LCD,
+    ENERGY_COMPONENTS,
+};
+
+enum EnergyState : uint8_t {
+    ENERGY_CPU_SLEEP = 0,  // deep sleep, the board's quiescent draw
+    ENERGY_CPU_LIGHT_SLEEP,
+    ENERGY_CPU_BOOT,       // from the wake to setup()
+    ENERGY_CPU_RUN,
+    ENERGY_CPU_IDLE,       // loop() blocked
+    ENERGY_CPU_DOZE,       // loop() blocked, light sleeping between radio events
+    ENERGY_RADIO_OFF,
+    ENERGY_RADIO_INIT,     // BLEDevice::init() and the GATT setup
+    ENERGY_RADIO_ADVERTISING,
+    ENERGY_RADIO_CONNECTED,
+    ENERGY_LCD_SLEEP,
+    ENERGY_LCD_OFF,        // panel scanning, backlight off
+    ENERGY_LCD_DIM,
+    ENERGY_LCD_ACTIVE,
+    ENERGY_STATES,
+};
+
+/**
+ * Default currents in tenths of a mA, added to the component's others at the same time.
+ * Estimates for the M5Stack Core at 240 MHz from the datasheets; replace them with supply
+ * measurements through energyBegin(). Dozing keeps the main crystal on for the radio's
+ * low power clock and wakes for every advertising or connection event.
+ */
+const uint16_t ENERGY_DEFAULT_MA10[ENERGY_STATES] = {
+    20, 28, 500, 680, 400, 50,  // CPU: sleep, light sleep, boot, run, idle, doze
+    0, 300, 150, 200,           // radio: off, init, advertising, connected
+    1, 40, 80, 300,             // LCD: sleep, off, dim, active (see display_power.cpp)
+};
+
+struct EnergyTotals {
+    uint64_t ms;
+    uint64_t chargeMa10Ms;  // tenths of a mA times milliseconds
+};
+
+/**
+ * Sets the current table, indexed by EnergyState; NULL for the defaults. The first call
+ * after a cold boot starts the accounting at now, with the CPU booting and the rest off.
+ */
+void energyBegin(uint64_t now, const uint16_t *currentsMa10 = NULL);
+
+/**
+ * Forgets the totals and starts over at now.
+ */
+void energyReset(uint64_t now);
+
+/**
+ * Moves state's component to it.
+ */
+void energyEnter(EnergyState state, uint64_t now);
+
+/**
+ * Accounts a deep sleep that just ended: the time since energySleep() less bootMs to
+ * sleep, the rest to boot. Leaves the CPU running.
+ */
+void energyWake(uint64_t now, uint32_t bootMs);
+
+/**
+ * Puts every component in its sleep state.
+ */
+void energySleep(uint64_t now);
+
+uint16_t energyCurrentMa10(EnergyState state);
+
+/**
+ * Totals for a state, the open interval up to now included.
+ */
+EnergyTotals energyTotals(EnergyState state, uint64_t now);
+
+EnergyComponent energyComponent(EnergyState state);
+
+const char *energyStateName(EnergyState state);
+
+/**
+ * Charge drawn by every component since the accounting started, up to now.
+ */
+uint64_t energyChargeMa10Ms(uint64_t now);
+
+/**
+ * Average draw of a component (or of all, with ENERGY_COMPONENTS) since the accounting
+ * started, in µAh per day.
+ */
+uint32_t energyMicroAhPerDay(EnergyComponent component, uint64_t now);
+
+/**
+ * Publishes the per component figures as diagnostics.
+ */
+void energyPublish(uint64_t now);
+
+#endif  // LIB_MYNWEN_ENERGY_H_
@@ -0,0 +1,155 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#include "gateway.h"
+
+#include <math.h>
+
+#include "critical.h"
+#include "diagnostics.h"
+
+RTC_DATA_ATTR static uint64_t connects[GATEWAY_HISTORY];  // oldest first
+RTC_DATA_ATTR static uint8_t count = 0;
+RTC_DATA_ATTR static GatewayModel model;
+RTC_DATA_ATTR static bool valid = false;
+RTC_DATA_ATTR static uint64_t plannedPoll = 0;  // poll the last sleep was planned around
+RTC_DATA_ATTR static uint8_t misses = 0;
+RTC_DATA_ATTR static uint16_t dither = 0;
+// Connections are recorded from the BLE task while the loop plans its sleeps.
+CRITICAL_DECLARE(lock);
+
+static int64_t roundDiv(int64_t a, int64_t b) {
+    return (a + b / 2) / b;
+}
+
+/**
+ * Fits connects[] as anchor + n * period. The shortest gap seeds the period (longer gaps
+ * are polls the node missed), then the period is refined over all gaps as total time over
+ * total polls, and the anchor is the mean phase about the newest connection. Called with
+ * the lock held.
+ */
+static void fit() {
+    valid = false;
+    if (count < GATEWAY_MIN_POLLS) return;
+
+    int64_t period = INT64_MAX;
+    for (uint8_t i = 1; i < count; i++) {
+        int64_t gap = connects[i] - connects[i - 1];
+        if (gap < period) period = gap;
+    }
+    for (uint8_t pass = 0; pass < 2; pass++) {
+        int64_t polls = 0;
+        for (uint8_t i = 1; i < count; i++) polls += roundDiv(connects[i] - connects[i - 1], period);
+        period = (connects[count - 1] - connects[0]) / polls;
+    }
+
+    const uint64_t newest = connects[count - 1];
+    int64_t sum = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        sum += (int64_t)(connects[i] + roundDiv(newest - connects[i], period) * period) - newest;
+    }
+    int64_t offset = sum / count;
+
+    double squares = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        int64_t r = (connects[i] + roundDiv(newest - connects[i], period) * period) - newest - offset;
+        squares += (double)r * r;
+    }
+
+    model.periodMs = period;
+    model.anchorMs = newest + offset;
+    model.jitterMs = sqrt(squares / count);
+    valid = model.jitterMs < model.periodMs / 8;
+}
+
+void gatewayConnected(uint64_t now) {
+    diagSet("gw.misses", 0);
+    CRITICAL_ENTER(lock);
+    plannedPoll = 0;
+    misses = 0;
+    bool record = !count || now - connects[count - 1] >= GATEWAY_MIN_PERIOD_MS;
+    if (record) {
+        if (count == GATEWAY_HISTORY) {
+            for (uint8_t i = 1; i < count; i++) connects[i - 1] = connects[i];
+            count--;
+        }
+        connects[count++] = now;
+        fit();
+    }
+    GatewayModel fitted = model;
+    CRITICAL_EXIT(lock);
+
+    if (!record) return;
+    diagSet("gw.period.ms", fitted.periodMs);
+    diagSet("gw.jitter.ms", fitted.jitterMs);
+}
+
+bool gatewayModel(GatewayModel *out) {
+    CRITICAL_ENTER(lock);
+    bool ok = valid;
+    if (ok) *out = model;
+    CRITICAL_EXIT(lock);
+    return ok;
+}
+
+static uint32_t lead() {
+    uint32_t ms = 3 * model.jitterMs + GATEWAY_LEAD_MIN_MS;
+    return ms > GATEWAY_LEAD_MAX_MS ? GATEWAY_LEAD_MAX_MS : ms;
+}
+
+uint32_t gatewayWindowMs() {
+    CRITICAL_ENTER(lock);
+    uint32_t ms = valid ? 2 * lead() : 0;
+    CRITICAL_EXIT(lock);
+    return ms;
+}
+
+/**
+ * Forgets the model. Called with the lock held.
+ */
+static void reset() {
+    count = 0;
+    valid = false;
+    plannedPoll = 0;
+    misses = 0;
+}
+
+uint32_t gatewayMsUntilWake(uint64_t now, uint32_t fallbackMs) {
+    CRITICAL_ENTER(lock);
+    // The poll we woke for should have connected by now.
+    int32_t missed = -1;
+    if (valid && plannedPoll && now > plannedPoll + lead()) {
+        missed = ++misses;
+        if (misses >= GATEWAY_MAX_MISSES) reset();
+    }
+
+    uint32_t ms;
+    if (!valid) {
+        // Golden ratio steps spread the offsets evenly without repeating.
+        dither = (dither + 618) % GATEWAY_DITHER_MS;
+        ms = fallbackMs + dither;
+    } else {
+        // Next poll we can still be awake ahead of.
+        int64_t since = now + lead() - model.anchorMs;
+        int64_t n = since <= 0 ? 0 : since / model.periodMs + 1;
+        plannedPoll = model.anchorMs + n * model.periodMs;
+        ms = plannedPoll - lead() - now;
+    }
+    CRITICAL_EXIT(lock);
+
+    if (missed >= 0) diagSet("gw.misses", missed);
+    return ms;
+}
+
+void gatewayReset() {
+    CRITICAL_ENTER(lock);
+    reset();
+    CRITICAL_EXIT(lock);
+}
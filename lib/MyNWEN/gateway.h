@@ -0,0 +1,69 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_GATEWAY_H_
+#define LIB_MYNWEN_GATEWAY_H_
+
+#include <stdint.h>
+
+/**
+ * Gateway poll prediction. Gateways poll on a fixed period, so connection times (kept in
+ * RTC memory) are fitted as anchor + n * period, allowing for polls the node slept
+ * through. Once the fit is tight the node can sleep until just before the next poll
+ * instead of duty cycling blindly. Repeated misses discard the model.
+ *
+ * Publishes gw.period.ms, gw.jitter.ms and gw.misses to diagnostics.
+ */
+const uint8_t GATEWAY_HISTORY = 16;       // connection times kept
+const uint8_t GATEWAY_MIN_POLLS = 4;      // before a model is trusted
+const uint8_t GATEWAY_MAX_MISSES = 3;     // consecutive, before it is discarded
+const uint32_t GATEWAY_MIN_PERIOD_MS = 5000;  // closer connections are the same poll
+const uint32_t GATEWAY_LEAD_MIN_MS = 100;
+const uint32_t GATEWAY_LEAD_MAX_MS = 3000;
+const uint32_t GATEWAY_DITHER_MS = 1000;  // fallback sleep spread, see gatewayMsUntilWake()
+
+struct GatewayModel {
+    uint32_t periodMs;
+    uint32_t jitterMs;  // RMS error of the fit
+    uint64_t anchorMs;  // a fitted poll time
+};
+
+/**
+ * Records a gateway connection and refits the model.
+ */
+void gatewayConnected(uint64_t now);
+
+/**
+ * Returns true and fills model if the polls are predictable.
+ */
+bool gatewayModel(GatewayModel *model);
+
+/**
+ * Called before sleeping. Returns how long to sleep so the node is awake just before the
+ * next expected poll. A planned poll that passed without a connection counts as a miss.
+ *
+ * Without a model it returns fallbackMs plus a dither of up to GATEWAY_DITHER_MS, so the
+ * awake window walks across every phase. A fixed cycle whose period divides the
+ * gateway's (eg. 2 s + 2 s against 60 s) would otherwise never see a poll to learn from.
+ */
+uint32_t gatewayMsUntilWake(uint64_t now, uint32_t fallbackMs);
+
+/**
+ * How long to stay awake after a planned wake to cover the poll's jitter, 0 without a
+ * model.
+ */
+uint32_t gatewayWindowMs();
+
+/**
+ * Forgets all connections and the model.
+ */
+void gatewayReset();
+
+#endif  // LIB_MYNWEN_GATEWAY_H_
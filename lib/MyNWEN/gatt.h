@@ -0,0 +1,282 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_GATT_H_
+#define LIB_MYNWEN_GATT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Declarative GATT schema. A service is a constexpr table of characteristics; the
+ * compiler validates it, sizes the attribute handle table and the value buffer, and
+ * GATT_SERVICE() generates static storage for every characteristic and descriptor. At
+ * boot begin() only constructs those objects in place and registers them.
+ *
+ *   static constexpr GattCharacteristic NODE[] = {
+ *       // uuid16  uuid128  properties            maxLen  description  read      write
+ *       {0x2A6E,   NULL,    GATT_READ | GATT_NOTIFY, 2,   "Temp",      readTemp, NULL},
+ *   };
+ *   GATT_SERVICE(nodeService, NODE);
+ *   ...
+ *   nodeService.begin(server, "224c9411-...");
+ */
+const uint32_t GATT_READ = 1 << 0;
+const uint32_t GATT_WRITE = 1 << 1;
+const uint32_t GATT_NOTIFY = 1 << 2;
+const uint32_t GATT_BROADCAST = 1 << 3;
+const uint32_t GATT_INDICATE = 1 << 4;
+const uint32_t GATT_WRITE_NR = 1 << 5;
+
+const uint16_t GATT_VALUE_MAX = 512;  // ATT_MAX_ATTR_LEN
+
+/**
+ * Encodes the current value into out (at most max bytes). Returns the value length.
+ */
+typedef size_t (*GattRead)(uint8_t *out, size_t max);
+
+/**
+ * Receives a value written by a client.
+ */
+typedef void (*GattWrite)(const uint8_t *data, size_t len);
+
+struct GattCharacteristic {
+    uint16_t uuid16;      // assigned number, or 0 when uuid128 is given
+    const char *uuid128;  // custom UUID string, or NULL
+    uint32_t properties;  // GATT_* flags
+    uint16_t maxLen;      // largest value the read encoder produces
+    const char *description;  // 0x2901 user description, or NULL
+    GattRead read;
+    GattWrite write;
+};
+
+/**
+ * Little endian value encoders for read handlers, and a decoder for written values.
+ */
+inline size_t gattPut16(uint8_t *out, uint16_t v) {
+    out[0] = v;
+    out[1] = v >> 8;
+    return 2;
+}
+
+inline size_t gattPut32(uint8_t *out, uint32_t v) {
+    gattPut16(out, v);
+    gattPut16(out + 2, v >> 16);
+    return 4;
+}
+
+inline uint16_t gattGet16(const uint8_t *in) {
+    return in[0] | in[1] << 8;
+}
+
+/**
+ * Read handler for a sint16 characteristic backed by a getter.
+ */
+template <int16_t (*Get)()>
+size_t gattReadSint16(uint8_t *out, size_t max) {
+    return max < 2 ? 0 : gattPut16(out, Get());
+}
+
+/**
+ * Read handler for a uint8 characteristic backed by a getter.
+ */
+template <uint8_t (*Get)()>
+size_t gattReadUint8(uint8_t *out, size_t max) {
+    if (max < 1) return 0;
+    out[0] = Get();
+    return 1;
+}
+
+/**
+ * Compile time schema checks and sizes.
+ */
+constexpr bool gattStrEqual(const char *a, const char *b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+constexpr bool gattSameUuid(const GattCharacteristic &a, const GattCharacteristic &b) {
+    return a.uuid16 ? a.uuid16 == b.uuid16 : b.uuid128 && gattStrEqual(a.uuid128, b.uuid128);
+}
+
+constexpr bool gattValid(const GattCharacteristic &c) {
+    return (c.uuid16 != 0) != (c.uuid128 != NULL) && c.properties && c.maxLen &&
+           c.maxLen <= GATT_VALUE_MAX &&
+           (!(c.properties & (GATT_READ | GATT_NOTIFY | GATT_INDICATE)) || c.read) &&
+           (!(c.properties & (GATT_WRITE | GATT_WRITE_NR)) || c.write);
+}
+
+template <size_t N>
+constexpr bool gattValid(const GattCharacteristic (&table)[N]) {
+    for (size_t i = 0; i < N; i++) {
+        if (!gattValid(table[i])) return false;
+        for (size_t j = 0; j < i; j++) {
+            if (gattSameUuid(table[i], table[j])) return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Attribute handles the service needs: its declaration, then per characteristic a
+ * declaration and value, plus one per descriptor (0x2901, and 0x2902 when it notifies).
+ */
+template <size_t N>
+constexpr uint16_t gattHandles(const GattCharacteristic (&table)[N]) {
+    uint16_t handles = 1;
+    for (size_t i = 0; i < N; i++) {
+        handles += 2;
+        if (table[i].description) handles++;
+        if (table[i].properties & (GATT_NOTIFY | GATT_INDICATE)) handles++;
+    }
+    return handles;
+}
+
+template <size_t N>
+constexpr uint16_t gattValueMax(const GattCharacteristic (&table)[N]) {
+    uint16_t max = 0;
+    for (size_t i = 0; i < N; i++) {
+        if (table[i].maxLen > max) max = table[i].maxLen;
+    }
+    return max;
+}
+
+/**
+ * Index of the characteristic with an assigned number, or N if absent.
+ */
+template <size_t N>
+constexpr size_t gattIndex(const GattCharacteristic (&table)[N], uint16_t uuid16) {
+    for (size_t i = 0; i < N; i++) {
+        if (table[i].uuid16 == uuid16) return i;
+    }
+    return N;
+}
+
+#ifdef ARDUINO
+#include <BLE2902.h>
+#include <BLEServer.h>
+
+#include <new>
+#include <type_traits>
+
+#include "hotpath.h"
+
+static_assert(GATT_READ == BLECharacteristic::PROPERTY_READ &&
+                  GATT_WRITE == BLECharacteristic::PROPERTY_WRITE &&
+                  GATT_NOTIFY == BLECharacteristic::PROPERTY_NOTIFY &&
+                  GATT_BROADCAST == BLECharacteristic::PROPERTY_BROADCAST &&
+                  GATT_INDICATE == BLECharacteristic::PROPERTY_INDICATE &&
+                  GATT_WRITE_NR == BLECharacteristic::PROPERTY_WRITE_NR,
+              "GATT_* flags must match BLECharacteristic properties");
+
+template <size_t N, const GattCharacteristic (&Table)[N]>
+class GattService {
+    static_assert(gattValid(Table), "GATT schema has an invalid or duplicate characteristic");
+
+   public:
+    static constexpr uint16_t HANDLES = gattHandles(Table);
+    static constexpr uint16_t VALUE_MAX = gattValueMax(Table);
+
+    /**
+     * Constructs and registers every characteristic, then starts the service.
+     */
+    BLEService *begin(BLEServer *server, const char *uuid) {
+        BLEService *service = server->createService(BLEUUID(uuid), HANDLES);
+        for (size_t i = 0; i < N; i++) {
+            const GattCharacteristic &spec = Table[i];
+            BLEUUID id = spec.uuid16 ? BLEUUID(spec.uuid16) : BLEUUID(spec.uuid128);
+            BLECharacteristic *c = new (&chars_[i]) BLECharacteristic(id, spec.properties);
+
+            if (spec.description) {
+                BLEDescriptor *d = new (&descs_[i]) BLEDescriptor(BLEUUID((uint16_t)0x2901));
+                d->setValue(spec.description);
+                c->addDescriptor(d);
+            }
+            if (spec.properties & (GATT_NOTIFY | GATT_INDICATE)) {
+                c->addDescriptor(new (&cccds_[i]) BLE2902());
+            }
+
+            callbacks_[i].service = this;
+            callbacks_[i].index = i;
+            c->setCallbacks(&callbacks_[i]);
+            service->addCharacteristic(c);
+        }
+        service->start();
+        return service;
+    }
+
+    BLECharacteristic *characteristic(size_t index) {
+        return reinterpret_cast<BLECharacteristic *>(&chars_[index]);
+    }
+
+    /**
+     * Whether the client has enabled notifications or indications on a characteristic.
+     */
+    bool subscribed(size_t index) {
+        if (!(Table[index].properties & (GATT_NOTIFY | GATT_INDICATE))) return false;
+        BLE2902 *cccd = reinterpret_cast<BLE2902 *>(&cccds_[index]);
+        return cccd->getNotifications() || cccd->getIndications();
+    }
+
+    /**
+     * Re-encodes a characteristic's value and notifies subscribed clients.
+     */
+    void notify(size_t index) {
+        refresh(index);
+        characteristic(index)->notify();
+    }
+
+   private:
+    struct Callbacks : public BLECharacteristicCallbacks {
+        GattService *service;
+        size_t index;
+
+        void onRead(BLECharacteristic *) {
+            uint32_t start = hotPathStart();
+            service->refresh(index);
+            hotPathEnd(HOT_PATH_READ, start);
+        }
+
+        void onWrite(BLECharacteristic *c) {
+            std::string value = c->getValue();
+            Table[index].write((const uint8_t *)value.data(), value.size());
+        }
+    };
+
+    /**
+     * Encodes on the caller's stack: reads arrive on the BLE task while notifications are
+     * sent from the loop, and setValue() copies the value anyway.
+     */
+    void refresh(size_t index) {
+        uint8_t value[VALUE_MAX];
+        size_t len = Table[index].read(value, Table[index].maxLen);
+        characteristic(index)->setValue(value, len);
+    }
+
+    template <typename T>
+    using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+    Storage<BLECharacteristic> chars_[N];
+    Storage<BLEDescriptor> descs_[N];
+    Storage<BLE2902> cccds_[N];
+    Callbacks callbacks_[N];
+};
+
+/**
+ * Declares a GattService with static storage for a characteristic table.
+ */
+#define GATT_SERVICE(name, table) \
+    GattService<sizeof(table) / sizeof((table)[0]), table> name
+#endif
+
+#endif  // LIB_MYNWEN_GATT_H_
@@ -0,0 +1,96 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#include "glyphs.h"
+
+#include <stddef.h>
+
+/**
+ * Glyph order in the table, and the lit segments of each (bit 0 = a ... bit 6 = g).
+ */
+static const char GLYPH_CHARS[] = "0123456789- ";
+static constexpr uint8_t GLYPH_COUNT = sizeof(GLYPH_CHARS) - 1;
+static constexpr uint8_t SEGMENTS[GLYPH_COUNT] = {
+    0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x6F, 0x40, 0x00,
+};
+
+/**
+ * Segment geometry. Each segment is a hexagon: a bar of half thickness HALF with pointed
+ * ends, running tip to tip between two centre lines less a one pixel gap.
+ */
+static constexpr int HALF = 4;
+static constexpr int GAP = 1;
+static constexpr int LEFT = HALF;
+static constexpr int RIGHT = GLYPH_W - 1 - HALF;
+static constexpr int TOP = HALF;
+static constexpr int MIDDLE = (GLYPH_H - 1) / 2;
+static constexpr int BOTTOM = GLYPH_H - 1 - HALF;
+
+struct Segment {
+    bool horizontal;
+    int centre;  // y for horizontal segments, x for vertical ones
+    int from;    // tip to tip along the segment
+    int to;
+};
+
+static constexpr Segment SEGMENT_SHAPES[7] = {
+    {true, TOP, LEFT + GAP, RIGHT - GAP},         // a
+    {false, RIGHT, TOP + GAP, MIDDLE - GAP},      // b
+    {false, RIGHT, MIDDLE + GAP, BOTTOM - GAP},   // c
+    {true, BOTTOM, LEFT + GAP, RIGHT - GAP},      // d
+    {false, LEFT, MIDDLE + GAP, BOTTOM - GAP},    // e
+    {false, LEFT, TOP + GAP, MIDDLE - GAP},       // f
+    {true, MIDDLE, LEFT + GAP, RIGHT - GAP},      // g
+};
+
+static constexpr int absolute(int v) {
+    return v < 0 ? -v : v;
+}
+
+static constexpr int maximum(int a, int b) {
+    return a > b ? a : b;
+}
+
+static constexpr bool insideSegment(const Segment &s, int x, int y) {
+    int across = s.horizontal ? y - s.centre : x - s.centre;
+    int along = s.horizontal ? x : y;
+    int taper = maximum(0, maximum(s.from + HALF - along, along - (s.to - HALF)));
+    return absolute(across) + taper < HALF;
+}
+
+struct GlyphTable {
+    uint8_t bits[GLYPH_COUNT][GLYPH_H * GLYPH_STRIDE];
+};
+
+static constexpr GlyphTable buildGlyphs() {
+    GlyphTable table{};
+    for (int g = 0; g < GLYPH_COUNT; g++) {
+        for (int y = 0; y < GLYPH_H; y++) {
+            for (int x = 0; x < GLYPH_W; x++) {
+                bool on = false;
+                for (int s = 0; s < 7; s++) {
+                    if ((SEGMENTS[g] >> s) & 1 && insideSegment(SEGMENT_SHAPES[s], x, y)) on = true;
+                }
+                if (on) table.bits[g][y * GLYPH_STRIDE + x / 8] |= 0x80 >> (x % 8);
+            }
+        }
+    }
+    return table;
+}
+
+// Evaluated by the compiler; const data is placed in flash (DROM) on the ESP32.
+static constexpr GlyphTable GLYPHS = buildGlyphs();
+
+const uint8_t *glyphBitmap(char c) {
+    for (uint8_t i = 0; i < GLYPH_COUNT; i++) {
+        if (GLYPH_CHARS[i] == c) return GLYPHS.bits[i];
+    }
+    return NULL;
+}
@@ -0,0 +1,31 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_GLYPHS_H_
+#define LIB_MYNWEN_GLYPHS_H_
+
+#include <stdint.h>
+
+/**
+ * Large seven segment digits, rendered by the compiler into a 1 bit bitmap table that
+ * lives in flash. Drawing a digit is then a straight bitmap blit rather than font
+ * rasterisation at runtime.
+ */
+const uint8_t GLYPH_W = 40;
+const uint8_t GLYPH_H = 64;
+const uint8_t GLYPH_STRIDE = GLYPH_W / 8;
+const uint8_t GLYPH_ADVANCE = GLYPH_W + 8;
+
+/**
+ * Returns the bitmap for '0'-'9', '-' or ' ' (rows byte aligned, MSB first), or NULL.
+ */
+const uint8_t *glyphBitmap(char c);
+
+#endif  // LIB_MYNWEN_GLYPHS_H_
@@ -0,0 +1,105 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#include "history.h"
+
+#include "critical.h"
+#include "hotpath.h"
+
+static const uint16_t TOTAL_CAPACITY =
+    HISTORY_CAPACITY + (HISTORY_CHANNELS - 1) * HISTORY_AUX_CAPACITY;
+
+RTC_DATA_ATTR static HistoryRecord records[TOTAL_CAPACITY];
+RTC_DATA_ATTR static uint16_t head[HISTORY_CHANNELS];  // next slot to write
+RTC_DATA_ATTR static uint16_t count[HISTORY_CHANNELS];
+RTC_DATA_ATTR static uint32_t nextSeq[HISTORY_CHANNELS];
+
+CRITICAL_DECLARE(historyMux);
+
+/**
+ * Channels are laid out back to back in one array, channel 0 first.
+ */
+static HistoryRecord *HOT_IRAM_ATTR ring(uint8_t channel) {
+    return channel ? &records[HISTORY_CAPACITY + (channel - 1) * HISTORY_AUX_CAPACITY] : records;
+}
+
+uint16_t HOT_IRAM_ATTR historyCapacity(uint8_t channel) {
+    if (channel >= HISTORY_CHANNELS) return 0;
+    return channel ? HISTORY_AUX_CAPACITY : HISTORY_CAPACITY;
+}
+
+uint32_t HOT_IRAM_ATTR historyAppend(uint32_t time, int16_t value, uint8_t channel) {
+    uint16_t capacity = historyCapacity(channel);
+    if (!capacity) return 0;
+
+    CRITICAL_ENTER(historyMux);
+    uint32_t seq = nextSeq[channel]++;
+    HistoryRecord &r = ring(channel)[head[channel]];
+    r.time = time;
+    r.value = value;
+    r.seq = seq;
+    head[channel] = (head[channel] + 1) % capacity;
+    if (count[channel] < capacity) count[channel]++;
+    CRITICAL_EXIT(historyMux);
+    return seq;
+}
+
+uint32_t historyNextSeq(uint8_t channel) {
+    return channel < HISTORY_CHANNELS ? nextSeq[channel] : 0;
+}
+
+uint32_t historySeq(uint16_t index, uint8_t channel) {
+    CRITICAL_ENTER(historyMux);
+    uint32_t seq = historyNextSeq(channel) - historyCount(channel) + index;
+    CRITICAL_EXIT(historyMux);
+    return seq;
+}
+
+uint32_t historySeqExpand(uint16_t seq, uint8_t channel) {
+    uint32_t next = historyNextSeq(channel);
+    return next - (uint16_t)(next - seq);
+}
+
+uint16_t historyCount(uint8_t channel) {
+    return channel < HISTORY_CHANNELS ? count[channel] : 0;
+}
+
+bool historyGet(uint16_t index, HistoryRecord *record, uint8_t channel) {
+    uint16_t capacity = historyCapacity(channel);
+    bool found = false;
+    CRITICAL_ENTER(historyMux);
+    if (index < historyCount(channel)) {
+        *record = ring(channel)[(head[channel] + capacity - count[channel] + index) % capacity];
+        found = true;
+    }
+    CRITICAL_EXIT(historyMux);
+    return found;
+}
+
+uint16_t historyLatest(HistoryRecord *out, uint16_t max, uint8_t channel) {
+    uint16_t capacity = historyCapacity(channel);
+    CRITICAL_ENTER(historyMux);
+    uint16_t held = historyCount(channel);
+    uint16_t n = held < max ? held : max;
+    for (uint16_t i = 0; i < n; i++) {
+        out[i] = ring(channel)[(head[channel] + capacity - n + i) % capacity];
+    }
+    CRITICAL_EXIT(historyMux);
+    return n;
+}
+
+void historyReset() {
+    CRITICAL_ENTER(historyMux);
+    for (uint8_t c = 0; c < HISTORY_CHANNELS; c++) {
+        head[c] = 0;
+        count[c] = 0;
+    }
+    CRITICAL_EXIT(historyMux);
+}
@@ -0,0 +1,81 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_HISTORY_H_
+#define LIB_MYNWEN_HISTORY_H_
+
+#include <stdint.h>
+
+/**
+ * On-device sample history, ring buffers in RTC memory so they survive deep sleep.
+ *
+ * There is one ring per channel (one per sensor). Channel 0 is the temperature and keeps
+ * the most records; the functions default to it.
+ *
+ * Every record appended to a channel takes the channel's next sequence number, so a
+ * reader can tell a missed sample from a repeated value. Sequences survive historyReset()
+ * and deep sleep, and only restart from 0 on a cold boot.
+ */
+const uint8_t HISTORY_CHANNELS = 4;
+const uint16_t HISTORY_CAPACITY = 256;     // channel 0
+const uint16_t HISTORY_AUX_CAPACITY = 64;  // every other channel
+
+struct HistoryRecord {
+    uint32_t time;  // seconds since the epoch, see timesync.h
+    int16_t value;  // in the channel's unit, eg. hundredths of a degree
+    uint16_t seq;   // low 16 bits of the sequence number
+};
+
+/**
+ * Appends a sample, overwriting the oldest once full. Returns its sequence number.
+ */
+uint32_t historyAppend(uint32_t time, int16_t value, uint8_t channel = 0);
+
+/**
+ * Sequence number the next record appended to the channel will take.
+ */
+uint32_t historyNextSeq(uint8_t channel = 0);
+
+/**
+ * Sequence number of the record at index (0 is the oldest held).
+ */
+uint32_t historySeq(uint16_t index, uint8_t channel = 0);
+
+/**
+ * Full sequence number of a recent sample given its low 16 bits, as carried on the wire.
+ */
+uint32_t historySeqExpand(uint16_t seq, uint8_t channel = 0);
+
+/**
+ * Number of records currently held.
+ */
+uint16_t historyCount(uint8_t channel = 0);
+
+/**
+ * Records a channel can hold, or 0 for an unknown channel.
+ */
+uint16_t historyCapacity(uint8_t channel = 0);
+
+/**
+ * Reads a record, where index 0 is the oldest held. Returns false if out of range.
+ */
+bool historyGet(uint16_t index, HistoryRecord *record, uint8_t channel = 0);
+
+/**
+ * Copies up to max of the newest records, oldest first. Returns the number copied.
+ */
+uint16_t historyLatest(HistoryRecord *records, uint16_t max, uint8_t channel = 0);
+
+/**
+ * Clears every channel.
+ */
+void historyReset();
+
+#endif  // LIB_MYNWEN_HISTORY_H_
@@ -0,0 +1,121 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifdef ARDUINO
+#include "history_graph.h"
+
+#include <M5Stack.h>
+
+#include "history.h"
+
+static const uint16_t SCREEN_W = 320;
+static const uint16_t SCREEN_H = 240;
+static const uint16_t SCROLL_H = SCREEN_H - HISTORY_GRAPH_HEADER;
+
+static const int16_t RANGE_LO = -1000;  // hundredths of a degree at x = 0
+static const int16_t RANGE_HI = 4000;   // hundredths of a degree at x = SCREEN_W - 1
+static const int16_t GRID_STEP = 1000;
+
+static const uint16_t COLOR_GRID = 0x2104;
+static const uint16_t COLOR_TRACE = 0x07FF;
+
+/**
+ * ILI9342C vertical scrolling commands.
+ */
+static const uint8_t CMD_VSCRDEF = 0x33;
+static const uint8_t CMD_VSCRSADD = 0x37;
+
+static uint16_t scrollTop = HISTORY_GRAPH_HEADER;  // memory line shown at the top
+static int16_t lastX = -1;
+static uint16_t row[SCREEN_W];
+
+static void setScrollArea(uint16_t top, uint16_t bottom) {
+    uint16_t height = SCREEN_H - top - bottom;
+    M5.Lcd.writecommand(CMD_VSCRDEF);
+    M5.Lcd.writedata(top >> 8);
+    M5.Lcd.writedata(top);
+    M5.Lcd.writedata(height >> 8);
+    M5.Lcd.writedata(height);
+    M5.Lcd.writedata(bottom >> 8);
+    M5.Lcd.writedata(bottom);
+}
+
+static void setScrollStart(uint16_t line) {
+    M5.Lcd.writecommand(CMD_VSCRSADD);
+    M5.Lcd.writedata(line >> 8);
+    M5.Lcd.writedata(line);
+}
+
+static uint16_t nextLine(uint16_t line) {
+    return line + 1 < SCREEN_H ? line + 1 : HISTORY_GRAPH_HEADER;
+}
+
+static int16_t valueToX(int16_t value) {
+    if (value < RANGE_LO) value = RANGE_LO;
+    if (value > RANGE_HI) value = RANGE_HI;
+    return (int32_t)(value - RANGE_LO) * (SCREEN_W - 1) / (RANGE_HI - RANGE_LO);
+}
+
+/**
+ * Renders one sample into the memory line currently at the top of the scroll area, then
+ * advances the scroll start so it becomes the bottom line.
+ */
+static void drawRow(int16_t value) {
+    const uint16_t grid = (COLOR_GRID >> 8) | (COLOR_GRID << 8);
+    const uint16_t trace = (COLOR_TRACE >> 8) | (COLOR_TRACE << 8);
+
+    memset(row, 0, sizeof(row));
+    for (int16_t g = RANGE_LO; g <= RANGE_HI; g += GRID_STEP) row[valueToX(g)] = grid;
+
+    int16_t x = valueToX(value);
+    int16_t from = lastX < 0 ? x : lastX;
+    for (int16_t i = min(from, x); i <= max(from, x); i++) row[i] = trace;
+    lastX = x;
+
+    M5.Lcd.pushImage(0, scrollTop, SCREEN_W, 1, row);
+    scrollTop = nextLine(scrollTop);
+}
+
+void historyGraphShow() {
+    M5.Lcd.fillScreen(BLACK);
+    setScrollArea(HISTORY_GRAPH_HEADER, 0);
+
+    // Axis labels live in the fixed area and are drawn once.
+    M5.Lcd.setTextColor(DARKGREY, BLACK);
+    M5.Lcd.setTextSize(1);
+    for (int16_t g = RANGE_LO; g <= RANGE_HI; g += GRID_STEP) {
+        int16_t x = valueToX(g);
+        M5.Lcd.setCursor(x > SCREEN_W - 18 ? SCREEN_W - 18 : x, 4);
+        M5.Lcd.print(g / 100);
+    }
+
+    scrollTop = HISTORY_GRAPH_HEADER;
+    lastX = -1;
+
+    static HistoryRecord records[SCROLL_H];
+    uint16_t n = historyLatest(records, SCROLL_H);
+
+    // Start the trace so the newest sample lands on the bottom line.
+    for (uint16_t i = n; i < SCROLL_H; i++) scrollTop = nextLine(scrollTop);
+    for (uint16_t i = 0; i < n; i++) drawRow(records[i].value);
+    setScrollStart(scrollTop);
+}
+
+void historyGraphHide() {
+    setScrollArea(0, 0);
+    setScrollStart(0);
+    M5.Lcd.fillScreen(BLACK);
+}
+
+void historyGraphAppend(int16_t value) {
+    drawRow(value);
+    setScrollStart(scrollTop);
+}
+#endif
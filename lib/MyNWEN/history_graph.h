@@ -0,0 +1,41 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_HISTORY_GRAPH_H_
+#define LIB_MYNWEN_HISTORY_GRAPH_H_
+
+#include <stdint.h>
+
+/**
+ * Strip chart of the sample history using the panel's hardware vertical scroll.
+ *
+ * On the M5Stack the controller scrolls along screen rows, so time runs bottom to top and
+ * temperature across. Each new sample writes a single 320 pixel row into the line that
+ * just scrolled off the top and moves the scroll start by one; nothing else is redrawn.
+ * Only call these from the display task.
+ */
+const uint16_t HISTORY_GRAPH_HEADER = 16;  // fixed rows above the scroll area
+
+/**
+ * Defines the scroll area and replays the newest history records into it.
+ */
+void historyGraphShow();
+
+/**
+ * Restores the identity scroll mapping so other screens can draw normally.
+ */
+void historyGraphHide();
+
+/**
+ * Draws the newest sample at the bottom of the graph.
+ */
+void historyGraphAppend(int16_t value);
+
+#endif  // LIB_MYNWEN_HISTORY_GRAPH_H_
@@ -0,0 +1,71 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef ARDUINO
+#include "host.h"
+
+#include <stdarg.h>
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+
+#include "console.h"
+
+static const std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+
+uint32_t micros() {
+    auto elapsed = std::chrono::steady_clock::now() - started;
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+uint32_t millis() {
+    return micros() / 1000;
+}
+
+void delay(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+HostSerial Serial;
+
+size_t HostSerial::print(const char *text) {
+    return fputs(text, out) < 0 ? 0 : strlen(text);
+}
+
+size_t HostSerial::print(long value) {
+    return fprintf(out, "%ld", value);
+}
+
+size_t HostSerial::print(unsigned long value) {
+    return fprintf(out, "%lu", value);
+}
+
+size_t HostSerial::println() {
+    return print("\r\n");
+}
+
+size_t HostSerial::printf(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int n = vfprintf(out, format, args);
+    va_end(args);
+    return n < 0 ? 0 : n;
+}
+
+/**
+ * The native build has a single task and no streaming, so Serial is always free.
+ */
+bool consoleLock() {
+    return true;
+}
+
+void consoleUnlock() {}
+#endif
@@ -0,0 +1,51 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_HOST_H_
+#define LIB_MYNWEN_HOST_H_
+
+#ifndef ARDUINO
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Stand-ins for the Arduino timing calls in the native build, backed by the host's
+ * monotonic clock.
+ */
+uint32_t micros();
+uint32_t millis();
+void delay(uint32_t ms);
+
+/**
+ * Stand-in for the Arduino Serial port, for the debug macros (see debug.h). Text goes to
+ * out, stderr unless a test redirects it.
+ */
+class HostSerial {
+   public:
+    FILE *out = stderr;
+
+    size_t print(const char *text);
+    size_t print(long value);
+    size_t print(unsigned long value);
+    size_t print(int value) { return print((long)value); }
+    size_t print(unsigned value) { return print((unsigned long)value); }
+    size_t println();
+    template <typename T>
+    size_t println(T value) {
+        size_t n = print(value);
+        return n + println();
+    }
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+extern HostSerial Serial;
+#endif
+
+#endif  // LIB_MYNWEN_HOST_H_
@@ -0,0 +1,43 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifdef ARDUINO
+#include "hotpath.h"
+
+#include <esp_timer.h>
+
+#include "diagnostics.h"
+
+static const char *COLD_KEYS[HOT_PATHS] = {"hot.read.cold.us", "hot.sample.cold.us"};
+static const char *WARM_KEYS[HOT_PATHS] = {"hot.read.warm.us", "hot.sample.warm.us"};
+static const uint8_t HOT_SMOOTHING = 4;  // a pass moves the warm figure a quarter of the way
+
+static bool cold[HOT_PATHS] = {true, true};  // RAM, so every boot starts cold like the cache
+static uint32_t warmUs[HOT_PATHS];
+
+uint32_t hotPathStart() {
+    return (uint32_t)esp_timer_get_time();
+}
+
+void hotPathEnd(HotPath path, uint32_t start) {
+    uint32_t us = (uint32_t)esp_timer_get_time() - start;
+    if (cold[path]) {
+        cold[path] = false;
+        diagSet(COLD_KEYS[path], us);
+        return;
+    }
+    if (warmUs[path] == 0) {
+        warmUs[path] = us;
+    } else {
+        warmUs[path] += ((int32_t)us - (int32_t)warmUs[path]) / HOT_SMOOTHING;
+    }
+    diagSet(WARM_KEYS[path], warmUs[path]);
+}
+#endif
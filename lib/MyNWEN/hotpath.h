@@ -0,0 +1,72 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_HOTPATH_H_
+#define LIB_MYNWEN_HOTPATH_H_
+
+#include <stdint.h>
+
+/**
+ * Placement and timing of the code a wake runs first.
+ *
+ * Code and constants are read from flash through a 32 KB cache, which every boot starts
+ * cold, so each first call stalls on flash reads. HOT_IRAM_ATTR puts a function in
+ * internal RAM and HOT_DRAM_ATTR a constant table in DRAM, outside the cache: the sample
+ * path from the sensor table to the history ring, the encoders and delivery accounting
+ * behind a client's read, and the stream's timer callback. The framework and the BLE
+ * stack stay in flash and still miss. What the placement saves on a first pass has not
+ * been measured; compare the timings below from builds with and without it. Neither
+ * attribute makes code safe to run with the cache disabled; that needs IRAM_ATTR and no
+ * calls into flash, as for the button ISR.
+ *
+ * IRAM is short, as the BLE controller takes most of it, so both go in sections of their
+ * own: tools/iram_budget.py, run after every firmware link, fails the build when they
+ * outgrow the budgets below or leave IRAM without headroom. HOT_IRAM selects the
+ * placement at build time, so builds with and without can be compared on the
+ * diagnostics surface: each boot publishes its first pass through the read and sample
+ * paths (hot.read.cold.us, hot.sample.cold.us) beside the later, warm ones (hot.*.warm.us).
+ */
+#ifndef HOT_IRAM
+#define HOT_IRAM 0
+#endif
+
+const uint16_t HOT_IRAM_BUDGET = 4096;  // bytes, read by tools/iram_budget.py
+const uint16_t HOT_DRAM_BUDGET = 1024;
+
+#if defined(ARDUINO) && HOT_IRAM
+#define HOT_STRINGIFY_(x) #x
+#define HOT_STRINGIFY(x) HOT_STRINGIFY_(x)
+// A section per function, as IRAM_ATTR does, so the linker can still drop unused ones.
+#define HOT_IRAM_ATTR __attribute__((section(".iram1.hot." HOT_STRINGIFY(__COUNTER__))))
+#define HOT_DRAM_ATTR __attribute__((section(".dram1.hot." HOT_STRINGIFY(__COUNTER__))))
+#else
+#define HOT_IRAM_ATTR
+#define HOT_DRAM_ATTR
+#endif
+
+#ifdef ARDUINO
+enum HotPath : uint8_t {
+    HOT_PATH_READ = 0,  // a client's read, from the GATT callback
+    HOT_PATH_SAMPLE,    // the sensors due, to the history ring and listeners
+    HOT_PATHS,
+};
+
+/**
+ * Starts timing a pass; hand the result to hotPathEnd().
+ */
+uint32_t hotPathStart();
+
+/**
+ * Publishes a pass: the first since boot as cold, later ones smoothed as warm.
+ */
+void hotPathEnd(HotPath path, uint32_t start);
+#endif
+
+#endif  // LIB_MYNWEN_HOTPATH_H_
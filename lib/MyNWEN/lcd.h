@@ -0,0 +1,29 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_LCD_H_
+#define LIB_MYNWEN_LCD_H_
+
+/**
+ * LCD backend selection. Code that should also render in the native build draws through
+ * LCD instead of M5.Lcd; on the host that is an in-memory framebuffer.
+ */
+#ifdef ARDUINO
+#include <M5Stack.h>
+
+#define LCD M5.Lcd
+#else
+#include "host.h"
+#include "lcd_mock.h"
+
+#define LCD mockLcd
+#endif
+
+#endif  // LIB_MYNWEN_LCD_H_
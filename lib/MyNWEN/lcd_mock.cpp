@@ -0,0 +1,234 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef ARDUINO
+#include "lcd_mock.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+MockLcd mockLcd;
+
+/**
+ * Approximate character cells of the TFT_eSPI fonts, indexed by font number.
+ */
+static const uint8_t FONT_CELL_W[] = {0, 6, 8, 0, 14, 0, 27, 32};
+static const uint8_t FONT_CELL_H[] = {0, 8, 16, 0, 26, 0, 48, 48};
+
+MockLcd::MockLcd()
+    : cursorX_(0),
+      cursorY_(0),
+      textFg_(WHITE),
+      textBg_(BLACK),
+      textBgSet_(false),
+      textSize_(1),
+      brightness_(0),
+      asleep_(false) {
+    memset(frame_, 0, sizeof(frame_));
+    resetStats();
+}
+
+void MockLcd::resetStats() {
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+/**
+ * Accounts a window write of w x h pixels.
+ */
+void MockLcd::window(int32_t x, int32_t y, int32_t w, int32_t h) {
+    (void)x;
+    (void)y;
+    stats_.transactions++;
+    stats_.pixels += w * h;
+    stats_.spiBytes += WINDOW_OVERHEAD + w * h * 2;
+}
+
+void MockLcd::fillScreen(uint16_t color) {
+    fillRect(0, 0, WIDTH, HEIGHT, color);
+}
+
+void MockLcd::fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t color) {
+    int32_t x0 = x < 0 ? 0 : x, y0 = y < 0 ? 0 : y;
+    int32_t x1 = x + w > WIDTH ? WIDTH : x + w, y1 = y + h > HEIGHT ? HEIGHT : y + h;
+    if (x0 >= x1 || y0 >= y1) return;
+
+    for (int32_t row = y0; row < y1; row++) {
+        for (int32_t col = x0; col < x1; col++) frame_[row * WIDTH + col] = color;
+    }
+    window(x0, y0, x1 - x0, y1 - y0);
+}
+
+void MockLcd::drawPixel(int32_t x, int32_t y, uint16_t color) {
+    if (x < 0 || y < 0 || x >= WIDTH || y >= HEIGHT) return;
+    frame_[y * WIDTH + x] = color;
+    window(x, y, 1, 1);
+}
+
+void MockLcd::pushImage(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t *data) {
+    for (int32_t row = 0; row < h; row++) {
+        for (int32_t col = 0; col < w; col++) {
+            int32_t px = x + col, py = y + row;
+            if (px < 0 || py < 0 || px >= WIDTH || py >= HEIGHT) continue;
+            uint16_t c = data[row * w + col];
+            frame_[py * WIDTH + px] = (c >> 8) | (c << 8);
+        }
+    }
+    window(x, y, w, h);
+}
+
+void MockLcd::setCursor(int16_t x, int16_t y) {
+    cursorX_ = x;
+    cursorY_ = y;
+}
+
+void MockLcd::setTextColor(uint16_t color) {
+    textFg_ = color;
+    textBgSet_ = false;
+}
+
+void MockLcd::setTextColor(uint16_t fg, uint16_t bg) {
+    textFg_ = fg;
+    textBg_ = bg;
+    textBgSet_ = true;
+}
+
+void MockLcd::setTextSize(uint8_t size) {
+    textSize_ = size ? size : 1;
+}
+
+void MockLcd::writecommand(uint8_t c) {
+    (void)c;
+    stats_.transactions++;
+    stats_.spiBytes++;
+}
+
+void MockLcd::writedata(uint8_t d) {
+    (void)d;
+    stats_.spiBytes++;
+}
+
+/**
+ * Draws one character cell: background, then ink derived from the character code so
+ * different text gives different (but stable) images. Returns the cell width.
+ */
+int16_t MockLcd::drawCell(int32_t x, int32_t y, char c, uint8_t cellW, uint8_t cellH) {
+    if (c == ' ') {
+        if (textBgSet_) fillRect(x, y, cellW, cellH, textBg_);
+        return cellW;
+    }
+
+    for (int32_t row = 0; row < cellH; row++) {
+        for (int32_t col = 0; col < cellW; col++) {
+            int32_t px = x + col, py = y + row;
+            if (px < 0 || py < 0 || px >= WIDTH || py >= HEIGHT) continue;
+            uint8_t bit = ((col * 5 / cellW) + 5 * (row * 7 / cellH)) % 32;
+            bool edge = col == cellW - 1 || row == cellH - 1;
+            bool ink = !edge && (((uint8_t)c * 2654435761u) >> bit) & 1;
+            if (ink) {
+                frame_[py * WIDTH + px] = textFg_;
+            } else if (textBgSet_) {
+                frame_[py * WIDTH + px] = textBg_;
+            }
+        }
+    }
+    window(x, y, cellW, cellH);
+    return cellW;
+}
+
+int16_t MockLcd::drawString(const char *text, int32_t x, int32_t y, uint8_t font) {
+    if (font >= sizeof(FONT_CELL_W) || !FONT_CELL_W[font]) font = 1;
+    int32_t start = x;
+    for (; *text; text++) {
+        x += drawCell(x, y, *text, FONT_CELL_W[font] * textSize_, FONT_CELL_H[font] * textSize_);
+    }
+    return x - start;
+}
+
+void MockLcd::print(const char *text) {
+    const uint8_t cellW = FONT_CELL_W[1] * textSize_, cellH = FONT_CELL_H[1] * textSize_;
+    for (; *text; text++) {
+        if (*text == '\n' || cursorX_ + cellW > WIDTH) {
+            cursorX_ = 0;
+            cursorY_ += cellH;
+            if (*text == '\n') continue;
+        }
+        cursorX_ += drawCell(cursorX_, cursorY_, *text, cellW, cellH);
+    }
+}
+
+void MockLcd::print(int value) {
+    char text[16];
+    snprintf(text, sizeof(text), "%d", value);
+    print(text);
+}
+
+void MockLcd::println(const char *text) {
+    print(text);
+    print("\n");
+}
+
+void MockLcd::println(int value) {
+    print(value);
+    print("\n");
+}
+
+void MockLcd::printf(const char *format, ...) {
+    char text[128];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    print(text);
+}
+
+bool MockLcd::dumpPpm(const char *path) const {
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+
+    fprintf(f, "P6\n%d %d\n255\n", WIDTH, HEIGHT);
+    for (uint32_t i = 0; i < (uint32_t)WIDTH * HEIGHT; i++) {
+        uint16_t c = frame_[i];
+        uint8_t rgb[3] = {
+            (uint8_t)(((c >> 11) & 0x1F) * 255 / 31),
+            (uint8_t)(((c >> 5) & 0x3F) * 255 / 63),
+            (uint8_t)((c & 0x1F) * 255 / 31),
+        };
+        fwrite(rgb, 1, sizeof(rgb), f);
+    }
+    return fclose(f) == 0;
+}
+
+int32_t MockLcd::diffPpm(const char *path) const {
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+
+    int w = 0, h = 0, max = 0;
+    if (fscanf(f, "P6 %d %d %d", &w, &h, &max) != 3 || w != WIDTH || h != HEIGHT || max != 255) {
+        fclose(f);
+        return -1;
+    }
+    fgetc(f);  // single whitespace after the header
+
+    int32_t differing = 0;
+    for (uint32_t i = 0; i < (uint32_t)WIDTH * HEIGHT; i++) {
+        uint8_t rgb[3];
+        if (fread(rgb, 1, sizeof(rgb), f) != sizeof(rgb)) {
+            fclose(f);
+            return -1;
+        }
+        uint16_t c = ((rgb[0] * 31 + 127) / 255) << 11 | ((rgb[1] * 63 + 127) / 255) << 5 |
+                     (rgb[2] * 31 + 127) / 255;
+        if (c != frame_[i]) differing++;
+    }
+    fclose(f);
+    return differing;
+}
+#endif
@@ -0,0 +1,123 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_LCD_MOCK_H_
+#define LIB_MYNWEN_LCD_MOCK_H_
+
+#ifndef ARDUINO
+#include <stdint.h>
+
+/**
+ * TFT_eSPI colour names used by the firmware.
+ */
+#define BLACK 0x0000
+#define WHITE 0xFFFF
+#define DARKGREY 0x7BEF
+
+/**
+ * Native stand-in for M5.Lcd. Renders into a 320x240 RGB565 framebuffer and counts what
+ * the real panel would have been sent.
+ *
+ * The SPI model follows the ILI9342C: every window write costs CASET, RASET and RAMWR
+ * (11 bytes) plus two bytes per pixel. Text is drawn as solid character cells with a
+ * deterministic ink pattern rather than real font shapes; the cost matches what the
+ * font engine sends (the whole cell) so benchmarks stay meaningful.
+ */
+struct LcdStats {
+    uint32_t pixels;        // pixels written
+    uint32_t spiBytes;      // bytes that would have crossed the SPI bus
+    uint32_t transactions;  // window writes and commands
+};
+
+class MockLcd {
+   public:
+    static const uint16_t WIDTH = 320;
+    static const uint16_t HEIGHT = 240;
+    static const uint8_t WINDOW_OVERHEAD = 11;
+
+    MockLcd();
+
+    int16_t width() const { return WIDTH; }
+    int16_t height() const { return HEIGHT; }
+
+    void fillScreen(uint16_t color);
+    void clear(uint16_t color = BLACK) { fillScreen(color); }
+    void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t color);
+    void drawPixel(int32_t x, int32_t y, uint16_t color);
+
+    /**
+     * Writes a block of panel ordered (byte-swapped) RGB565 pixels, like TFT_eSPI.
+     */
+    void pushImage(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t *data);
+
+    void setCursor(int16_t x, int16_t y);
+    void setTextColor(uint16_t color);
+    void setTextColor(uint16_t fg, uint16_t bg);
+    void setTextSize(uint8_t size);
+    void setBrightness(uint8_t brightness) { brightness_ = brightness; }
+    void sleep() { asleep_ = true; }
+    void wakeup() { asleep_ = false; }
+    void writecommand(uint8_t c);
+    void writedata(uint8_t d);
+
+    /**
+     * Draws text at x, y with one of the TFT_eSPI font numbers (1, 2, 4, 6 or 7).
+     */
+    int16_t drawString(const char *text, int32_t x, int32_t y, uint8_t font);
+
+    void print(const char *text);
+    void print(int value);
+    void println(const char *text = "");
+    void println(int value);
+    void printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+    /**
+     * Framebuffer access in native RGB565 (not byte-swapped).
+     */
+    uint16_t pixel(int16_t x, int16_t y) const { return frame_[y * WIDTH + x]; }
+    const uint16_t *frame() const { return frame_; }
+
+    const LcdStats &stats() const { return stats_; }
+    void resetStats();
+
+    uint8_t brightness() const { return brightness_; }
+    bool asleep() const { return asleep_; }
+
+    /**
+     * Writes the framebuffer as a binary PPM (P6). Returns false on I/O error.
+     */
+    bool dumpPpm(const char *path) const;
+
+    /**
+     * Compares the framebuffer against a PPM written by dumpPpm(). Returns the number of
+     * differing pixels, or -1 if the file is missing or malformed.
+     */
+    int32_t diffPpm(const char *path) const;
+
+   private:
+    void window(int32_t x, int32_t y, int32_t w, int32_t h);
+    int16_t drawCell(int32_t x, int32_t y, char c, uint8_t cellW, uint8_t cellH);
+
+    uint16_t frame_[WIDTH * HEIGHT];
+    LcdStats stats_;
+    int16_t cursorX_;
+    int16_t cursorY_;
+    uint16_t textFg_;
+    uint16_t textBg_;
+    bool textBgSet_;
+    uint8_t textSize_;
+    uint8_t brightness_;
+    bool asleep_;
+};
+
+extern MockLcd mockLcd;
+#endif
+
+#endif  // LIB_MYNWEN_LCD_MOCK_H_
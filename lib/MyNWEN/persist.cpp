@@ -0,0 +1,245 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#include "persist.h"
+
+#include <string.h>
+
+#include "critical.h"
+#include "diagnostics.h"
+
+#ifdef ARDUINO
+#include <nvs.h>
+#endif
+
+/**
+ * A value as NVS has it (clean) or as it will be committed (dirty). len 0 with dirty set
+ * is a staged removal.
+ */
+struct Slot {
+    char key[PERSIST_KEY_MAX];  // empty if unused
+    uint8_t len;
+    bool dirty;
+    uint8_t data[PERSIST_VALUE_MAX];
+};
+
+RTC_DATA_ATTR static Slot slots[PERSIST_SLOTS];
+RTC_DATA_ATTR static uint64_t dirtySince = 0;
+RTC_DATA_ATTR static bool staged = false;
+
+static uint32_t dirtyMs = PERSIST_DIRTY_MS;
+static PersistStats stats = {};
+
+// Slots are shared with the console task. NVS is only touched outside the lock.
+CRITICAL_DECLARE(lock);
+
+#ifdef ARDUINO
+static const char *NVS_NAMESPACE = "node";
+
+static size_t load(const char *key, void *out, size_t max) {
+    nvs_handle handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) return 0;
+    size_t len = max;
+    if (nvs_get_blob(handle, key, out, &len) != ESP_OK) len = 0;
+    nvs_close(handle);
+    return len;
+}
+
+/**
+ * Writes the slots and commits them as one.
+ */
+static bool commit(const Slot *pending, uint8_t n) {
+    nvs_handle handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) return false;
+    for (const Slot *p = pending; p < pending + n; p++) {
+        const Slot &s = *p;
+        if (s.len) {
+            nvs_set_blob(handle, s.key, s.data, s.len);
+        } else {
+            nvs_erase_key(handle, s.key);
+        }
+    }
+    esp_err_t err = nvs_commit(handle);
+    nvs_close(handle);
+    return err == ESP_OK;
+}
+#else
+/**
+ * Fake NVS for the host: committed values only, lost when the process exits.
+ */
+struct FakeEntry {
+    char key[PERSIST_KEY_MAX];
+    uint8_t len;
+    uint8_t data[PERSIST_VALUE_MAX];
+};
+
+static const uint8_t FAKE_ENTRIES = 32;
+static FakeEntry fake[FAKE_ENTRIES];
+
+static FakeEntry *fakeFind(const char *key) {
+    for (FakeEntry &e : fake) {
+        if (strcmp(e.key, key) == 0) return &e;
+    }
+    return NULL;
+}
+
+static size_t load(const char *key, void *out, size_t max) {
+    FakeEntry *e = fakeFind(key);
+    if (!e) return 0;
+    size_t len = e->len < max ? e->len : max;
+    memcpy(out, e->data, len);
+    return len;
+}
+
+static bool commit(const Slot *pending, uint8_t n) {
+    for (const Slot *p = pending; p < pending + n; p++) {
+        const Slot &s = *p;
+        FakeEntry *e = fakeFind(s.key);
+        if (!e && s.len) e = fakeFind("");  // a free entry
+        if (!e) continue;
+        strcpy(e->key, s.len ? s.key : "");
+        e->len = s.len;
+        memcpy(e->data, s.data, s.len);
+    }
+    return true;
+}
+#endif
+
+void persistBegin(uint32_t ms) {
+    dirtyMs = ms;
+}
+
+static Slot *find(const char *key) {
+    for (Slot &s : slots) {
+        if (s.key[0] && strcmp(s.key, key) == 0) return &s;
+    }
+    return NULL;
+}
+
+/**
+ * An unused slot, or failing that a clean one.
+ */
+static Slot *clean() {
+    Slot *found = NULL;
+    for (Slot &s : slots) {
+        if (!s.key[0]) return &s;
+        if (!s.dirty && !found) found = &s;
+    }
+    return found;
+}
+
+static void fill(Slot *s, const char *key, const uint8_t *data, size_t len) {
+    strcpy(s->key, key);
+    memcpy(s->data, data, len);
+    s->len = len;
+    s->dirty = false;
+}
+
+size_t persistGet(const char *key, void *out, size_t max) {
+    size_t len = 0;
+    CRITICAL_ENTER(lock);
+    Slot *s = find(key);
+    if (s) {
+        len = s->len < max ? s->len : max;
+        memcpy(out, s->data, len);
+    }
+    CRITICAL_EXIT(lock);
+    if (s || strlen(key) >= PERSIST_KEY_MAX) return len;
+
+    // Not cached: read NVS, then cache it if a slot is free.
+    uint8_t data[PERSIST_VALUE_MAX];
+    size_t loaded = load(key, data, sizeof(data));
+    CRITICAL_ENTER(lock);
+    if (!find(key) && (s = clean())) fill(s, key, data, loaded);
+    CRITICAL_EXIT(lock);
+    len = loaded < max ? loaded : max;
+    memcpy(out, data, len);
+    return len;
+}
+
+bool persistPut(const char *key, const void *data, size_t len, uint64_t now) {
+    if (len > PERSIST_VALUE_MAX || strlen(key) >= PERSIST_KEY_MAX) return false;
+
+    // Twice at most: if every slot holds a staged value, commit them to free one.
+    for (uint8_t attempt = 0; attempt < 2; attempt++) {
+        uint8_t committed[PERSIST_VALUE_MAX];
+        uint8_t loaded = 0;
+        CRITICAL_ENTER(lock);
+        bool cached = find(key) != NULL;
+        CRITICAL_EXIT(lock);
+        if (!cached) loaded = load(key, committed, sizeof(committed));
+
+        CRITICAL_ENTER(lock);
+        Slot *s = find(key);
+        if (!s && (s = clean())) fill(s, key, committed, loaded);
+        if (s) {
+            stats.puts++;
+            if (s->len != len || memcmp(s->data, data, len) != 0) {
+                memcpy(s->data, data, len);
+                s->len = len;
+                s->dirty = true;
+                if (!staged) dirtySince = now;
+                staged = true;
+            }
+        }
+        CRITICAL_EXIT(lock);
+        if (s) return true;
+        persistFlush();
+    }
+    return false;
+}
+
+void persistPoll(uint64_t now) {
+    if (staged && now - dirtySince >= dirtyMs) persistFlush();
+}
+
+void persistFlush() {
+    Slot pending[PERSIST_SLOTS];
+    uint8_t n = 0;
+    CRITICAL_ENTER(lock);
+    for (const Slot &s : slots) {
+        if (s.dirty) pending[n++] = s;
+    }
+    CRITICAL_EXIT(lock);
+    if (!n || !commit(pending, n)) return;  // a failed commit stays staged for the next poll
+
+    // Values staged again while committing stay dirty.
+    CRITICAL_ENTER(lock);
+    staged = false;
+    for (const Slot *p = pending; p < pending + n; p++) {
+        Slot *s = find(p->key);
+        if (s && s->dirty && s->len == p->len && memcmp(s->data, p->data, p->len) == 0) {
+            s->dirty = false;
+            if (!s->len) s->key[0] = '\0';
+        }
+        stats.writes++;
+        stats.bytes += p->len;
+    }
+    for (const Slot &s : slots) staged = staged || s.dirty;
+    stats.commits++;
+    CRITICAL_EXIT(lock);
+    diagSet("nvs.commits", stats.commits);
+}
+
+uint32_t persistMsUntilCommit(uint64_t now) {
+    if (!staged) return UINT32_MAX;
+    uint64_t due = dirtySince + dirtyMs;
+    return due <= now ? 0 : (due - now > UINT32_MAX ? UINT32_MAX : due - now);
+}
+
+const PersistStats &persistStats() {
+    return stats;
+}
+
+void persistReset() {
+    memset(slots, 0, sizeof(slots));
+    staged = false;
+    stats = {};
+}
@@ -0,0 +1,79 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_PERSIST_H_
+#define LIB_MYNWEN_PERSIST_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Settings and counters kept in NVS, with writes coalesced.
+ *
+ * Values are small blobs under NVS keys. A put only stages the value in RTC memory, which
+ * survives deep sleep; staged values are written together in one NVS commit once the
+ * oldest has waited PERSIST_DIRTY_MS, or at once by persistFlush() (before an intentional
+ * reset or power off, or on low battery). A counter bumped every wake then costs one
+ * commit per period instead of one per wake, and a put of an unchanged value none. What
+ * is staged when power is lost without warning is lost with it.
+ *
+ * On the host NVS is a fake in memory, so commit counts can be measured (persist-sim).
+ */
+const uint8_t PERSIST_SLOTS = 8;       // values staged or cached at once
+const uint8_t PERSIST_KEY_MAX = 16;    // NVS key, with the terminator
+const uint8_t PERSIST_VALUE_MAX = 32;
+const uint32_t PERSIST_DIRTY_MS = 600000;
+
+struct PersistStats {
+    uint32_t puts;     // persistPut() calls
+    uint32_t commits;  // NVS commits
+    uint32_t writes;   // keys written or erased
+    uint32_t bytes;    // value bytes written
+};
+
+/**
+ * Sets how long a staged value may wait for its commit, 0 to commit on every poll.
+ */
+void persistBegin(uint32_t dirtyMs = PERSIST_DIRTY_MS);
+
+/**
+ * Copies a value into out. Returns its length, 0 if the key has none.
+ */
+size_t persistGet(const char *key, void *out, size_t max);
+
+/**
+ * Stages a value, or with len 0 its removal. Returns false if it is too long.
+ */
+bool persistPut(const char *key, const void *data, size_t len, uint64_t now);
+
+/**
+ * Commits if the oldest staged value has waited long enough.
+ */
+void persistPoll(uint64_t now);
+
+/**
+ * Commits every staged value now.
+ */
+void persistFlush();
+
+/**
+ * Milliseconds until persistPoll() would commit, UINT32_MAX with nothing staged.
+ */
+uint32_t persistMsUntilCommit(uint64_t now);
+
+const PersistStats &persistStats();
+
+/**
+ * Drops staged values, the cache and the statistics, as a power loss would, keeping what
+ * was committed.
+ */
+void persistReset();
+
+#endif  // LIB_MYNWEN_PERSIST_H_
@@ -0,0 +1,220 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#include "protocol.h"
+
+#include <string.h>
+
+#include "cobs.h"
+#include "delivery.h"
+#include "diagnostics.h"
+#include "gatt.h"
+#include "history.h"
+
+static const size_t LINE_MAX = 64;
+static constexpr size_t FRAME_MAX = cobsMaxEncoded(PROTOCOL_PAYLOAD_MAX + 2) + 1;
+
+static ProtocolWrite writeOut = NULL;
+static ProtocolLine lineOut = NULL;
+
+static uint8_t input[FRAME_MAX];
+static size_t inputLen = 0;
+static bool inFrame = false;
+static bool overflow = false;
+static volatile bool binary = false;  // read from other tasks
+
+size_t historyEncodeChunk(uint16_t first, uint8_t maxRecords, uint8_t *out, uint8_t channel) {
+    uint8_t n = 0;
+    uint8_t *p = out + HISTORY_CHUNK_HEADER;
+    HistoryRecord r;
+    while (n < maxRecords && historyGet(first + n, &r, channel)) {
+        gattPut32(p, r.time);
+        gattPut16(p + 4, r.value);
+        p += HISTORY_CHUNK_RECORD;
+        n++;
+    }
+    gattPut16(out, first);
+    out[2] = n;
+    gattPut32(out + 3, historySeq(first, channel));
+    return p - out;
+}
+
+/**
+ * Frames and sends one response. data may be NULL when len is 0.
+ */
+static void respond(uint8_t cmd, ProtocolStatus status, const uint8_t *data, size_t len) {
+    uint8_t payload[PROTOCOL_PAYLOAD_MAX];
+    uint8_t frame[FRAME_MAX];
+    payload[0] = cmd | PROTOCOL_RESPONSE;
+    payload[1] = status;
+    if (len) memcpy(&payload[2], data, len);
+    writeOut(frame, frameEncode(payload, len + 2, frame));
+}
+
+static void commandDump(const uint8_t *args, size_t len) {
+    if (len != 4 && len != 5) return respond(CMD_DUMP, STATUS_BAD_ARGS, NULL, 0);
+    uint16_t first = gattGet16(args), count = gattGet16(args + 2);
+    uint8_t channel = len == 5 ? args[4] : 0;
+    if (!historyCapacity(channel)) return respond(CMD_DUMP, STATUS_BAD_ARGS, NULL, 0);
+
+    uint8_t chunk[HISTORY_CHUNK_HEADER + HISTORY_CHUNK_MAX * HISTORY_CHUNK_RECORD];
+    uint16_t sent = 0;
+    while (sent < count) {
+        uint16_t left = count - sent;
+        uint8_t max = left < HISTORY_CHUNK_MAX ? left : HISTORY_CHUNK_MAX;
+        size_t n = historyEncodeChunk(first + sent, max, chunk, channel);
+        if (!chunk[2]) break;
+        respond(CMD_DUMP, STATUS_MORE, chunk, n);
+        sent += chunk[2];
+    }
+
+    uint8_t done[2];
+    gattPut16(done, sent);
+    respond(CMD_DUMP, STATUS_OK, done, sizeof(done));
+}
+
+static void commandStats(const uint8_t *args, size_t len) {
+    uint8_t channel = len ? args[0] : 0;
+    if (len > 1 || !historyCapacity(channel)) return respond(CMD_STATS, STATUS_BAD_ARGS, NULL, 0);
+
+    uint8_t data[22] = {};
+    uint16_t count = historyCount(channel);
+    gattPut16(&data[0], count);
+    gattPut16(&data[2], historyCapacity(channel));
+
+    HistoryRecord r;
+    int16_t lo = INT16_MAX, hi = INT16_MIN;
+    int32_t sum = 0;
+    uint16_t n = 0;
+    for (; n < count && historyGet(n, &r, channel); n++) {
+        if (n == 0) gattPut32(&data[4], r.time);
+        gattPut32(&data[8], r.time);
+        if (r.value < lo) lo = r.value;
+        if (r.value > hi) hi = r.value;
+        sum += r.value;
+    }
+    if (n) {
+        gattPut16(&data[12], lo);
+        gattPut16(&data[14], hi);
+        gattPut16(&data[16], sum / n);
+    }
+    gattPut32(&data[18], historyNextSeq(channel));
+    respond(CMD_STATS, STATUS_OK, data, sizeof(data));
+}
+
+static void commandDiag() {
+    uint8_t data[PROTOCOL_PAYLOAD_MAX - 2];
+    size_t len = 0;
+    const char *key;
+    int32_t value;
+
+    for (uint8_t i = 0; diagEntry(i, &key, &value); i++) {
+        size_t keyLen = strlen(key);
+        if (len + 1 + keyLen + 4 > sizeof(data)) {
+            respond(CMD_DIAG, STATUS_MORE, data, len);
+            len = 0;
+        }
+        data[len++] = keyLen;
+        memcpy(&data[len], key, keyLen);
+        gattPut32(&data[len + keyLen], value);
+        len += keyLen + 4;
+    }
+    respond(CMD_DIAG, STATUS_OK, data, len);
+}
+
+static void commandClients() {
+    DeliveryClient clients[DELIVERY_CLIENTS];
+    uint8_t data[DELIVERY_CLIENTS * 14];
+    uint8_t n = deliveryClients(clients, DELIVERY_CLIENTS);
+    for (uint8_t i = 0; i < n; i++) {
+        memcpy(&data[i * 14], clients[i].addr, 6);
+        gattPut32(&data[i * 14 + 6], clients[i].produced);
+        gattPut32(&data[i * 14 + 10], clients[i].delivered);
+    }
+    respond(CMD_CLIENTS, STATUS_OK, data, n * 14);
+}
+
+static void handleFrame(uint8_t *frame, size_t len) {
+    binary = true;
+    int n = frameDecode(frame, len);
+    if (n < 1) {
+        diagAdd("proto.bad", 1);
+        return respond(0, STATUS_BAD_FRAME, NULL, 0);
+    }
+
+    diagAdd("proto.cmds", 1);
+    switch (frame[0]) {
+        case CMD_DUMP:
+            return commandDump(&frame[1], n - 1);
+        case CMD_STATS:
+            return commandStats(&frame[1], n - 1);
+        case CMD_RESET:
+            historyReset();
+            return respond(CMD_RESET, STATUS_OK, NULL, 0);
+        case CMD_DIAG:
+            return commandDiag();
+        case CMD_CLIENTS:
+            return commandClients();
+        default:
+            return respond(frame[0], STATUS_UNKNOWN, NULL, 0);
+    }
+}
+
+void protocolBegin(ProtocolWrite write, ProtocolLine line) {
+    writeOut = write;
+    lineOut = line;
+    inputLen = 0;
+    inFrame = false;
+    overflow = false;
+    binary = false;
+}
+
+bool protocolBinary() {
+    return binary;
+}
+
+/**
+ * Text lines and frames share one buffer. A zero starts a frame (or ends one), a newline
+ * ends a text line; oversized input is discarded up to the next terminator.
+ */
+void protocolFeed(const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = data[i];
+
+        if (c == 0) {
+            if (inFrame && inputLen && !overflow) {
+                handleFrame(input, inputLen);
+                inFrame = false;
+            } else {
+                inFrame = true;
+            }
+            inputLen = 0;
+            overflow = false;
+            continue;
+        }
+
+        if (!inFrame && (c == '\n' || c == '\r')) {
+            if (inputLen && !overflow && lineOut) {
+                binary = false;
+                input[inputLen] = '\0';
+                lineOut((const char *)input);
+            }
+            inputLen = 0;
+            overflow = false;
+            continue;
+        }
+
+        if (inputLen < (inFrame ? FRAME_MAX : LINE_MAX - 1)) {
+            input[inputLen++] = c;
+        } else {
+            overflow = true;
+        }
+    }
+}
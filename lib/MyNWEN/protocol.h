@@ -0,0 +1,90 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_PROTOCOL_H_
+#define LIB_MYNWEN_PROTOCOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Binary command protocol for pulling history over Serial, independent of the transport.
+ *
+ * Requests and responses are frames as built by frameEncode() (COBS + CRC-16, 0x00
+ * delimited). The serial console shares the line with text commands, so a host starts a
+ * request with a 0x00: bytes after a zero are a frame, anything else is a text line.
+ *
+ *   request:  [cmd] [args...]
+ *   response: [cmd | 0x80] [status] [data...]
+ *
+ * Multi-frame responses send STATUS_MORE frames followed by one STATUS_OK frame.
+ * All integers are little endian.
+ */
+enum ProtocolCommand : uint8_t {
+    CMD_DUMP = 0x01,   // args: u16 first, u16 count [, u8 channel].
+                       // data: history chunks, then u16 sent
+    CMD_STATS = 0x02,  // args: [u8 channel]. data: u16 count, u16 capacity, u32 oldest,
+                       //       u32 newest, i16 min, i16 max, i16 mean, u32 next seq
+    CMD_RESET = 0x03,  // clears the history (all channels)
+    CMD_DIAG = 0x04,   // data: repeated [u8 key length] [key] [i32 value]
+    CMD_CLIENTS = 0x05,  // data: repeated [6 byte address] [u32 produced] [u32 delivered]
+};
+
+enum ProtocolStatus : uint8_t {
+    STATUS_OK = 0,
+    STATUS_MORE = 1,
+    STATUS_BAD_FRAME = 2,
+    STATUS_UNKNOWN = 3,
+    STATUS_BAD_ARGS = 4,
+};
+
+const uint8_t PROTOCOL_RESPONSE = 0x80;
+const size_t PROTOCOL_PAYLOAD_MAX = 240;
+
+/**
+ * History chunks are [u16 first index] [u8 n] [u32 sequence number of the first] followed
+ * by n records of [u32 time] [i16 value]; records are consecutive, so their sequence
+ * numbers are too. The same encoding is served by the BLE history characteristic.
+ */
+const uint8_t HISTORY_CHUNK_HEADER = 7;
+const uint8_t HISTORY_CHUNK_RECORD = 6;
+const uint8_t HISTORY_CHUNK_MAX = (PROTOCOL_PAYLOAD_MAX - 2 - HISTORY_CHUNK_HEADER) / HISTORY_CHUNK_RECORD;
+
+/**
+ * Writes up to maxRecords records of a history channel starting at index first into out,
+ * which must hold HISTORY_CHUNK_HEADER + maxRecords * HISTORY_CHUNK_RECORD bytes. Returns
+ * the chunk length; a chunk with no records means first is past the end.
+ */
+size_t historyEncodeChunk(uint16_t first, uint8_t maxRecords, uint8_t *out, uint8_t channel = 0);
+
+/**
+ * Sends bytes to the host. Frames are passed whole, delimiter included.
+ */
+typedef void (*ProtocolWrite)(const uint8_t *data, size_t len);
+
+/**
+ * Receives a complete text line, without the line ending.
+ */
+typedef void (*ProtocolLine)(const char *line);
+
+void protocolBegin(ProtocolWrite write, ProtocolLine line);
+
+/**
+ * Feeds received bytes. Completed frames are handled and answered before returning.
+ */
+void protocolFeed(const uint8_t *data, size_t len);
+
+/**
+ * Whether the host last sent a frame rather than a text line. Unsolicited text must not
+ * be sent then, as the host's reader would take it for part of a frame.
+ */
+bool protocolBinary();
+
+#endif  // LIB_MYNWEN_PROTOCOL_H_
@@ -0,0 +1,141 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#include "recovery.h"
+
+#include "critical.h"
+#include "diagnostics.h"
+
+#ifdef ARDUINO
+#include <esp_system.h>
+#endif
+
+static const uint32_t MAGIC = 0x52435652;  // "RCVR"
+
+/**
+ * Kept through resets. Power on leaves it random, so it is only trusted with the magic
+ * and check intact.
+ */
+struct State {
+    uint32_t magic;
+    RecoveryInfo info;
+    RecoveryPhase phase;
+    bool retry;  // the next wake is a full attempt
+    uint32_t check;
+};
+
+RTC_NOINIT_ATTR static State state;
+static RecoveryMode mode = RECOVERY_NORMAL;
+
+static uint32_t checksum() {
+    return state.magic ^ state.info.crashes ^ state.info.failures << 8 ^
+           state.info.lastReset << 16 ^ state.info.lastPhase << 24 ^ state.phase ^
+           state.retry << 4;
+}
+
+static void save() {
+    state.check = checksum();
+}
+
+static bool failure(RecoveryReset reason) {
+    switch (reason) {
+        case RECOVERY_RESET_PANIC:
+        case RECOVERY_RESET_WATCHDOG:
+        case RECOVERY_RESET_BROWNOUT:
+        case RECOVERY_RESET_UNKNOWN:
+            return true;
+        case RECOVERY_RESET_SOFTWARE:
+            return state.phase != RECOVERY_PHASE_RESET;
+        default:
+            return false;
+    }
+}
+
+RecoveryMode recoveryBegin(RecoveryReset reason) {
+    // A brown-out can take the RTC domain with it; the reason alone is still a failure.
+    if (state.magic != MAGIC || state.check != checksum()) {
+        state = {};
+        state.magic = MAGIC;
+    }
+
+    if (reason == RECOVERY_RESET_POWER_ON || reason == RECOVERY_RESET_EXTERNAL) {
+        state.info.failures = 0;
+        state.retry = false;
+    } else if (state.phase != RECOVERY_PHASE_SLEEP && failure(reason)) {
+        if (state.info.failures < UINT8_MAX) state.info.failures++;
+        state.info.crashes++;
+        state.info.lastReset = reason;
+        state.info.lastPhase = state.phase;
+        state.retry = false;
+    }
+
+    mode = state.info.failures >= RECOVERY_DEGRADE_AFTER && !state.retry ? RECOVERY_DEGRADED
+                                                                          : RECOVERY_NORMAL;
+    state.retry = false;
+    state.phase = RECOVERY_PHASE_BOOT;
+    save();
+
+    diagSet("rec.crashes", state.info.crashes);
+    diagSet("rec.failures", state.info.failures);
+    diagSet("rec.phase", state.info.lastPhase);
+    diagSet("rec.reset", state.info.lastReset);
+    return mode;
+}
+
+void recoveryPhase(RecoveryPhase phase) {
+    state.phase = phase;
+    save();
+}
+
+void recoverySleep() {
+    if (mode == RECOVERY_NORMAL) {
+        state.info.failures = 0;
+    } else {
+        state.retry = true;
+    }
+    state.phase = RECOVERY_PHASE_SLEEP;
+    save();
+}
+
+uint32_t recoveryBackoffMs() {
+    if (mode != RECOVERY_DEGRADED) return 0;
+    uint8_t doublings = state.info.failures - RECOVERY_DEGRADE_AFTER;
+    uint64_t ms = (uint64_t)RECOVERY_BACKOFF_MS << (doublings < 16 ? doublings : 16);
+    return ms < RECOVERY_BACKOFF_MAX_MS ? ms : RECOVERY_BACKOFF_MAX_MS;
+}
+
+const RecoveryInfo &recoveryInfo() {
+    return state.info;
+}
+
+#ifdef ARDUINO
+RecoveryReset recoveryResetReason() {
+    switch (esp_reset_reason()) {
+        case ESP_RST_POWERON:
+            return RECOVERY_RESET_POWER_ON;
+        case ESP_RST_EXT:
+            return RECOVERY_RESET_EXTERNAL;
+        case ESP_RST_DEEPSLEEP:
+            return RECOVERY_RESET_DEEP_SLEEP;
+        case ESP_RST_SW:
+            return RECOVERY_RESET_SOFTWARE;
+        case ESP_RST_PANIC:
+            return RECOVERY_RESET_PANIC;
+        case ESP_RST_INT_WDT:
+        case ESP_RST_TASK_WDT:
+        case ESP_RST_WDT:
+            return RECOVERY_RESET_WATCHDOG;
+        case ESP_RST_BROWNOUT:
+            return RECOVERY_RESET_BROWNOUT;
+        default:
+            return RECOVERY_RESET_UNKNOWN;
+    }
+}
+#endif
@@ -0,0 +1,94 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_RECOVERY_H_
+#define LIB_MYNWEN_RECOVERY_H_
+
+#include <stdint.h>
+
+/**
+ * Crash and brown-out recovery for the wake path.
+ *
+ * The node marks its progress through each awake window in RTC memory that a reset does
+ * not clear (RTC_DATA_ATTR is reloaded on any boot but a deep sleep wake). A panic,
+ * watchdog or brown-out before the window ends in sleep counts as a failure, with the
+ * phase it happened in. After RECOVERY_DEGRADE_AFTER failures in a row the node stops
+ * retrying at once: it boots degraded (sensors only, no display, radio or console) and
+ * sleeps RECOVERY_BACKOFF_MS, doubling with every further failure up to
+ * RECOVERY_BACKOFF_MAX_MS, before one more full attempt. A full window that reaches sleep
+ * clears the failures; so does a power cycle or the reset button.
+ */
+const uint8_t RECOVERY_DEGRADE_AFTER = 2;
+const uint32_t RECOVERY_BACKOFF_MS = 30000;
+const uint32_t RECOVERY_BACKOFF_MAX_MS = 3600000;
+
+enum RecoveryPhase : uint8_t {
+    RECOVERY_PHASE_SLEEP = 0,  // the window ended cleanly
+    RECOVERY_PHASE_BOOT,
+    RECOVERY_PHASE_INIT,       // peripherals
+    RECOVERY_PHASE_RADIO,      // BLE, the peak current
+    RECOVERY_PHASE_RUN,
+    RECOVERY_PHASE_RESET,      // an intentional reset is coming
+};
+
+enum RecoveryReset : uint8_t {
+    RECOVERY_RESET_POWER_ON = 0,
+    RECOVERY_RESET_EXTERNAL,
+    RECOVERY_RESET_DEEP_SLEEP,
+    RECOVERY_RESET_SOFTWARE,
+    RECOVERY_RESET_PANIC,
+    RECOVERY_RESET_WATCHDOG,
+    RECOVERY_RESET_BROWNOUT,
+    RECOVERY_RESET_UNKNOWN,
+};
+
+enum RecoveryMode : uint8_t {
+    RECOVERY_NORMAL,
+    RECOVERY_DEGRADED,
+};
+
+struct RecoveryInfo {
+    uint32_t crashes;         // failures since power on
+    uint8_t failures;         // in a row
+    RecoveryReset lastReset;  // of the latest failure
+    RecoveryPhase lastPhase;
+};
+
+/**
+ * Accounts for the reset that started this boot and picks how to run it.
+ */
+RecoveryMode recoveryBegin(RecoveryReset reason);
+
+/**
+ * Marks progress through the awake window.
+ */
+void recoveryPhase(RecoveryPhase phase);
+
+/**
+ * Ends the window before deep sleep. A degraded window leaves the failures as they are
+ * and makes the next wake a full attempt.
+ */
+void recoverySleep();
+
+/**
+ * How long a degraded boot should sleep, 0 if not degraded.
+ */
+uint32_t recoveryBackoffMs();
+
+const RecoveryInfo &recoveryInfo();
+
+#ifdef ARDUINO
+/**
+ * The reset reason of this boot.
+ */
+RecoveryReset recoveryResetReason();
+#endif
+
+#endif  // LIB_MYNWEN_RECOVERY_H_
@@ -0,0 +1,151 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#include "sensors.h"
+
+#include "critical.h"
+#include "diagnostics.h"
+#include "hotpath.h"
+#include "timesync.h"
+
+static const SensorSpec *specs = NULL;
+static SensorListener listener = NULL;
+
+RTC_DATA_ATTR static uint64_t deadlines[SENSOR_COUNT];  // 0 until first sampled
+RTC_DATA_ATTR static int16_t latest[SENSOR_COUNT];
+RTC_DATA_ATTR static uint32_t latestSeq[SENSOR_COUNT];
+// Sampling happens on the loop, but clients read the latest values from the BLE task.
+CRITICAL_DECLARE(sensorsMux);
+
+void sensorsBegin(const SensorSpec *table, SensorListener onSample) {
+    specs = table;
+    listener = onSample;
+}
+
+void sensorsReset() {
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) deadlines[i] = 0;
+}
+
+uint64_t sensorsNowMs() {
+    return timeSyncMonotonicMs();
+}
+
+static void HOT_IRAM_ATTR record(SensorId id, int16_t value, uint64_t now) {
+    uint32_t seq = historyAppend(timeSyncWallMsAt(now * 1000) / 1000, value, id);
+
+    // Stay on the original grid unless a whole period was missed (eg. a long sleep).
+    CRITICAL_ENTER(sensorsMux);
+    latest[id] = value;
+    latestSeq[id] = seq;
+    uint64_t next = deadlines[id] + specs[id].periodMs;
+    deadlines[id] = next > now ? next : now + specs[id].periodMs;
+    CRITICAL_EXIT(sensorsMux);
+
+    if (listener) listener(id, seq, value);
+}
+
+static void HOT_IRAM_ATTR sample(SensorId id, uint64_t now) {
+    record(id, specs[id].read(), now);
+}
+
+/**
+ * Earliest deadline among sensors whose window is open at now, or SENSOR_COUNT.
+ */
+static uint8_t HOT_IRAM_ATTR earliestDue(uint64_t now) {
+    uint8_t best = SENSOR_COUNT;
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        if (!specs[i].periodMs || deadlines[i] > now + specs[i].slackMs) continue;
+        if (best == SENSOR_COUNT || deadlines[i] < deadlines[best]) best = i;
+    }
+    return best;
+}
+
+uint8_t HOT_IRAM_ATTR sensorsRunDue(uint64_t now) {
+    if (!specs) return 0;
+
+    uint8_t taken = 0;
+    for (uint8_t id; (id = earliestDue(now)) < SENSOR_COUNT; taken++) {
+        sample((SensorId)id, now);
+    }
+    if (taken) {
+        diagAdd("sensors.wakes", 1);
+        diagAdd("sensors.samples", taken);
+    }
+    return taken;
+}
+
+void sensorSampleNow(SensorId id, uint64_t now) {
+    if (specs) sample(id, now);
+}
+
+void sensorRecord(SensorId id, int16_t value, uint64_t now) {
+    if (specs) record(id, value, now);
+}
+
+uint32_t sensorsMsUntilDue(uint64_t now) {
+    if (!specs) return UINT32_MAX;
+
+    uint64_t earliest = UINT64_MAX;
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        if (specs[i].periodMs && deadlines[i] < earliest) earliest = deadlines[i];
+    }
+    if (earliest <= now) return 0;
+    return earliest - now > UINT32_MAX ? UINT32_MAX : earliest - now;
+}
+
+int16_t HOT_IRAM_ATTR sensorLatest(SensorId id) {
+    CRITICAL_ENTER(sensorsMux);
+    bool sampled = deadlines[id] != 0;
+    int16_t value = latest[id];
+    CRITICAL_EXIT(sensorsMux);
+    if (sampled) return value;
+
+    // Reads a sensor and calls the listener, so never under the lock.
+    sample(id, sensorsNowMs());
+    CRITICAL_ENTER(sensorsMux);
+    value = latest[id];
+    CRITICAL_EXIT(sensorsMux);
+    return value;
+}
+
+uint32_t HOT_IRAM_ATTR sensorSeq(SensorId id) {
+    sensorLatest(id);
+    CRITICAL_ENTER(sensorsMux);
+    uint32_t seq = latestSeq[id];
+    CRITICAL_EXIT(sensorsMux);
+    return seq;
+}
+
+size_t HOT_IRAM_ATTR sensorEncode(SensorId id, uint8_t *out, size_t max) {
+    const SensorSpec &spec = specs[id];
+    if (max < spec.size) return 0;
+
+    int32_t value = (int32_t)sensorLatest(id) * spec.scale;
+    for (uint8_t i = 0; i < spec.size; i++) out[i] = (uint32_t)value >> (8 * i);
+    return spec.size;
+}
+
+size_t HOT_IRAM_ATTR sensorsEncodeLatest(uint8_t *out, size_t max) {
+    if (max < SENSOR_COUNT * SENSOR_LATEST_RECORD) return 0;
+
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        // The value and its sequence number are read as a pair.
+        sensorLatest((SensorId)i);
+        CRITICAL_ENTER(sensorsMux);
+        int16_t value = latest[i];
+        uint32_t seq = latestSeq[i];
+        CRITICAL_EXIT(sensorsMux);
+        uint8_t *p = &out[i * SENSOR_LATEST_RECORD];
+        for (uint8_t b = 0; b < 4; b++) p[b] = seq >> (8 * b);
+        p[4] = value;
+        p[5] = value >> 8;
+    }
+    return SENSOR_COUNT * SENSOR_LATEST_RECORD;
+}
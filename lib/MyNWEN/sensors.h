@@ -0,0 +1,143 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_SENSORS_H_
+#define LIB_MYNWEN_SENSORS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gatt.h"
+#include "history.h"
+
+/**
+ * Sensor registry and sampling scheduler.
+ *
+ * Each sensor has a period and a slack (how early it may be sampled). Deadlines are kept
+ * in RTC memory and served earliest deadline first: the node wakes for the earliest one
+ * and samples every sensor whose window is already open in the same wake, so N sensors
+ * share wakes instead of each causing its own.
+ *
+ * A sensor's id is also its history channel, and each sample takes the channel's next
+ * sequence number. sensorCharacteristic() turns an entry into a GATT characteristic
+ * serving the latest value.
+ */
+enum SensorId : uint8_t {
+    SENSOR_TEMPERATURE = 0,
+    SENSOR_HUMIDITY,
+    SENSOR_PRESSURE,
+    SENSOR_BATTERY,
+    SENSOR_COUNT,
+};
+
+static_assert(SENSOR_COUNT <= HISTORY_CHANNELS, "one history channel per sensor");
+
+const uint8_t SENSOR_LATEST_RECORD = 6;  // see sensorsEncodeLatest()
+
+/**
+ * Reads the sensor without side effects, in the sensor's history unit.
+ */
+typedef int16_t (*SensorRead)();
+
+struct SensorSpec {
+    const char *name;
+    uint16_t uuid16;          // characteristic assigned number
+    uint8_t size;             // characteristic value bytes (little endian)
+    int16_t scale;            // characteristic value = history value * scale
+    const char *description;  // 0x2901 user description
+    uint32_t periodMs;        // 0 if sampled elsewhere, see sensorRecord()
+    uint32_t slackMs;         // may be sampled this early to share a wake
+    SensorRead read;
+};
+
+/**
+ * Called after each sample is recorded.
+ */
+typedef void (*SensorListener)(SensorId id, uint32_t seq, int16_t value);
+
+/**
+ * Registers the sensor table, indexed by SensorId with SENSOR_COUNT entries.
+ */
+void sensorsBegin(const SensorSpec *specs, SensorListener listener);
+
+/**
+ * Forgets every deadline, so all sensors are due on the next run.
+ */
+void sensorsReset();
+
+/**
+ * Monotonic milliseconds (see timesync.h), which a time sync does not move. Samples are
+ * recorded in history at the matching wall clock time.
+ */
+uint64_t sensorsNowMs();
+
+/**
+ * Samples every sensor whose window is open at now, earliest deadline first. Returns the
+ * number of samples taken.
+ */
+uint8_t sensorsRunDue(uint64_t now);
+
+/**
+ * Samples one sensor at now outside the schedule, eg. to replay a trace at its recorded
+ * times. Its next deadline follows from this sample.
+ */
+void sensorSampleNow(SensorId id, uint64_t now);
+
+/**
+ * Records a value sampled elsewhere at now, eg. by the ULP (see ulpsampler.h), as if the
+ * sensor had been read then. Sensors with no period are only sampled this way.
+ */
+void sensorRecord(SensorId id, int16_t value, uint64_t now);
+
+/**
+ * Milliseconds until the earliest deadline, 0 if one has passed.
+ */
+uint32_t sensorsMsUntilDue(uint64_t now);
+
+/**
+ * Latest recorded value, sampling now if the sensor has never been sampled. Safe from any
+ * task once every sensor has been sampled; take first samples on the sampling task.
+ */
+int16_t sensorLatest(SensorId id);
+
+/**
+ * Sequence number of the latest value.
+ */
+uint32_t sensorSeq(SensorId id);
+
+/**
+ * Encodes the latest value as the sensor's characteristic value.
+ */
+size_t sensorEncode(SensorId id, uint8_t *out, size_t max);
+
+/**
+ * Latest value of every sensor in SensorId order, each as [u32 seq] [i16 value] in the
+ * history unit.
+ */
+size_t sensorsEncodeLatest(uint8_t *out, size_t max);
+
+template <SensorId Id>
+size_t sensorReadCharacteristic(uint8_t *out, size_t max) {
+    return sensorEncode(Id, out, max);
+}
+
+/**
+ * GATT characteristic for a sensor table entry, for use in a constexpr schema. read may
+ * wrap sensorReadCharacteristic<Id> to add side effects.
+ */
+template <SensorId Id, size_t N>
+constexpr GattCharacteristic sensorCharacteristic(const SensorSpec (&specs)[N],
+                                                  uint32_t properties = GATT_READ,
+                                                  GattRead read = sensorReadCharacteristic<Id>) {
+    static_assert(Id < N, "sensor missing from the table");
+    return {specs[Id].uuid16, NULL, properties, specs[Id].size, specs[Id].description, read, NULL};
+}
+
+#endif  // LIB_MYNWEN_SENSORS_H_
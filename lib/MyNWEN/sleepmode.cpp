@@ -0,0 +1,185 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#include "sleepmode.h"
+
+#include "critical.h"
+#include "diagnostics.h"
+#include "energy.h"
+
+#ifdef ARDUINO
+#include <driver/uart.h>
+#include <esp_bt.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#endif
+
+RTC_DATA_ATTR static SleepModeCost costs[SLEEP_MODES];
+RTC_DATA_ATTR static bool started = false;
+RTC_DATA_ATTR static SleepMode last = SLEEP_MODE_AWAKE;
+RTC_DATA_ATTR static uint64_t wakeAt = 0;  // planned, on the monotonic clock
+RTC_DATA_ATTR static uint64_t expectedCharge = 0;  // at wakeAt, had it all been floor
+RTC_DATA_ATTR static bool pending = false;
+static bool dozing = false;
+
+static void estimate(SleepMode mode, uint32_t wakeMs, uint16_t currentMa10) {
+    costs[mode].wakeMs = wakeMs;
+    costs[mode].wakeChargeMa10Ms = wakeMs * currentMa10;
+    costs[mode].measured = 0;
+}
+
+void sleepModeReset() {
+    uint16_t run = energyCurrentMa10(ENERGY_CPU_RUN);
+    uint16_t ready = run + energyCurrentMa10(ENERGY_RADIO_INIT);
+    uint16_t resume = run + energyCurrentMa10(ENERGY_RADIO_ADVERTISING);
+    estimate(SLEEP_MODE_AWAKE, 0, 0);
+    estimate(SLEEP_MODE_LIGHT, SLEEP_LIGHT_WAKE_MS, resume);
+    estimate(SLEEP_MODE_STUB, SLEEP_STUB_WAKE_MS, energyCurrentMa10(ENERGY_CPU_BOOT));
+    estimate(SLEEP_MODE_DEEP, SLEEP_DEEP_WAKE_MS, ready);
+    last = SLEEP_MODE_AWAKE;
+    pending = false;
+    started = true;
+}
+
+static void publish() {
+    diagSet("sleep.light.be.ms", sleepModeBreakEvenMs(SLEEP_MODE_LIGHT, SLEEP_MODE_AWAKE));
+    diagSet("sleep.stub.be.ms", sleepModeBreakEvenMs(SLEEP_MODE_STUB, SLEEP_MODE_LIGHT));
+    diagSet("sleep.deep.be.ms", sleepModeBreakEvenMs(SLEEP_MODE_DEEP, SLEEP_MODE_LIGHT));
+    diagSet("sleep.light.wake.ms", costs[SLEEP_MODE_LIGHT].wakeMs);
+}
+
+static uint16_t floorOf(EnergyState cpu, EnergyState radio) {
+    return energyCurrentMa10(cpu) + energyCurrentMa10(radio) + energyCurrentMa10(ENERGY_LCD_SLEEP);
+}
+
+static uint16_t awakeFloor() {
+    return floorOf(dozing ? ENERGY_CPU_DOZE : ENERGY_CPU_IDLE, ENERGY_RADIO_ADVERTISING);
+}
+
+void sleepModeBegin() {
+    if (!started) sleepModeReset();
+
+    // The floors follow the current table, which is set on every boot. The LCD is asleep
+    // in all of them, as it is before any of these sleeps.
+    costs[SLEEP_MODE_AWAKE].floorMa10 = awakeFloor();
+    costs[SLEEP_MODE_LIGHT].floorMa10 = floorOf(ENERGY_CPU_LIGHT_SLEEP, ENERGY_RADIO_OFF);
+    costs[SLEEP_MODE_STUB].floorMa10 = floorOf(ENERGY_CPU_SLEEP, ENERGY_RADIO_OFF);
+    costs[SLEEP_MODE_DEEP].floorMa10 = floorOf(ENERGY_CPU_SLEEP, ENERGY_RADIO_OFF);
+    publish();
+}
+
+void sleepModeSetDoze(bool doze) {
+    dozing = doze;
+    costs[SLEEP_MODE_AWAKE].floorMa10 = awakeFloor();
+    publish();
+}
+
+uint64_t sleepModeChargeMa10Ms(SleepMode mode, uint32_t gapMs) {
+    const SleepModeCost &c = costs[mode];
+    if (gapMs < c.wakeMs) return UINT64_MAX;
+    return c.wakeChargeMa10Ms + (uint64_t)c.floorMa10 * (gapMs - c.wakeMs);
+}
+
+SleepMode sleepModeSelect(uint32_t gapMs, uint8_t allowed) {
+    SleepMode best = SLEEP_MODE_AWAKE;
+    uint64_t bestCharge = sleepModeChargeMa10Ms(SLEEP_MODE_AWAKE, gapMs);
+    for (uint8_t m = SLEEP_MODE_LIGHT; m < SLEEP_MODES; m++) {
+        if (!(allowed & sleepModeBit((SleepMode)m))) continue;
+        uint64_t charge = sleepModeChargeMa10Ms((SleepMode)m, gapMs);
+        if (charge < bestCharge) {
+            best = (SleepMode)m;
+            bestCharge = charge;
+        }
+    }
+    return best;
+}
+
+uint32_t sleepModeBreakEvenMs(SleepMode mode, SleepMode than) {
+    // Past both wake times each charge is fixed + floor * gap; the lines cross once.
+    const SleepModeCost &a = costs[mode], &b = costs[than];
+    int64_t fixedA = (int64_t)a.wakeChargeMa10Ms - (int64_t)a.floorMa10 * a.wakeMs;
+    int64_t fixedB = (int64_t)b.wakeChargeMa10Ms - (int64_t)b.floorMa10 * b.wakeMs;
+    uint32_t from = a.wakeMs > b.wakeMs ? a.wakeMs : b.wakeMs;
+    if (fixedA <= fixedB && a.floorMa10 <= b.floorMa10) return from;
+    if (a.floorMa10 >= b.floorMa10) return UINT32_MAX;
+
+    int64_t ms = (fixedA - fixedB + (b.floorMa10 - a.floorMa10) - 1) / (b.floorMa10 - a.floorMa10);
+    if (ms > UINT32_MAX) return UINT32_MAX;
+    return ms > from ? (uint32_t)ms : from;
+}
+
+void sleepModeStart(SleepMode mode, uint64_t now, uint32_t sleepMs, uint64_t chargeMa10Ms) {
+    last = mode;
+    wakeAt = now + sleepMs;
+    expectedCharge = chargeMa10Ms + (uint64_t)costs[mode].floorMa10 * sleepMs;
+    pending = true;
+    diagSet("sleep.mode", mode);
+}
+
+SleepMode sleepModeLast() {
+    return last;
+}
+
+void sleepModeWoke(uint64_t now, uint64_t chargeMa10Ms, bool timer) {
+    if (!pending) return;
+    pending = false;
+    if (!timer || now < wakeAt || chargeMa10Ms < expectedCharge) return;
+
+    SleepModeCost &c = costs[last];
+    uint32_t ms = now - wakeAt;
+    uint32_t charge = chargeMa10Ms - expectedCharge;
+    if (c.measured == 0) {
+        c.wakeMs = ms;
+        c.wakeChargeMa10Ms = charge;
+    } else {
+        c.wakeMs += ((int32_t)ms - (int32_t)c.wakeMs) / SLEEP_SMOOTHING;
+        c.wakeChargeMa10Ms += ((int64_t)charge - (int64_t)c.wakeChargeMa10Ms) / SLEEP_SMOOTHING;
+    }
+    if (c.measured < UINT16_MAX) c.measured++;
+    publish();
+}
+
+const SleepModeCost &sleepModeCost(SleepMode mode) {
+    return costs[mode];
+}
+
+#ifdef ARDUINO
+bool sleepModeLightBegin() {
+#if CONFIG_BTDM_CTRL_MODEM_SLEEP
+    // Modem sleep needs a low power clock for the controller: the external 32 kHz crystal
+    // where the board has one (CONFIG_BTDM_CTRL_LPCLK_SEL_EXT_32K_XTAL), otherwise the main
+    // crystal, which then stays on through each light sleep. The Core has none.
+    return esp_bt_sleep_enable() == ESP_OK;
+#else
+    return false;
+#endif
+}
+
+bool sleepModeDozeBegin() {
+#if CONFIG_PM_ENABLE && CONFIG_FREERTOS_USE_TICKLESS_IDLE
+    if (!sleepModeLightBegin()) return false;
+
+    // The controller holds the APB at 80 MHz while it needs it.
+    esp_pm_config_esp32_t config = {};
+    config.max_freq_mhz = 240;
+    config.min_freq_mhz = 80;
+    config.light_sleep_enable = true;
+    if (esp_pm_configure(&config) != ESP_OK) return false;
+
+    // Console input wakes the chip; the first characters of a line are lost doing it.
+    uart_set_wakeup_threshold(UART_NUM_0, 3);
+    esp_sleep_enable_uart_wakeup(UART_NUM_0);
+    sleepModeSetDoze(true);
+    return true;
+#else
+    return false;
+#endif
+}
+#endif
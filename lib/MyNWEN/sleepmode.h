@@ -0,0 +1,139 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_SLEEPMODE_H_
+#define LIB_MYNWEN_SLEEPMODE_H_
+
+#include <stdint.h>
+
+/**
+ * Picks how to spend the gap until the next deadline by break-even analysis.
+ *
+ * Each mode costs a fixed charge to wake from (the time from the wake until the node is
+ * ready for the work it woke for, at the currents drawn meanwhile) plus its floor current
+ * for the rest of the gap. Staying awake costs nothing to wake from but has the highest
+ * floor, deep sleep the lowest floor but a full boot. The selector picks the mode that
+ * costs least over the gap, so short gaps stay awake or light sleep and only long ones
+ * pay for a reboot.
+ *
+ * The wake costs start as estimates and are then measured on every timer wake, from the
+ * energy accounting (see energy.h) between the planned wake and the end of the boot, and
+ * smoothed. Floors come from the energy current table. Costs live in RTC memory, so they
+ * carry across deep sleep. Publishes sleep.light.be.ms (gap above which light sleep beats
+ * staying awake), sleep.stub.be.ms and sleep.deep.be.ms (above which they beat light
+ * sleep) and sleep.mode (the latest choice).
+ *
+ * Within the awake window the node can also doze: with Bluetooth modem sleep and automatic
+ * light sleep the chip sleeps whenever every task is blocked, waking for each advertising
+ * or connection event, so it stays connectable. That lowers the floor of staying awake.
+ * It needs a framework built with CONFIG_PM_ENABLE and CONFIG_FREERTOS_USE_TICKLESS_IDLE,
+ * which the stock Arduino one is not, so BLE_MODEM_SLEEP selects it at build time.
+ */
+#ifndef BLE_MODEM_SLEEP
+#define BLE_MODEM_SLEEP 0
+#endif
+
+enum SleepMode : uint8_t {
+    SLEEP_MODE_AWAKE = 0,  // keep blocking in the loop
+    SLEEP_MODE_LIGHT,      // RAM kept, resumes in the loop; the radio is stopped around it
+    SLEEP_MODE_STUB,       // deep sleep, woken into the sensors only boot path
+    SLEEP_MODE_DEEP,       // deep sleep, woken into a full boot
+    SLEEP_MODES,
+};
+
+struct SleepModeCost {
+    uint32_t wakeMs;            // from the wake until ready
+    uint32_t wakeChargeMa10Ms;  // drawn meanwhile, tenths of a mA times milliseconds
+    uint16_t floorMa10;         // while asleep
+    uint16_t measured;          // wakes folded in, saturating
+};
+
+/**
+ * Wake costs assumed until measured: light sleep includes restarting advertising and the
+ * display task (the controller and bluedroid stay up, see sleepModeLightBegin()), the stub
+ * a boot and one sample, deep sleep a boot, the peripherals and BLE init. The measured
+ * light sleep wake is published as sleep.light.wake.ms.
+ */
+const uint32_t SLEEP_LIGHT_WAKE_MS = 10;
+const uint32_t SLEEP_STUB_WAKE_MS = 350;
+const uint32_t SLEEP_DEEP_WAKE_MS = 800;
+const uint8_t SLEEP_SMOOTHING = 4;  // a measurement moves the estimate a quarter of the way
+
+inline uint8_t sleepModeBit(SleepMode mode) {
+    return 1 << mode;
+}
+
+/**
+ * Takes the floors from the energy current table (call energyBegin() first). Keeps the
+ * measured wake costs across deep sleep, estimates them after a cold boot.
+ */
+void sleepModeBegin();
+
+/**
+ * The cheapest of the allowed modes (a mask of sleepModeBit()) for a gap of gapMs.
+ * Staying awake is always allowed, and a mode that cannot wake within the gap is not.
+ */
+SleepMode sleepModeSelect(uint32_t gapMs, uint8_t allowed);
+
+/**
+ * Charge a gap of gapMs costs in a mode, UINT64_MAX if it cannot wake within it.
+ */
+uint64_t sleepModeChargeMa10Ms(SleepMode mode, uint32_t gapMs);
+
+/**
+ * The gap above which mode costs less than than, UINT32_MAX if never.
+ */
+uint32_t sleepModeBreakEvenMs(SleepMode mode, SleepMode than);
+
+/**
+ * Records a sleep about to start at now for sleepMs, with the charge accounted so far.
+ */
+void sleepModeStart(SleepMode mode, uint64_t now, uint32_t sleepMs, uint64_t chargeMa10Ms);
+
+/**
+ * The mode of the latest sleep, SLEEP_MODE_AWAKE after a cold boot.
+ */
+SleepMode sleepModeLast();
+
+/**
+ * Ends the latest sleep once the node is ready again. On a timer wake the time and charge
+ * since the planned wake are folded into that mode's cost; other wakes came early.
+ */
+void sleepModeWoke(uint64_t now, uint64_t chargeMa10Ms, bool timer);
+
+const SleepModeCost &sleepModeCost(SleepMode mode);
+
+/**
+ * Whether the loop dozes rather than idles while awake, which sets the awake floor.
+ */
+void sleepModeSetDoze(bool doze);
+
+#ifdef ARDUINO
+/**
+ * Enables modem sleep on the BLE controller (call after BLEDevice::init()), so it can stay
+ * up through a light sleep: bluedroid keeps the GATT server and the advertising data, and
+ * advertising only pauses. Returns false if the controller was built without modem sleep;
+ * light sleep is then not an option, as disabling bluedroid would drop the services.
+ */
+bool sleepModeLightBegin();
+
+/**
+ * sleepModeLightBegin() and automatic light sleep, then sleepModeSetDoze(). Returns false
+ * if the framework cannot.
+ */
+bool sleepModeDozeBegin();
+#endif
+
+/**
+ * Forgets the measurements.
+ */
+void sleepModeReset();
+
+#endif  // LIB_MYNWEN_SLEEPMODE_H_
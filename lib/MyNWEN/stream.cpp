@@ -0,0 +1,142 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifdef ARDUINO
+#include "stream.h"
+
+#include <Arduino.h>
+#include <driver/uart.h>
+#include <esp_timer.h>
+
+#include "cobs.h"
+#include "console.h"
+#include "diagnostics.h"
+#include "hotpath.h"
+
+static const uart_port_t STREAM_UART = UART_NUM_0;
+static const int STREAM_TX_BUFFER = 16384;  // driver ring buffer
+static const int STREAM_RX_BUFFER = 256;
+static const uint16_t STREAM_QUEUE_LEN = 512;
+static const uint8_t STREAM_BATCH = 32;  // records encoded per uart_write_bytes()
+static constexpr size_t FRAME_MAX = cobsMaxEncoded(sizeof(StreamRecord) + 2) + 1;
+
+static StreamSampler sampler = NULL;
+static QueueHandle_t sampleQueue = NULL;
+static esp_timer_handle_t sampleTimer = NULL;
+static volatile bool active = false;
+static volatile bool stopping = false;
+static uint32_t seq = 0;
+
+/**
+ * esp_timer callback: take one sample and hand it to the encoder task. In IRAM, so the
+ * timestamp is not delayed by a cache miss on entry.
+ */
+static void HOT_IRAM_ATTR onSampleTimer(void *arg) {
+    StreamRecord r;
+    r.seq = seq++;
+    r.timeUs = (uint32_t)esp_timer_get_time();
+    r.value = sampler();
+    if (xQueueSend(sampleQueue, &r, 0) != pdTRUE) diagAdd("stream.dropped", 1);
+}
+
+/**
+ * Takes UART0 from Serial. Under the console lock, so the console task is not reading it.
+ */
+static void uartOpen() {
+    consoleLock();
+    Serial.flush();
+    Serial.end();
+
+    uart_config_t config = {};
+    config.baud_rate = STREAM_BAUD;
+    config.data_bits = UART_DATA_8_BITS;
+    config.parity = UART_PARITY_DISABLE;
+    config.stop_bits = UART_STOP_BITS_1;
+    config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+    uart_param_config(STREAM_UART, &config);
+    uart_set_pin(STREAM_UART, 1, 3, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    uart_driver_install(STREAM_UART, STREAM_RX_BUFFER, STREAM_TX_BUFFER, 0, NULL, 0);
+    consoleUnlock();
+}
+
+static void uartClose() {
+    uart_wait_tx_done(STREAM_UART, pdMS_TO_TICKS(500));
+    consoleLock();
+    uart_driver_delete(STREAM_UART);
+    Serial.begin(115200);
+    consoleUnlock();
+}
+
+/**
+ * Encodes queued samples in batches and feeds them to the UART ring buffer. Runs until
+ * stopped locally or by any byte from the host, then tears everything down.
+ */
+static void streamTask(void *arg) {
+    static uint8_t batch[STREAM_BATCH * FRAME_MAX];
+
+    while (!stopping) {
+        size_t len = 0;
+        StreamRecord r;
+        if (xQueueReceive(sampleQueue, &r, pdMS_TO_TICKS(20)) == pdTRUE) {
+            do {
+                len += frameEncode((const uint8_t *)&r, sizeof(r), &batch[len]);
+            } while (len + FRAME_MAX <= sizeof(batch) &&
+                     xQueueReceive(sampleQueue, &r, 0) == pdTRUE);
+            uart_write_bytes(STREAM_UART, (const char *)batch, len);
+            diagAdd("stream.bytes", len);
+        }
+
+        uint8_t in;
+        if (uart_read_bytes(STREAM_UART, &in, 1, 0) > 0) stopping = true;
+    }
+
+    esp_timer_stop(sampleTimer);
+    esp_timer_delete(sampleTimer);
+    vQueueDelete(sampleQueue);
+    uartClose();
+
+    active = false;
+    vTaskDelete(NULL);
+}
+
+void streamBegin(StreamSampler read) {
+    sampler = read;
+}
+
+bool streamStart(uint16_t rateHz) {
+    if (active || !sampler) return false;
+    if (rateHz > STREAM_MAX_HZ) rateHz = STREAM_MAX_HZ;
+    if (rateHz == 0) rateHz = STREAM_DEFAULT_HZ;
+
+    active = true;
+    stopping = false;
+    diagSet("stream.hz", rateHz);
+
+    uartOpen();
+    sampleQueue = xQueueCreate(STREAM_QUEUE_LEN, sizeof(StreamRecord));
+
+    esp_timer_create_args_t args = {};
+    args.callback = onSampleTimer;
+    args.name = "stream";
+    esp_timer_create(&args, &sampleTimer);
+    esp_timer_start_periodic(sampleTimer, 1000000 / rateHz);
+
+    xTaskCreatePinnedToCore(streamTask, "stream", 4096, NULL, 2, NULL, APP_CPU_NUM);
+    return true;
+}
+
+void streamStop() {
+    if (active) stopping = true;
+}
+
+bool streamActive() {
+    return active;
+}
+#endif
@@ -0,0 +1,54 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_STREAM_H_
+#define LIB_MYNWEN_STREAM_H_
+
+#include <stdint.h>
+
+/**
+ * High rate binary streaming over UART0 for lab characterisation.
+ *
+ * While streaming, Serial is released and UART0 is driven by the IDF UART driver at
+ * STREAM_BAUD with a large TX ring buffer, so the encoder task only copies frames into
+ * the ring and the driver's FIFO interrupt drains it. Each sample is one COBS frame:
+ *
+ *   StreamRecord (10 bytes, little endian) + CRC-16, COBS encoded, 0x00 delimited.
+ *
+ * Streaming is started by a long BtnB press or the console line "stream [hz]". Any byte
+ * received while streaming stops it and restores Serial at 115200.
+ */
+const uint32_t STREAM_BAUD = 921600;
+const uint16_t STREAM_DEFAULT_HZ = 500;
+const uint16_t STREAM_MAX_HZ = 4000;
+
+struct __attribute__((packed)) StreamRecord {
+    uint32_t seq;     // increments per sample, gaps mean dropped samples
+    uint32_t timeUs;  // low 32 bits of esp_timer_get_time()
+    int16_t value;    // hundredths of a degree
+};
+
+/**
+ * Reads the sensor without side effects. Called from the esp_timer task, keep it short.
+ */
+typedef int16_t (*StreamSampler)();
+
+void streamBegin(StreamSampler sampler);
+
+/**
+ * Starts streaming at rateHz (clamped to STREAM_MAX_HZ). Returns false if already active.
+ */
+bool streamStart(uint16_t rateHz);
+
+void streamStop();
+
+bool streamActive();
+
+#endif  // LIB_MYNWEN_STREAM_H_
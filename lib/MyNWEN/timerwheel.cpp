@@ -0,0 +1,178 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#include "timerwheel.h"
+
+#include <string.h>
+
+#include "critical.h"
+
+static WheelTimer *slots[TIMER_LEVELS][TIMER_SLOTS];
+static uint64_t occupied[TIMER_LEVELS];  // a bit per non-empty slot
+static uint64_t current = 0;             // the time the wheel has run to
+
+// Timers are armed from the BLE task too.
+CRITICAL_DECLARE(lock);
+
+static uint8_t slotOf(uint64_t ms, uint8_t level) {
+    return (ms >> (TIMER_SLOT_BITS * level)) & (TIMER_SLOTS - 1);
+}
+
+/**
+ * The lowest level whose current block holds key.
+ */
+static uint8_t levelOf(uint64_t key) {
+    for (uint8_t level = 0; level < TIMER_LEVELS - 1; level++) {
+        uint8_t shift = TIMER_SLOT_BITS * (level + 1);
+        if (key >> shift == current >> shift) return level;
+    }
+    return TIMER_LEVELS - 1;
+}
+
+static void link(WheelTimer *timer) {
+    uint64_t end = current + TIMER_RANGE_MS - 1;
+    uint64_t key = timer->expiresMs < current ? current : timer->expiresMs;
+    timer->keyMs = key < end ? key : end;
+    timer->level = levelOf(timer->keyMs);
+    timer->slot = slotOf(timer->keyMs, timer->level);
+
+    WheelTimer *&head = slots[timer->level][timer->slot];
+    timer->prev = NULL;
+    timer->next = head;
+    if (head) head->prev = timer;
+    head = timer;
+    occupied[timer->level] |= 1ull << timer->slot;
+    timer->armed = true;
+}
+
+static void unlink(WheelTimer *timer) {
+    WheelTimer *&head = slots[timer->level][timer->slot];
+    if (timer->prev) {
+        timer->prev->next = timer->next;
+    } else {
+        head = timer->next;
+    }
+    if (timer->next) timer->next->prev = timer->prev;
+    if (!head) occupied[timer->level] &= ~(1ull << timer->slot);
+    timer->armed = false;
+}
+
+/**
+ * The first occupied slot of a level. Below the top every timer is in the current block,
+ * after the current slot. The top level wraps into the next turn, so it is searched from
+ * the slot after the current one round to the current one, which only holds the next turn.
+ */
+static uint8_t firstSlot(uint8_t level) {
+    if (level < TIMER_LEVELS - 1) return __builtin_ctzll(occupied[level]);
+    uint8_t from = (slotOf(current, level) + 1) & (TIMER_SLOTS - 1);
+    uint64_t rotated = occupied[level] >> from | occupied[level] << ((TIMER_SLOTS - from) & (TIMER_SLOTS - 1));
+    return (from + __builtin_ctzll(rotated)) & (TIMER_SLOTS - 1);
+}
+
+/**
+ * The earliest key filed, UINT64_MAX if none. Call with the lock held.
+ */
+static uint64_t nextKey() {
+    for (uint8_t level = 0; level < TIMER_LEVELS; level++) {
+        if (!occupied[level]) continue;
+        uint8_t slot = firstSlot(level);
+        if (level == 0) return (current & ~(uint64_t)(TIMER_SLOTS - 1)) | slot;
+
+        uint64_t key = UINT64_MAX;
+        for (WheelTimer *t = slots[level][slot]; t; t = t->next) {
+            if (t->keyMs < key) key = t->keyMs;
+        }
+        return key;
+    }
+    return UINT64_MAX;
+}
+
+/**
+ * Moves the wheel to target, no later than the next key, refiling the slot time has
+ * reached on each level from the top down. Call with the lock held.
+ */
+static void advance(uint64_t target) {
+    if (target <= current) return;
+    current = target;
+
+    for (uint8_t level = TIMER_LEVELS - 1; level > 0; level--) {
+        uint8_t slot = slotOf(current, level);
+        WheelTimer *list = slots[level][slot];
+        if (!list) continue;
+        slots[level][slot] = NULL;
+        occupied[level] &= ~(1ull << slot);
+        while (list) {
+            WheelTimer *next = list->next;
+            link(list);
+            list = next;
+        }
+    }
+}
+
+void timerWheelBegin(uint64_t now) {
+    CRITICAL_ENTER(lock);
+    memset(slots, 0, sizeof(slots));
+    memset(occupied, 0, sizeof(occupied));
+    current = now;
+    CRITICAL_EXIT(lock);
+}
+
+void timerWheelInit(WheelTimer *timer, TimerCallback fn, void *arg) {
+    memset(timer, 0, sizeof(*timer));
+    timer->fn = fn;
+    timer->arg = arg;
+}
+
+void timerWheelArm(WheelTimer *timer, uint64_t at) {
+    CRITICAL_ENTER(lock);
+    if (timer->armed) unlink(timer);
+    timer->expiresMs = at;
+    link(timer);
+    CRITICAL_EXIT(lock);
+}
+
+void timerWheelCancel(WheelTimer *timer) {
+    CRITICAL_ENTER(lock);
+    if (timer->armed) unlink(timer);
+    CRITICAL_EXIT(lock);
+}
+
+bool timerWheelArmed(const WheelTimer *timer) {
+    return timer->armed;
+}
+
+uint32_t timerWheelMsUntilNext(uint64_t now) {
+    CRITICAL_ENTER(lock);
+    uint64_t next = nextKey();
+    CRITICAL_EXIT(lock);
+    if (next == UINT64_MAX) return UINT32_MAX;
+    if (next <= now) return 0;
+    return next - now < UINT32_MAX ? next - now : UINT32_MAX - 1;
+}
+
+void timerWheelRun(uint64_t now) {
+    while (true) {
+        CRITICAL_ENTER(lock);
+        uint64_t next = nextKey();
+        if (next > now) {
+            advance(now);
+            CRITICAL_EXIT(lock);
+            return;
+        }
+
+        // Time has reached the key, so its timer is now filed in level 0, unless it was
+        // filed at the end of the range and has been refiled further on.
+        advance(next);
+        WheelTimer *timer = slots[0][slotOf(next, 0)];
+        if (timer) unlink(timer);
+        CRITICAL_EXIT(lock);
+        if (timer && timer->fn) timer->fn(timer->arg);
+    }
+}
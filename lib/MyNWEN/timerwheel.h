@@ -0,0 +1,83 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_TIMERWHEEL_H_
+#define LIB_MYNWEN_TIMERWHEEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Hierarchical timer wheel for the firmware's deadlines, on the monotonic clock in ms.
+ *
+ * TIMER_LEVELS wheels of TIMER_SLOTS slots each; a slot of level n spans 64^n ms. A timer
+ * is filed in the lowest level whose current block (the span of one turn of the level
+ * above) holds its expiry, so every timer of a level expires after every timer of the
+ * levels below; the top level takes the rest of the range and wraps. Arming and
+ * cancelling link or unlink one list node, O(1). Running jumps straight to the next
+ * expiry, moving the one slot per level that time has reached down a level, so a long
+ * sleep costs nothing to catch up on. The next expiry is exact: the first occupied slot
+ * of the lowest occupied level (found from an occupancy bitmap), and for levels above 0
+ * the earliest timer in it.
+ *
+ * The wheel is the one timer the loop waits on and the sleep selector plans with, instead
+ * of a timer per deadline. Callbacks run in timerWheelRun(), from the caller's task; arming
+ * and cancelling are safe from other tasks.
+ */
+const uint8_t TIMER_SLOT_BITS = 6;
+const uint8_t TIMER_SLOTS = 1 << TIMER_SLOT_BITS;
+const uint8_t TIMER_LEVELS = 5;
+const uint64_t TIMER_RANGE_MS = 1ull << (TIMER_SLOT_BITS * TIMER_LEVELS);  // 12.4 days
+
+typedef void (*TimerCallback)(void *arg);
+
+/**
+ * Owned by the caller; the wheel only links it. A deadline more than TIMER_RANGE_MS ahead
+ * is filed at the end of the range and refiled from there.
+ */
+struct WheelTimer {
+    WheelTimer *next;
+    WheelTimer *prev;
+    uint64_t expiresMs;
+    uint64_t keyMs;  // where it is filed
+    TimerCallback fn;
+    void *arg;
+    uint8_t level;
+    uint8_t slot;
+    bool armed;
+};
+
+void timerWheelBegin(uint64_t now);
+
+/**
+ * A timer with no callback only marks a span, for timerWheelArmed() to test.
+ */
+void timerWheelInit(WheelTimer *timer, TimerCallback fn, void *arg = NULL);
+
+/**
+ * Arms the timer to fire at at, moving it if it was armed already.
+ */
+void timerWheelArm(WheelTimer *timer, uint64_t at);
+
+void timerWheelCancel(WheelTimer *timer);
+
+bool timerWheelArmed(const WheelTimer *timer);
+
+/**
+ * Milliseconds until the next timer fires, 0 if one is due, UINT32_MAX with none armed.
+ */
+uint32_t timerWheelMsUntilNext(uint64_t now);
+
+/**
+ * Fires every timer due by now, in order of expiry. A callback may arm timers again.
+ */
+void timerWheelRun(uint64_t now);
+
+#endif  // LIB_MYNWEN_TIMERWHEEL_H_
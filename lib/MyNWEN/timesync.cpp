@@ -0,0 +1,194 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#include "timesync.h"
+
+#include <sys/time.h>
+#include <time.h>
+
+#include "critical.h"
+#include "diagnostics.h"
+
+#ifdef ARDUINO
+#include <esp_clk.h>
+#endif
+
+const int32_t DRIFT_MAX_PPB = 10000000;  // 1%, beyond which a sync is a clock change
+const uint8_t CTS_REASON_EXTERNAL = 0x02;
+
+/**
+ * Wall time at the last sync and the monotonic time it was applied. The drift reference
+ * only moves once a sync is far enough from it to measure the rate over.
+ */
+struct SyncPoint {
+    uint64_t wallMs;
+    uint64_t monoUs;
+};
+
+RTC_DATA_ATTR static SyncPoint last = {0, 0};
+RTC_DATA_ATTR static SyncPoint reference = {0, 0};
+RTC_DATA_ATTR static int32_t driftPpb = 0;
+RTC_DATA_ATTR static bool synced = false;
+RTC_DATA_ATTR static bool driftKnown = false;
+
+CRITICAL_DECLARE(syncMux);  // the sync is written from the BLE task
+
+uint64_t timeSyncMonotonicUs() {
+#ifdef ARDUINO
+    // The RTC timer, scaled by the slow clock calibration; unlike esp_timer it keeps
+    // counting through deep sleep.
+    return esp_clk_rtc_time();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+uint64_t timeSyncMonotonicMs() {
+    return timeSyncMonotonicUs() / 1000;
+}
+
+static uint64_t wallAt(const SyncPoint &sync, int32_t drift, uint64_t monoUs) {
+    int64_t elapsedMs = (int64_t)(monoUs - sync.monoUs) / 1000;
+    return sync.wallMs + elapsedMs - elapsedMs * drift / 1000000000;
+}
+
+uint64_t timeSyncWallMsAt(uint64_t monotonicUs) {
+    CRITICAL_ENTER(syncMux);
+    SyncPoint sync = last;
+    int32_t drift = driftPpb;
+    CRITICAL_EXIT(syncMux);
+    return wallAt(sync, drift, monotonicUs);
+}
+
+uint64_t timeSyncWallMs() {
+    return timeSyncWallMsAt(timeSyncMonotonicUs());
+}
+
+bool timeSyncValid() {
+    return synced;
+}
+
+int32_t timeSyncDriftPpb() {
+    return driftPpb;
+}
+
+void timeSyncSetAt(uint64_t epochMs, uint64_t monotonicUs) {
+    SyncPoint now = {epochMs, monotonicUs};
+    int64_t error = synced ? (int64_t)(epochMs - timeSyncWallMsAt(monotonicUs)) : 0;
+
+    CRITICAL_ENTER(syncMux);
+    if (synced) {
+        int64_t wallMs = (int64_t)(epochMs - reference.wallMs);
+        int64_t monoMs = (int64_t)(monotonicUs - reference.monoUs) / 1000;
+        if (wallMs >= (int64_t)TIMESYNC_DRIFT_MIN_MS) {
+            int64_t raw = (monoMs - wallMs) * 1000000000 / wallMs;
+            if (raw > DRIFT_MAX_PPB || raw < -DRIFT_MAX_PPB) {
+                driftKnown = false;  // the wall clock was changed, start over
+            } else {
+                // Smooth over syncs: the write latency is a few ms either way.
+                driftPpb = driftKnown ? driftPpb + (raw - driftPpb) / 4 : raw;
+                driftKnown = true;
+            }
+            reference = now;
+        } else if (wallMs < 0) {
+            reference = now;
+        }
+    } else {
+        reference = now;
+    }
+    last = now;
+    synced = true;
+    CRITICAL_EXIT(syncMux);
+
+    diagSet("time.synced", 1);
+    diagSet("time.drift.ppb", driftPpb);
+    diagSet("time.error.ms", error > INT32_MAX || error < INT32_MIN ? INT32_MAX : error);
+
+#ifdef ARDUINO
+    // Keep time() and gettimeofday() on the synced clock as well.
+    struct timeval tv = {(time_t)(epochMs / 1000), (suseconds_t)(epochMs % 1000) * 1000};
+    settimeofday(&tv, NULL);
+#endif
+}
+
+void timeSyncSet(uint64_t epochMs) {
+    timeSyncSetAt(epochMs, timeSyncMonotonicUs());
+}
+
+/**
+ * Civil date conversions for the proleptic Gregorian calendar (H. Hinnant's algorithms),
+ * since newlib has no timegm().
+ */
+static int64_t daysFromCivil(int32_t y, uint32_t m, uint32_t d) {
+    y -= m <= 2;
+    int32_t era = (y >= 0 ? y : y - 399) / 400;
+    uint32_t yoe = y - era * 400;
+    uint32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return (int64_t)era * 146097 + doe - 719468;
+}
+
+static void civilFromDays(int64_t z, int32_t *y, uint8_t *m, uint8_t *d) {
+    z += 719468;
+    int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+    uint32_t doe = z - (int64_t)era * 146097;
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint32_t mp = (5 * doy + 2) / 153;
+    *d = doy - (153 * mp + 2) / 5 + 1;
+    *m = mp < 10 ? mp + 3 : mp - 9;
+    *y = yoe + era * 400 + (*m <= 2);
+}
+
+size_t timeSyncReadCts(uint8_t *out, size_t max) {
+    if (max < CTS_CURRENT_TIME_LEN) return 0;
+
+    uint64_t ms = timeSyncWallMs();
+    int64_t days = ms / 86400000;
+    uint32_t msOfDay = ms % 86400000;
+    int32_t year;
+    civilFromDays(days, &year, &out[2], &out[3]);
+    out[0] = year;
+    out[1] = year >> 8;
+    out[4] = msOfDay / 3600000;
+    out[5] = msOfDay / 60000 % 60;
+    out[6] = msOfDay / 1000 % 60;
+    out[7] = (days + 3) % 7 + 1;  // 1970-01-01 was a Thursday, 1 is Monday
+    out[8] = (msOfDay % 1000) * 256 / 1000;
+    out[9] = synced ? CTS_REASON_EXTERNAL : 0;
+    return CTS_CURRENT_TIME_LEN;
+}
+
+void timeSyncWriteCts(const uint8_t *data, size_t len) {
+    if (len < 7) return;
+
+    uint16_t year = data[0] | data[1] << 8;
+    uint8_t month = data[2], day = data[3];
+    uint8_t hours = data[4], minutes = data[5], seconds = data[6];
+    if (year < 1970 || month < 1 || month > 12 || day < 1 || day > 31 || hours > 23 ||
+        minutes > 59 || seconds > 59) {
+        return;
+    }
+
+    uint64_t ms = daysFromCivil(year, month, day) * 86400000 +
+                  ((uint32_t)hours * 3600 + minutes * 60 + seconds) * 1000;
+    if (len >= 9) ms += (uint32_t)data[8] * 1000 / 256;
+    timeSyncSet(ms);
+}
+
+void timeSyncReset() {
+    CRITICAL_ENTER(syncMux);
+    last = reference = {0, 0};
+    driftPpb = 0;
+    synced = driftKnown = false;
+    CRITICAL_EXIT(syncMux);
+}
@@ -0,0 +1,78 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_TIMESYNC_H_
+#define LIB_MYNWEN_TIMESYNC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Clocks. The monotonic clock is the RTC timer, which keeps counting through deep sleep
+ * and is never set, so it is what deadlines are measured on. Wall clock time is derived
+ * from it and the last sync (written by a client to the Current Time characteristic):
+ *
+ *   wall = syncWall + elapsed - elapsed * drift
+ *
+ * where drift is the RTC's rate error, estimated from successive syncs at least
+ * TIMESYNC_DRIFT_MIN_MS apart and smoothed. The M5Stack Core has no 32 kHz crystal, so
+ * the RTC runs from the internal RC oscillator and its error matters.
+ *
+ * Publishes time.synced, time.drift.ppb and time.error.ms (correction at the last sync).
+ */
+const uint32_t TIMESYNC_DRIFT_MIN_MS = 600000;
+const uint8_t CTS_CURRENT_TIME_LEN = 10;
+
+uint64_t timeSyncMonotonicUs();
+
+uint64_t timeSyncMonotonicMs();
+
+/**
+ * Milliseconds since the Unix epoch. Before the first sync this counts from 0 at RTC
+ * power on, which keeps history ordered but not comparable across nodes.
+ */
+uint64_t timeSyncWallMs();
+
+bool timeSyncValid();
+
+/**
+ * Applies a sync to epochMs taken now, updating the drift estimate.
+ */
+void timeSyncSet(uint64_t epochMs);
+
+/**
+ * Applies a sync at a given monotonic time, for simulations.
+ */
+void timeSyncSetAt(uint64_t epochMs, uint64_t monotonicUs);
+
+uint64_t timeSyncWallMsAt(uint64_t monotonicUs);
+
+/**
+ * Estimated RTC rate error, parts per billion (positive runs fast).
+ */
+int32_t timeSyncDriftPpb();
+
+/**
+ * Current Time characteristic (0x2A2B) value: year, month, day, hours, minutes,
+ * seconds, day of week, fractions of 1/256 s, adjust reason. Times are UTC.
+ */
+size_t timeSyncReadCts(uint8_t *out, size_t max);
+
+/**
+ * Applies a Current Time value written by a client.
+ */
+void timeSyncWriteCts(const uint8_t *data, size_t len);
+
+/**
+ * Forgets the sync and drift estimate.
+ */
+void timeSyncReset();
+
+#endif  // LIB_MYNWEN_TIMESYNC_H_
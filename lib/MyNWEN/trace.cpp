@@ -0,0 +1,87 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static TraceWrite recordOut = NULL;
+
+static const TraceSample *replay = NULL;
+static size_t replayCount = 0;
+static size_t replayNext = 0;
+static int16_t current[SENSOR_COUNT];
+
+void traceRecordBegin(TraceWrite write) {
+    recordOut = write;
+}
+
+bool traceRecording() {
+    return recordOut != NULL;
+}
+
+void traceRecord(uint8_t sensor, int16_t value, uint64_t ms) {
+    TraceWrite write = recordOut;
+    if (!write) return;
+
+    char line[sizeof(TRACE_RECORD_PREFIX) + TRACE_LINE_MAX];
+    strcpy(line, TRACE_RECORD_PREFIX);
+    traceFormat({ms, sensor, value}, line + strlen(line), TRACE_LINE_MAX);
+    write(line);
+}
+
+size_t traceFormat(const TraceSample &s, char *out, size_t max) {
+    int n = snprintf(out, max, "%llu,%u,%d", (unsigned long long)s.ms, s.sensor, s.value);
+    return n < 0 ? 0 : ((size_t)n < max ? n : max - 1);
+}
+
+bool traceParse(const char *line, TraceSample *s) {
+    if (strncmp(line, TRACE_RECORD_PREFIX, strlen(TRACE_RECORD_PREFIX)) == 0) {
+        line += strlen(TRACE_RECORD_PREFIX);
+    }
+
+    char *end;
+    unsigned long long ms = strtoull(line, &end, 10);
+    if (end == line || *end != ',') return false;
+    line = end + 1;
+    unsigned long sensor = strtoul(line, &end, 10);
+    if (end == line || *end != ',' || sensor >= SENSOR_COUNT) return false;
+    line = end + 1;
+    long value = strtol(line, &end, 10);
+    if (end == line || value < INT16_MIN || value > INT16_MAX) return false;
+
+    *s = {ms, (uint8_t)sensor, (int16_t)value};
+    return true;
+}
+
+void traceReplayBegin(const TraceSample *samples, size_t count) {
+    replay = samples;
+    replayCount = count;
+    replayNext = 0;
+    memset(current, 0, sizeof(current));
+}
+
+size_t traceReplayAdvance(uint64_t ms) {
+    size_t passed = 0;
+    for (; replayNext < replayCount && replay[replayNext].ms <= ms; replayNext++, passed++) {
+        current[replay[replayNext].sensor] = replay[replayNext].value;
+    }
+    return passed;
+}
+
+uint64_t traceReplayNextMs() {
+    return replayNext < replayCount ? replay[replayNext].ms : UINT64_MAX;
+}
+
+int16_t traceReplayValue(SensorId id) {
+    return current[id];
+}
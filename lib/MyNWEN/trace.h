@@ -0,0 +1,94 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_TRACE_H_
+#define LIB_MYNWEN_TRACE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sensors.h"
+
+/**
+ * Sample traces, to reproduce field behaviour offline. A trace is text with one raw
+ * sample per line, in time order:
+ *
+ *   <ms since the epoch>,<sensor id>,<value in the history unit>
+ *
+ * In record mode the node prints each sample on the console as "T," and the line, except
+ * while a host is using the binary protocol (see protocol.h); tools/trace_record.py
+ * captures them, or rebuilds a trace from history. The replay side
+ * serves a trace through the sensor interface: traceReplayRead<Id> is a SensorRead
+ * returning the sensor's latest recorded value at the replay time.
+ */
+const size_t TRACE_LINE_MAX = 40;
+const char TRACE_RECORD_PREFIX[] = "T,";
+
+struct TraceSample {
+    uint64_t ms;
+    uint8_t sensor;
+    int16_t value;
+};
+
+/**
+ * Receives a recorded line, without the line ending.
+ */
+typedef void (*TraceWrite)(const char *line);
+
+/**
+ * Starts printing every recorded sample through write, or stops with NULL.
+ */
+void traceRecordBegin(TraceWrite write);
+
+bool traceRecording();
+
+/**
+ * Records a sample if recording.
+ */
+void traceRecord(uint8_t sensor, int16_t value, uint64_t ms);
+
+/**
+ * Formats a sample as a trace line. Returns its length.
+ */
+size_t traceFormat(const TraceSample &sample, char *out, size_t max);
+
+/**
+ * Parses a trace line, with or without the record prefix. Returns false for headers,
+ * comments and malformed lines.
+ */
+bool traceParse(const char *line, TraceSample *sample);
+
+/**
+ * Serves samples, which must stay valid and be in time order, from the first one on.
+ */
+void traceReplayBegin(const TraceSample *samples, size_t count);
+
+/**
+ * Moves the replay time to ms, making every sample up to it current. Returns the number
+ * of samples passed.
+ */
+size_t traceReplayAdvance(uint64_t ms);
+
+/**
+ * Time of the next sample not yet current, or UINT64_MAX at the end.
+ */
+uint64_t traceReplayNextMs();
+
+/**
+ * Latest value of a sensor at the replay time, 0 before its first sample.
+ */
+int16_t traceReplayValue(SensorId id);
+
+template <SensorId Id>
+int16_t traceReplayRead() {
+    return traceReplayValue(Id);
+}
+
+#endif  // LIB_MYNWEN_TRACE_H_
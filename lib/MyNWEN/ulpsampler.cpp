@@ -0,0 +1,167 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#include "ulpsampler.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <driver/adc.h>
+#include <esp32/ulp.h>
+#include <esp_sleep.h>
+#include <soc/rtc_cntl_reg.h>
+
+#ifdef CONFIG_ULP_COPROC_RESERVE_MEM
+static_assert(ULP_MEMORY_WORDS * 4 <= CONFIG_ULP_COPROC_RESERVE_MEM,
+              "ULP memory exceeds the reserved RTC slow memory");
+#endif
+
+uint32_t *ulpSamplerMemory() {
+    return RTC_SLOW_MEM;
+}
+
+/**
+ * Stops the ULP timer and waits out a run already started, so the buffer holds still.
+ */
+static void pause() {
+    CLEAR_PERI_REG_MASK(RTC_CNTL_STATE0_REG, RTC_CNTL_ULP_CP_SLP_TIMER_EN);
+    delayMicroseconds(200);
+}
+
+static void resume() {
+    SET_PERI_REG_MASK(RTC_CNTL_STATE0_REG, RTC_CNTL_ULP_CP_SLP_TIMER_EN);
+}
+#else
+static uint32_t memory[ULP_MEMORY_WORDS];
+
+uint32_t *ulpSamplerMemory() {
+    return memory;
+}
+
+static void pause() {}
+
+static void resume() {}
+#endif
+
+void ulpSamplerReset(uint16_t threshold, uint16_t reference) {
+    uint32_t *mem = ulpSamplerMemory();
+    mem[ULP_VAR_COUNT] = 0;
+    mem[ULP_VAR_REFERENCE] = reference;
+    mem[ULP_VAR_THRESHOLD] = threshold;
+    mem[ULP_VAR_DROPPED] = 0;
+}
+
+uint8_t ulpSamplerDrain(uint16_t *out, uint16_t *dropped) {
+    uint32_t *mem = ulpSamplerMemory();
+    if (!(mem[ULP_VAR_COUNT] & 0xFFFF) && !(mem[ULP_VAR_DROPPED] & 0xFFFF)) return 0;
+
+    pause();
+    uint16_t n = mem[ULP_VAR_COUNT] & 0xFFFF;
+    if (n > ULP_BUFFER) n = ULP_BUFFER;
+    for (uint8_t i = 0; i < n; i++) out[i] = mem[ULP_VAR_BUFFER + i] & 0xFFFF;
+    if (n) mem[ULP_VAR_REFERENCE] = out[n - 1];
+    if (dropped) *dropped = mem[ULP_VAR_DROPPED] & 0xFFFF;
+    mem[ULP_VAR_COUNT] = 0;
+    mem[ULP_VAR_DROPPED] = 0;
+    resume();
+    return n;
+}
+
+uint16_t ulpSamplerLatest() {
+    const uint32_t *mem = ulpSamplerMemory();
+    uint16_t n = mem[ULP_VAR_COUNT] & 0xFFFF;
+    if (n > ULP_BUFFER) n = ULP_BUFFER;
+    return (n ? mem[ULP_VAR_BUFFER + n - 1] : mem[ULP_VAR_REFERENCE]) & 0xFFFF;
+}
+
+bool ulpSamplerEmulate(uint16_t raw) {
+    uint32_t *mem = ulpSamplerMemory();
+    uint16_t count = mem[ULP_VAR_COUNT] & 0xFFFF;
+    if (count >= ULP_BUFFER) {
+        mem[ULP_VAR_DROPPED] = (mem[ULP_VAR_DROPPED] + 1) & 0xFFFF;
+        return true;
+    }
+    mem[ULP_VAR_BUFFER + count] = raw;
+    mem[ULP_VAR_COUNT] = ++count;
+    if (count >= ULP_BUFFER) return true;
+
+    uint16_t reference = mem[ULP_VAR_REFERENCE] & 0xFFFF;
+    uint16_t distance = raw >= reference ? raw - reference : reference - raw;
+    return distance > (mem[ULP_VAR_THRESHOLD] & 0xFFFF);
+}
+
+#ifdef ARDUINO
+bool ulpSamplerBegin(uint8_t channel, uint32_t periodMs, uint16_t threshold) {
+    adc1_channel_t pad = (adc1_channel_t)channel;
+    adc1_config_width(ADC_WIDTH_BIT_12);
+    adc1_config_channel_atten(pad, ADC_ATTEN_DB_11);
+    uint32_t first = 0;
+    for (uint8_t i = 0; i < 4; i++) first += adc1_get_raw(pad);
+    adc1_ulp_enable();
+
+    // Registers: R0 compare, R1 sample, R2 scratch, R3 the address of the variables.
+    // ulpSamplerEmulate() mirrors this; keep the two in step.
+    enum { LABEL_BELOW, LABEL_COMPARE, LABEL_FULL, LABEL_WAKE, LABEL_DONE };
+    const ulp_insn_t program[] = {
+        I_ADC(R1, 0, channel),
+        I_ADC(R2, 0, channel),
+        I_ADDR(R1, R1, R2),
+        I_ADC(R2, 0, channel),
+        I_ADDR(R1, R1, R2),
+        I_ADC(R2, 0, channel),
+        I_ADDR(R1, R1, R2),
+        I_RSHI(R1, R1, 2),
+
+        // Append, or count a drop if the main cores have not drained a full buffer.
+        I_MOVI(R3, ULP_VAR_COUNT),
+        I_LD(R0, R3, 0),
+        M_BGE(LABEL_FULL, ULP_BUFFER),
+        I_ADDR(R2, R3, R0),
+        I_ST(R1, R2, ULP_VAR_BUFFER - ULP_VAR_COUNT),
+        I_ADDI(R0, R0, 1),
+        I_ST(R0, R3, 0),
+        M_BGE(LABEL_WAKE, ULP_BUFFER),
+
+        // R0 = |sample - reference|, a borrow sets the overflow flag.
+        I_LD(R2, R3, ULP_VAR_REFERENCE - ULP_VAR_COUNT),
+        I_SUBR(R0, R1, R2),
+        M_BXF(LABEL_BELOW),
+        M_BX(LABEL_COMPARE),
+        M_LABEL(LABEL_BELOW),
+        I_SUBR(R0, R2, R1),
+        M_LABEL(LABEL_COMPARE),
+        I_LD(R2, R3, ULP_VAR_THRESHOLD - ULP_VAR_COUNT),
+        I_SUBR(R0, R0, R2),
+        M_BXF(LABEL_DONE),
+        M_BXZ(LABEL_DONE),
+        M_BX(LABEL_WAKE),
+
+        M_LABEL(LABEL_FULL),
+        I_LD(R0, R3, ULP_VAR_DROPPED - ULP_VAR_COUNT),
+        I_ADDI(R0, R0, 1),
+        I_ST(R0, R3, ULP_VAR_DROPPED - ULP_VAR_COUNT),
+        M_LABEL(LABEL_WAKE),
+        I_WAKE(),
+        M_LABEL(LABEL_DONE),
+        I_HALT(),
+    };
+
+    size_t size = sizeof(program) / sizeof(ulp_insn_t);
+    if (ulp_process_macros_and_load(0, program, &size) != ESP_OK) return false;
+    if (size > ULP_PROGRAM_WORDS) return false;
+
+    ulpSamplerReset(threshold, first / 4);
+    ulp_set_wakeup_period(0, periodMs * 1000);
+    return ulp_run(0) == ESP_OK;
+}
+
+void ulpSamplerEnableWakeup() {
+    esp_sleep_enable_ulp_wakeup();
+}
+#endif
@@ -0,0 +1,108 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_ULPSAMPLER_H_
+#define LIB_MYNWEN_ULPSAMPLER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "calibration.h"
+
+/**
+ * Temperature sampling on the ULP coprocessor while the main cores deep sleep.
+ *
+ * The ULP wakes on its own timer, reads a thermistor on an ADC1 pad (the mean of four
+ * conversions), appends the raw value to a buffer in RTC slow memory and halts. It only
+ * wakes the main cores when the buffer fills or the reading moves more than a threshold
+ * from the reference, the last value the main cores drained. A drain turns the buffer into
+ * ordinary samples (see sensorRecord()), so history, notifications and delivery are
+ * unchanged; each sample is timed by its place in the buffer, to within one ULP period.
+ *
+ * The program is built with the IDF instruction macros and loaded at run time, so no ULP
+ * toolchain is needed. Its memory is ULP_MEMORY_WORDS 32 bit words at the start of RTC
+ * slow memory: the program, four variables and the buffer. ulpSamplerEmulate() is the
+ * same decision logic in C over the same layout, so the wake policy can be run on the host.
+ *
+ * ULP_SAMPLING selects it at build time. The node has no thermistor by default, so it is
+ * off and the temperature stays synthetic (see workload.h).
+ */
+#ifndef ULP_SAMPLING
+#define ULP_SAMPLING 0
+#endif
+
+const uint8_t ULP_PROGRAM_WORDS = 40;
+const uint8_t ULP_BUFFER = 80;  // samples per main core wake, at most
+
+enum UlpVar : uint8_t {
+    ULP_VAR_COUNT = ULP_PROGRAM_WORDS,  // samples in the buffer
+    ULP_VAR_REFERENCE,                  // raw value at the last drain
+    ULP_VAR_THRESHOLD,                  // wake when a sample is further than this from it
+    ULP_VAR_DROPPED,                    // samples lost to a full buffer
+    ULP_VAR_BUFFER,
+};
+
+const uint16_t ULP_MEMORY_WORDS = ULP_VAR_BUFFER + ULP_BUFFER;
+const uint16_t ULP_THRESHOLD_OFF = 0xFFFF;  // wake on a full buffer only
+
+/**
+ * Raw reading (12 bit, 11 dB) of a 10k B3950 NTC to ground under a 10k pull-up, against
+ * hundredths of a degree. It is the temperature sensor's factory calibration.
+ */
+static constexpr CalibrationPoint ULP_NTC_POINTS[] = {
+    {3495, -1000}, {3156, 0}, {2738, 1000}, {2278, 2000},
+    {1825, 3000}, {1419, 4000}, {1081, 5000}, {815, 6000},
+};
+static constexpr CalibrationTable ULP_NTC_TABLE = calibrationTable(ULP_NTC_POINTS);
+
+/**
+ * The ULP's memory: RTC slow memory on the device, a plain array on the host. Only the
+ * low 16 bits of a word written by the ULP are data.
+ */
+uint32_t *ulpSamplerMemory();
+
+/**
+ * Empties the buffer and sets the wake threshold and reference, both raw.
+ */
+void ulpSamplerReset(uint16_t threshold, uint16_t reference);
+
+/**
+ * Moves the buffered raw samples, oldest first, to out (ULP_BUFFER entries) and makes the
+ * newest the reference. Returns how many there were. dropped, if given, receives the
+ * samples lost since the last drain.
+ */
+uint8_t ulpSamplerDrain(uint16_t *out, uint16_t *dropped = NULL);
+
+/**
+ * Newest raw sample, buffered or drained.
+ */
+uint16_t ulpSamplerLatest();
+
+/**
+ * One run of the ULP program in C, with raw as the ADC reading. Returns whether it would
+ * wake the main cores.
+ */
+bool ulpSamplerEmulate(uint16_t raw);
+
+#ifdef ARDUINO
+/**
+ * Loads the program for ADC1 pad channel and starts it every periodMs, with an empty
+ * buffer and a first reading as the reference. The ULP keeps running through deep sleep,
+ * so this is for a cold boot. Returns false if the program cannot be loaded.
+ */
+bool ulpSamplerBegin(uint8_t channel, uint32_t periodMs, uint16_t threshold);
+
+/**
+ * Lets the ULP wake the node from the coming deep sleep.
+ */
+void ulpSamplerEnableWakeup();
+#endif
+
+#endif  // LIB_MYNWEN_ULPSAMPLER_H_
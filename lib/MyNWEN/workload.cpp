@@ -0,0 +1,131 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#include "workload.h"
+
+#include <math.h>
+
+#include "critical.h"
+
+static const WorkloadProfile PROFILES[SENSOR_COUNT] = {
+    // mean, diurnal, drift, step, steps/day, spike, spikes/day, decay s, noise, quantum
+    {2100, 150, 100, 150, 4, -300, 6, 300, 8, 6},      // hundredths of a degree
+    {4500, -800, 500, 0, 0, 1500, 2, 900, 50, 10},     // hundredths of a percent
+    {10130, 5, 150, 0, 0, 0, 0, 0, 1, 1},              // tenths of a hectopascal
+    {80, 0, 10, 0, 0, 0, 0, 0, 0, 1},                  // percent
+};
+
+// Salts keep the components of one trace independent.
+enum Salt : uint32_t { SALT_DRIFT = 1, SALT_STEP_AT, SALT_STEP_LEVEL, SALT_SPIKE, SALT_NOISE };
+
+RTC_DATA_ATTR static uint32_t currentSeed = WORKLOAD_SEED_DEFAULT;
+
+/**
+ * A 32-bit integer hash with good avalanche (from Chris Wellons' hash prospector).
+ */
+static uint32_t mix(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+static uint32_t hash(uint32_t seed, uint32_t salt, uint64_t n) {
+    return mix(seed ^ mix(salt ^ mix((uint32_t)n ^ mix(n >> 32))));
+}
+
+/**
+ * Uniform in [0, 1).
+ */
+static float unit(uint32_t h) {
+    return (h >> 8) * (1.0f / 16777216.0f);
+}
+
+/**
+ * Uniform in [-1, 1).
+ */
+static float signedUnit(uint32_t h) {
+    return 2 * unit(h) - 1;
+}
+
+static float diurnal(const WorkloadProfile &p, uint64_t ms) {
+    const float PEAK_MS = 15 * 3600000.0f;
+    return p.diurnal * cosf(2 * (float)M_PI * ((ms % WORKLOAD_DAY_MS) - PEAK_MS) / WORKLOAD_DAY_MS);
+}
+
+static float drift(const WorkloadProfile &p, uint32_t seed, uint64_t ms) {
+    uint64_t knot = ms / WORKLOAD_DRIFT_KNOT_MS;
+    float t = (float)(ms % WORKLOAD_DRIFT_KNOT_MS) / WORKLOAD_DRIFT_KNOT_MS;
+    float a = signedUnit(hash(seed, SALT_DRIFT, knot));
+    float b = signedUnit(hash(seed, SALT_DRIFT, knot + 1));
+    return p.drift * (a + (b - a) * t * t * (3 - 2 * t));  // smoothstep
+}
+
+static float step(const WorkloadProfile &p, uint32_t seed, uint64_t ms) {
+    if (!p.stepsPerDay) return 0;
+    uint32_t slotMs = WORKLOAD_DAY_MS / p.stepsPerDay;
+    uint64_t slot = ms / slotMs;
+    // The level changes to this slot's at a random time in it.
+    if (ms % slotMs < hash(seed, SALT_STEP_AT, slot) % slotMs) slot--;
+    return p.step * signedUnit(hash(seed, SALT_STEP_LEVEL, slot));
+}
+
+static float spike(const WorkloadProfile &p, uint32_t seed, uint64_t ms) {
+    if (!p.spikesPerDay) return 0;
+    uint32_t slotMs = WORKLOAD_DAY_MS / p.spikesPerDay;
+    float total = 0;
+    // A spike still recovering may have started in the previous slot.
+    for (uint64_t slot = ms / slotMs, n = 0; n < 2 && slot != UINT64_MAX; slot--, n++) {
+        uint32_t h = hash(seed, SALT_SPIKE, slot);
+        if (h & 1) continue;
+        uint64_t at = slot * slotMs + (h >> 1) % slotMs;
+        if (at > ms) continue;
+        float height = 0.5f + 0.5f * unit(mix(h));
+        total += p.spike * height * expf(-(float)(ms - at) / (1000.0f * p.spikeDecayS));
+    }
+    return total;
+}
+
+/**
+ * Sum of four uniforms, near enough to Gaussian for sensor noise.
+ */
+static float noise(const WorkloadProfile &p, uint32_t seed, uint64_t ms) {
+    if (!p.noise) return 0;
+    uint32_t h = hash(seed, SALT_NOISE, ms);
+    float sum = 0;
+    for (uint8_t i = 0; i < 4; i++, h = mix(h)) sum += signedUnit(h);
+    return p.noise * sum * 0.866f;  // the sum has a standard deviation of 2 / sqrt(3)
+}
+
+int16_t workloadValue(const WorkloadProfile &p, uint32_t seed, uint64_t epochMs) {
+    float v = p.mean + diurnal(p, epochMs) + drift(p, seed, epochMs) + step(p, seed, epochMs) +
+              spike(p, seed, epochMs) + noise(p, seed, epochMs);
+    int32_t q = p.quantum > 1 ? p.quantum : 1;
+    int32_t value = lroundf(v / q) * q;
+    return value > INT16_MAX ? INT16_MAX : (value < INT16_MIN ? INT16_MIN : value);
+}
+
+const WorkloadProfile &workloadProfile(SensorId id) {
+    return PROFILES[id];
+}
+
+void workloadSetSeed(uint32_t seed) {
+    currentSeed = seed;
+}
+
+uint32_t workloadSeed() {
+    return currentSeed;
+}
+
+int16_t workloadSample(SensorId id, uint64_t epochMs) {
+    return workloadValue(PROFILES[id], mix(currentSeed + id), epochMs);
+}
@@ -0,0 +1,73 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+#ifndef LIB_MYNWEN_WORKLOAD_H_
+#define LIB_MYNWEN_WORKLOAD_H_
+
+#include <stdint.h>
+
+#include "sensors.h"
+
+/**
+ * Synthetic sensor workload, for the demo node (which has no sensors of its own) and for
+ * host benchmarks of compression, filters and send-on-delta.
+ *
+ * A trace is a pure function of the seed and the time, built from hashes rather than a
+ * running PRNG, so it is the same whatever the sampling schedule, across deep sleep and
+ * between device and host. Each value is the sum of:
+ *
+ *   diurnal   a daily cosine peaking at 15:00 UTC
+ *   drift     smooth noise through random knots every WORKLOAD_DRIFT_KNOT_MS
+ *   steps     the level changing at a random time in each slot, eg. a heating schedule
+ *   spikes    a jump at a random time in some slots decaying back, eg. a door opening
+ *   noise     roughly Gaussian sensor noise
+ *
+ * then quantised to the sensor's resolution.
+ */
+const uint32_t WORKLOAD_DAY_MS = 86400000;
+const uint32_t WORKLOAD_DRIFT_KNOT_MS = 6 * 3600000;
+const uint32_t WORKLOAD_SEED_DEFAULT = 1;
+
+struct WorkloadProfile {
+    int16_t mean;           // all amplitudes in the sensor's history unit
+    int16_t diurnal;        // negative peaks at 03:00 instead
+    int16_t drift;
+    int16_t step;           // levels are within +-step of the mean
+    uint8_t stepsPerDay;
+    int16_t spike;
+    uint8_t spikesPerDay;   // at most; each slot has an even chance of one
+    uint16_t spikeDecayS;   // time constant of the recovery
+    int16_t noise;          // standard deviation
+    uint8_t quantum;        // resolution, 1 or more
+};
+
+/**
+ * Profiles for each sensor, indoors.
+ */
+const WorkloadProfile &workloadProfile(SensorId id);
+
+/**
+ * Value of a profile's trace at a time.
+ */
+int16_t workloadValue(const WorkloadProfile &profile, uint32_t seed, uint64_t epochMs);
+
+/**
+ * Sets the seed used by workloadSample(). It is kept in RTC memory.
+ */
+void workloadSetSeed(uint32_t seed);
+
+uint32_t workloadSeed();
+
+/**
+ * Value of a sensor's trace at a time, with the sensor's own stream of the current seed.
+ */
+int16_t workloadSample(SensorId id, uint64_t epochMs);
+
+#endif  // LIB_MYNWEN_WORKLOAD_H_
@@ -0,0 +1,1123 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ *
+ * Native host simulator. Runs the portable firmware modules against host stand-ins
+ * (eg. the framebuffer LCD) for benchmarks and image snapshots.
+ *
+ *   pio run -e native && .pio/build/native/program <command> [args]
+ */
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "dashboard.h"
+#include "diagnostics.h"
+#include "display_power.h"
+#include "energy.h"
+#include "gateway.h"
+#include "history.h"
+#include "lcd.h"
+#include "persist.h"
+#include "calibration.h"
+#include "cobs.h"
+#include "coalesce.h"
+#include "protocol.h"
+#include "recovery.h"
+#include "sensors.h"
+#include "sleepmode.h"
+#include "timesync.h"
+#include "timerwheel.h"
+#include "trace.h"
+#include "ulpsampler.h"
+#include "workload.h"
+
+static const uint32_t FULL_FRAME_BYTES =
+    MockLcd::WIDTH * MockLcd::HEIGHT * 2 + MockLcd::WINDOW_OVERHEAD;
+
+/**
+ * Renders the dashboard scene and writes it as a PPM. If a golden image is given the
+ * render is compared against it instead and the exit status reports a mismatch.
+ */
+static int commandSnapshot(int argc, char **argv) {
+    if (argc < 1) {
+        fprintf(stderr, "usage: snapshot <out.ppm> [golden.ppm]\n");
+        return 2;
+    }
+
+    dashboardLoadScene();
+    dashboardInvalidate();
+    dashboardRefresh();
+
+    if (!mockLcd.dumpPpm(argv[0])) {
+        fprintf(stderr, "snapshot: cannot write %s\n", argv[0]);
+        return 1;
+    }
+    if (argc < 2) return 0;
+
+    int32_t differing = mockLcd.diffPpm(argv[1]);
+    if (differing < 0) {
+        fprintf(stderr, "snapshot: cannot read golden %s\n", argv[1]);
+        return 1;
+    }
+    printf("%d pixels differ from %s\n", differing, argv[1]);
+    return differing ? 1 : 0;
+}
+
+/**
+ * Measures what a dashboard update costs against a full frame write, and the glyph cache
+ * against the font engine for the temperature readout.
+ */
+static int commandBenchRender(int argc, char **argv) {
+    uint16_t updates = argc > 0 ? atoi(argv[0]) : 200;
+
+    dashboardLoadScene();
+    mockLcd.resetStats();
+    dashboardInvalidate();
+    dashboardRefresh();
+    printf("%-28s %10s %10s %8s\n", "case", "pixels", "spi bytes", "% frame");
+    printf("%-28s %10u %10u %8.1f\n", "full repaint", mockLcd.stats().pixels,
+           mockLcd.stats().spiBytes, 100.0 * mockLcd.stats().spiBytes / FULL_FRAME_BYTES);
+
+    // Steady state: a new sample every update, so temperature and sparkline both change.
+    mockLcd.resetStats();
+    uint32_t start = micros();
+    for (uint16_t i = 0; i < updates; i++) {
+        int16_t temp = 1800 + (int16_t)((i * 53) % 900) - 450;
+        historyAppend((SPARKLINE_SAMPLES + i) * 60, temp);
+        dashboardSetTemperature(temp);
+        dashboardRefresh();
+    }
+    uint32_t elapsed = micros() - start;
+    LcdStats s = mockLcd.stats();
+    printf("%-28s %10u %10u %8.1f\n", "sample update (avg)", s.pixels / updates,
+           s.spiBytes / updates, 100.0 * s.spiBytes / updates / FULL_FRAME_BYTES);
+    printf("%-28s %10.1f us host\n", "sample update (avg)", (double)elapsed / updates);
+
+    // Temperature readout only: font engine against the glyph cache.
+    char text[8];
+    mockLcd.resetStats();
+    mockLcd.setTextColor(WHITE, BLACK);
+    for (uint16_t i = 0; i < updates; i++) {
+        snprintf(text, sizeof(text), "%d", i % 50 - 10);
+        mockLcd.drawString(text, 80, 48, 7);
+    }
+    s = mockLcd.stats();
+    printf("%-28s %10u %10u %8.1f\n", "temp via font engine (avg)", s.pixels / updates,
+           s.spiBytes / updates, 100.0 * s.spiBytes / updates / FULL_FRAME_BYTES);
+
+    mockLcd.resetStats();
+    for (uint16_t i = 0; i < updates; i++) {
+        dashboardSetTemperature((int16_t)(i % 50 - 10) * 100);
+        dashboardRefresh();
+    }
+    s = mockLcd.stats();
+    printf("%-28s %10u %10u %8.1f\n", "temp via glyph cache (avg)", s.pixels / updates,
+           s.spiBytes / updates, 100.0 * s.spiBytes / updates / FULL_FRAME_BYTES);
+
+    dashboardBenchmark(updates);
+    printf("%-28s %10d us host\n", "temp via font engine (avg)", diagGet("dash.font.us"));
+    printf("%-28s %10d us host\n", "temp via glyph cache (avg)", diagGet("dash.glyph.us"));
+    return 0;
+}
+
+static int16_t simSensor() {
+    return 0;
+}
+
+/**
+ * Sensor rates for the simulations. The periods are deliberately not multiples of each
+ * other, the case where slack matters.
+ */
+static const SensorSpec SIM_SENSORS[SENSOR_COUNT] = {
+    {"temperature", 0x2A6E, 2, 1, NULL, 10000, 2500, simSensor},
+    {"humidity", 0x2A6F, 2, 1, NULL, 25000, 6250, simSensor},
+    {"pressure", 0x2A6D, 4, 100, NULL, 45000, 11250, simSensor},
+    {"battery", 0x2A19, 1, 1, NULL, 120000, 30000, simSensor},
+};
+static const uint64_t SIM_START_MS = 1600000000000ull;
+
+/**
+ * Runs the sampling scheduler over simulated time, waking only when it asks to, and
+ * compares the wakes taken against one wake per sample.
+ */
+static int commandSchedSim(int argc, char **argv) {
+    uint32_t hours = argc > 0 ? atoi(argv[0]) : 24;
+
+    printf("%-12s %10s %10s %12s\n", "slack", "samples", "wakes", "samples/wake");
+    printf("%-12s %10s %10s %12.2f  (one wake per sample)\n", "-", "", "", 1.0);
+    for (int withSlack = 1; withSlack >= 0; withSlack--) {
+        SensorSpec specs[SENSOR_COUNT];
+        for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+            specs[i] = SIM_SENSORS[i];
+            if (!withSlack) specs[i].slackMs = 0;
+        }
+        sensorsBegin(specs, NULL);
+        sensorsReset();
+        historyReset();
+
+        // Start with every sensor due so the runs are comparable.
+        uint64_t start = SIM_START_MS, now = start;
+        sensorsRunDue(now);
+        diagSet("sensors.wakes", 0);
+        diagSet("sensors.samples", 0);
+        while (now < start + hours * 3600000ull) {
+            now += sensorsMsUntilDue(now);
+            sensorsRunDue(now);
+        }
+
+        int32_t samples = diagGet("sensors.samples"), wakes = diagGet("sensors.wakes");
+        printf("%-12s %10d %10d %12.2f\n", withSlack ? "per sensor" : "none", samples, wakes,
+               (double)samples / wakes);
+    }
+    return 0;
+}
+
+static uint64_t simNow = 0;
+
+static void simCoalesce(SensorId id, uint32_t seq, int16_t value) {
+    coalesceAdd(id, seq, value, simNow, simNow);
+}
+
+/**
+ * Sweeps the notification latency budget at the default and a negotiated MTU, reporting
+ * notifications (radio events carrying data) per hour and sample to delivery latency.
+ */
+static int commandCoalesceSweep(int argc, char **argv) {
+    uint32_t hours = argc > 0 ? atoi(argv[0]) : 24;
+    static const uint16_t MTUS[] = {23, 185};
+    static const uint32_t BUDGETS_MS[] = {0, 1000, 5000, 15000, 30000, 60000, 300000};
+
+    printf("%5s %10s %12s %14s %12s %12s\n", "mtu", "budget ms", "events/hour",
+           "samples/event", "mean lat ms", "max lat ms");
+    for (uint16_t mtu : MTUS) {
+        for (uint32_t budget : BUDGETS_MS) {
+            sensorsBegin(SIM_SENSORS, simCoalesce);
+            sensorsReset();
+            coalesceBegin(NULL, budget);
+            coalesceSetMtu(mtu);
+
+            simNow = SIM_START_MS;
+            while (simNow < SIM_START_MS + hours * 3600000ull) {
+                uint32_t sample = sensorsMsUntilDue(simNow), flush = coalesceMsUntilFlush(simNow);
+                simNow += sample < flush ? sample : flush;
+                sensorsRunDue(simNow);
+                coalescePoll(simNow);
+            }
+            coalesceFlush(simNow);
+
+            const CoalesceStats &s = coalesceStats();
+            printf("%5u %10u %12.1f %14.2f %12.0f %12u\n", mtu, budget,
+                   (double)s.packets / hours, (double)s.samples / s.packets,
+                   (double)s.latencySumMs / s.samples, s.latencyMaxMs);
+        }
+    }
+    return 0;
+}
+
+struct PollSimResult {
+    uint32_t polls;
+    uint32_t caught;
+    uint32_t wakes;
+    uint64_t awakeMs;
+};
+
+/**
+ * One node against one gateway trace. The node duty cycles like the firmware (2 s awake,
+ * 2 s asleep, 8 s awake after a connection); when predictive its sleeps are planned by
+ * the gateway model.
+ */
+static PollSimResult simulatePolls(uint32_t periodMs, uint32_t jitterMs, uint32_t hours,
+                                   bool predictive) {
+    const uint32_t AWAKE_MS = 2000, SLEEP_MS = 2000, ACTIVITY_MS = 8000;
+    const uint32_t SKIP_PERCENT = 5;  // polls the gateway skips (busy with other nodes)
+
+    PollSimResult result = {};
+    gatewayReset();
+    srand(periodMs ^ jitterMs);
+
+    const uint64_t end = SIM_START_MS + hours * 3600000ull;
+    const uint64_t phase = SIM_START_MS + rand() % periodMs;
+    uint64_t pollIndex = 0;
+    auto nextPoll = [&]() -> uint64_t {
+        while (true) {
+            uint64_t t = phase + pollIndex++ * periodMs + rand() % (2 * jitterMs + 1) - jitterMs;
+            if ((uint32_t)(rand() % 100) >= SKIP_PERCENT) return t;
+        }
+    };
+
+    uint64_t now = SIM_START_MS, poll = nextPoll();
+    while (now < end) {
+        uint64_t awakeUntil = now + (predictive && gatewayWindowMs() > AWAKE_MS ? gatewayWindowMs() : AWAKE_MS);
+        result.wakes++;
+        for (; poll < now; poll = nextPoll()) result.polls++;
+        for (; poll <= awakeUntil; poll = nextPoll()) {
+            result.polls++;
+            result.caught++;
+            gatewayConnected(poll);
+            if (poll + ACTIVITY_MS > awakeUntil) awakeUntil = poll + ACTIVITY_MS;
+        }
+        result.awakeMs += awakeUntil - now;
+        now = awakeUntil;
+
+        now += predictive ? gatewayMsUntilWake(now, SLEEP_MS) : SLEEP_MS;
+    }
+    return result;
+}
+
+/**
+ * Compares fixed duty cycling against poll prediction over jittered gateway traces.
+ */
+static int commandPollSim(int argc, char **argv) {
+    uint32_t hours = argc > 0 ? atoi(argv[0]) : 24;
+    static const uint32_t PERIODS_MS[] = {30000, 60000, 300000};
+    static const uint32_t JITTERS_MS[] = {0, 250, 1000};
+
+    printf("%9s %9s %-10s %9s %9s %10s\n", "period s", "jitter ms", "strategy", "caught %",
+           "awake %", "wakes/h");
+    for (uint32_t period : PERIODS_MS) {
+        for (uint32_t jitter : JITTERS_MS) {
+            for (int predictive = 0; predictive <= 1; predictive++) {
+                PollSimResult r = simulatePolls(period, jitter, hours, predictive);
+                printf("%9u %9u %-10s %9.1f %9.1f %10.1f\n", period / 1000, jitter,
+                       predictive ? "predict" : "fixed", 100.0 * r.caught / r.polls,
+                       100.0 * r.awakeMs / (hours * 3600000.0), (double)r.wakes / hours);
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * Wall clock error against true time over a run with periodic syncs, corrected for the
+ * estimated drift and not. The first interval is skipped, as drift is only known from
+ * the second sync.
+ */
+static void simulateClock(int32_t rtcPpm, uint32_t syncHours, uint32_t hours, double *corrected,
+                          double *uncorrected) {
+    const int32_t SYNC_JITTER_MS = 20;  // write latency either way
+
+    timeSyncReset();
+    srand(rtcPpm ^ syncHours);
+    *corrected = *uncorrected = 0;
+
+    uint64_t syncWall = 0, syncMono = 0;
+    for (uint64_t ms = 0; ms <= hours * 3600000ull; ms += 60000) {
+        uint64_t truth = SIM_START_MS + ms;
+        uint64_t mono = ms * 1000 + (int64_t)ms * rtcPpm / 1000;
+
+        if (ms % (syncHours * 3600000ull) == 0) {
+            syncWall = truth + rand() % (2 * SYNC_JITTER_MS + 1) - SYNC_JITTER_MS;
+            syncMono = mono;
+            timeSyncSetAt(syncWall, mono);
+            continue;
+        }
+        if (ms < syncHours * 3600000ull) continue;
+        double error = fabs((double)(int64_t)(timeSyncWallMsAt(mono) - truth));
+        double naive = fabs((double)(int64_t)(syncWall + (mono - syncMono) / 1000 - truth));
+        if (error > *corrected) *corrected = error;
+        if (naive > *uncorrected) *uncorrected = naive;
+    }
+}
+
+/**
+ * Worst wall clock error between syncs for a range of RTC errors and sync intervals.
+ */
+static int commandClockSim(int argc, char **argv) {
+    uint32_t hours = argc > 0 ? atoi(argv[0]) : 72;
+    static const int32_t RTC_PPM[] = {-500, 50, 2000};
+    static const uint32_t SYNC_HOURS[] = {1, 6, 24};
+
+    printf("%8s %8s %14s %14s %12s\n", "rtc ppm", "sync h", "max err ms", "no corr ms",
+           "est ppm");
+    for (int32_t ppm : RTC_PPM) {
+        for (uint32_t sync : SYNC_HOURS) {
+            double corrected, uncorrected;
+            simulateClock(ppm, sync, hours, &corrected, &uncorrected);
+            printf("%8d %8u %14.0f %14.0f %12.1f\n", ppm, sync, corrected, uncorrected,
+                   timeSyncDriftPpb() / 1000.0);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Writes a synthetic trace of every sensor as CSV, for benchmarking compression, filters
+ * and send-on-delta against the same data the demo node produces. The "trace" format is
+ * one sample per line (see trace.h), for replay. A summary of each sensor goes to stderr.
+ */
+static int commandWorkload(int argc, char **argv) {
+    uint32_t seed = argc > 0 ? strtoul(argv[0], NULL, 0) : WORKLOAD_SEED_DEFAULT;
+    uint32_t hours = argc > 1 ? atoi(argv[1]) : 24;
+    uint32_t periodMs = argc > 2 ? atoi(argv[2]) * 1000 : 10000;
+    bool trace = argc > 3 && strcmp(argv[3], "trace") == 0;
+    if (!periodMs) periodMs = 1000;
+
+    int16_t lo[SENSOR_COUNT], hi[SENSOR_COUNT], prev[SENSOR_COUNT];
+    uint64_t steps[SENSOR_COUNT] = {}, samples = 0;
+    workloadSetSeed(seed);
+    if (!trace) {
+        printf("time");
+        for (uint8_t i = 0; i < SENSOR_COUNT; i++) printf(",%s", SIM_SENSORS[i].name);
+        printf("\n");
+    }
+    for (uint64_t ms = 0; ms < hours * 3600000ull; ms += periodMs, samples++) {
+        if (!trace) printf("%llu", (unsigned long long)((SIM_START_MS + ms) / 1000));
+        for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+            int16_t v = workloadSample((SensorId)i, SIM_START_MS + ms);
+            if (trace) {
+                char line[TRACE_LINE_MAX];
+                traceFormat({SIM_START_MS + ms, i, v}, line, sizeof(line));
+                puts(line);
+            } else {
+                printf(",%d", v);
+            }
+            if (!samples || v < lo[i]) lo[i] = v;
+            if (!samples || v > hi[i]) hi[i] = v;
+            if (samples) steps[i] += abs(v - prev[i]);
+            prev[i] = v;
+        }
+        if (!trace) printf("\n");
+    }
+
+    fprintf(stderr, "%-12s %8s %8s %14s\n", "sensor", "min", "max", "mean |delta|");
+    for (uint8_t i = 0; samples && i < SENSOR_COUNT; i++) {
+        fprintf(stderr, "%-12s %8d %8d %14.1f\n", SIM_SENSORS[i].name, lo[i], hi[i],
+                samples > 1 ? (double)steps[i] / (samples - 1) : 0.0);
+    }
+    return 0;
+}
+
+/**
+ * Reads a trace file into a growing array. Returns the number of samples, or -1 if the
+ * file cannot be read or is out of time order.
+ */
+static long loadTrace(const char *path, TraceSample **out) {
+    FILE *f = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!f) return -1;
+
+    TraceSample *samples = NULL;
+    size_t count = 0, capacity = 0;
+    char line[128];
+    bool ordered = true;
+    while (fgets(line, sizeof(line), f)) {
+        TraceSample s;
+        if (!traceParse(line, &s)) continue;
+        if (count && s.ms < samples[count - 1].ms) ordered = false;
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            samples = (TraceSample *)realloc(samples, capacity * sizeof(TraceSample));
+        }
+        samples[count++] = s;
+    }
+    if (f != stdin) fclose(f);
+    if (!ordered) {
+        free(samples);
+        return -1;
+    }
+    *out = samples;
+    return count;
+}
+
+static uint16_t replayDigest = 0xFFFF;
+
+static void replayFlush(const uint8_t *packet, size_t len) {
+    replayDigest = crc16(packet, len, replayDigest);
+}
+
+/**
+ * Feeds a recorded trace through the sensor interface at its recorded times, and on
+ * through history and notification coalescing. A speed of 0 runs as fast as possible,
+ * 1 in real time. The digest covers every notification and the final history, so two
+ * builds that process a trace identically report the same digest.
+ */
+static int commandReplay(int argc, char **argv) {
+    if (argc < 1) {
+        fprintf(stderr, "usage: replay <trace.csv|-> [speed]\n");
+        return 2;
+    }
+    double speed = argc > 1 ? atof(argv[1]) : 0;
+    TraceSample *samples = NULL;
+    long count = loadTrace(argv[0], &samples);
+    if (count <= 0) {
+        fprintf(stderr, "replay: no samples in time order in %s\n", argv[0]);
+        return 1;
+    }
+
+    static const SensorRead READS[SENSOR_COUNT] = {
+        traceReplayRead<SENSOR_TEMPERATURE>, traceReplayRead<SENSOR_HUMIDITY>,
+        traceReplayRead<SENSOR_PRESSURE>, traceReplayRead<SENSOR_BATTERY>};
+    SensorSpec specs[SENSOR_COUNT];
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        specs[i] = SIM_SENSORS[i];
+        specs[i].read = READS[i];
+    }
+    sensorsBegin(specs, simCoalesce);
+    sensorsReset();
+    historyReset();
+    coalesceBegin(replayFlush);
+    coalesceSetMtu(185);
+    traceReplayBegin(samples, count);
+
+    const uint64_t first = samples[0].ms, startUs = timeSyncMonotonicUs();
+    size_t done = 0;
+    simNow = first;
+    for (uint64_t next; (next = traceReplayNextMs()) != UINT64_MAX;) {
+        // Batches falling due before the sample are sent first.
+        for (uint32_t flush; (flush = coalesceMsUntilFlush(simNow)) != UINT32_MAX &&
+                             flush <= next - simNow;) {
+            simNow += flush;
+            coalescePoll(simNow);
+        }
+        simNow = next;
+        if (speed > 0) {
+            uint64_t dueUs = startUs + (uint64_t)((next - first) * 1000 / speed);
+            uint64_t nowUs = timeSyncMonotonicUs();
+            if (dueUs > nowUs) usleep(dueUs - nowUs);
+        }
+
+        size_t n = traceReplayAdvance(next);
+        for (size_t i = done; i < done + n; i++) sensorSampleNow((SensorId)samples[i].sensor, next);
+        done += n;
+    }
+    coalesceFlush(simNow);
+    double elapsed = (timeSyncMonotonicUs() - startUs) / 1e6;
+
+    HistoryRecord r;
+    for (uint8_t c = 0; c < SENSOR_COUNT; c++) {
+        for (uint16_t i = 0; historyGet(i, &r, c); i++) {
+            replayDigest = crc16((const uint8_t *)&r, sizeof(r), replayDigest);
+        }
+    }
+
+    const CoalesceStats &s = coalesceStats();
+    printf("samples      %ld over %.1f h\n", count, (samples[count - 1].ms - first) / 3600000.0);
+    printf("history      %u %u %u %u\n", historyCount(0), historyCount(1), historyCount(2),
+           historyCount(3));
+    printf("notify       %u packets, mean latency %.0f ms\n", s.packets,
+           s.samples ? (double)s.latencySumMs / s.samples : 0.0);
+    printf("elapsed      %.3f s, %.0f samples/s\n", elapsed, elapsed > 0 ? count / elapsed : 0.0);
+    printf("digest       %04x\n", replayDigest);
+    free(samples);
+    return 0;
+}
+
+/**
+ * Cycle counter for benchmarks: the TSC where there is one, otherwise nanoseconds.
+ */
+static uint32_t hostCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return (uint32_t)__builtin_ia32_rdtsc();
+#else
+    return (uint32_t)(timeSyncMonotonicUs() * 1000);
+#endif
+}
+
+/**
+ * Cycles per corrected sample, fixed point piecewise linear against cubic polynomials.
+ * Host figures only rank the methods; run "bench calib" on the node for ESP32 cycles,
+ * where double has no hardware support and float only single precision.
+ */
+static int commandBenchCalib(int argc, char **argv) {
+    uint32_t samples = argc > 0 ? atoi(argv[0]) : 1000000;
+    CalibrationBench b;
+    calibrationBenchmark(hostCycles, samples, &b);
+    printf("%-28s %8u cycles/sample\n", "piecewise linear, Q16", b.fixedCycles);
+    printf("%-28s %8u cycles/sample\n", "cubic polynomial, float", b.floatCycles);
+    printf("%-28s %8u cycles/sample\n", "cubic polynomial, double", b.doubleCycles);
+    return 0;
+}
+
+static uint64_t wheelNow;
+static uint64_t wheelLast;
+static uint32_t wheelFired, wheelLate, wheelOutOfOrder;
+
+static void onWheelTimer(void *arg) {
+    WheelTimer *t = (WheelTimer *)arg;
+    wheelFired++;
+    if (wheelNow != t->expiresMs) wheelLate++;
+    if (t->expiresMs < wheelLast) wheelOutOfOrder++;
+    wheelLast = t->expiresMs;
+}
+
+/**
+ * Cycles per arm and cancel of n timers with delays from 1 ms to 10 days, against a
+ * sorted list, then every timer run to expiry jumping from one expiry to the next, as the
+ * node does across sleeps. Checks each fires exactly on time and in order.
+ */
+static int commandBenchWheel(int argc, char **argv) {
+    uint32_t n = argc > 0 ? atoi(argv[0]) : 10000;
+    WheelTimer *timers = (WheelTimer *)calloc(n, sizeof(WheelTimer));
+    uint64_t *delays = (uint64_t *)malloc(n * sizeof(uint64_t));
+    uint64_t *sorted = (uint64_t *)malloc(n * sizeof(uint64_t));
+    srand(1);
+    for (uint32_t i = 0; i < n; i++) {
+        // Log-uniform, so every level of the wheel is used.
+        delays[i] = 1 + (uint64_t)exp(log(864000000.0) * rand() / RAND_MAX);
+        timerWheelInit(&timers[i], onWheelTimer, &timers[i]);
+    }
+
+    wheelNow = SIM_START_MS;
+    timerWheelBegin(wheelNow);
+    uint32_t start = hostCycles();
+    for (uint32_t i = 0; i < n; i++) timerWheelArm(&timers[i], wheelNow + delays[i]);
+    uint32_t armCycles = hostCycles() - start;
+    start = hostCycles();
+    for (uint32_t i = 0; i < n; i += 2) timerWheelCancel(&timers[i]);
+    uint32_t cancelCycles = hostCycles() - start;
+
+    // The same deadlines inserted into a sorted array, the linear alternative.
+    start = hostCycles();
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t at = i;
+        while (at > 0 && sorted[at - 1] > delays[i]) {
+            sorted[at] = sorted[at - 1];
+            at--;
+        }
+        sorted[at] = delays[i];
+    }
+    uint32_t sortedCycles = hostCycles() - start;
+
+    uint32_t jumps = 0;
+    wheelFired = wheelLate = wheelOutOfOrder = 0;
+    wheelLast = 0;
+    start = hostCycles();
+    for (uint32_t ms; (ms = timerWheelMsUntilNext(wheelNow)) != UINT32_MAX; jumps++) {
+        wheelNow += ms;
+        timerWheelRun(wheelNow);
+    }
+    uint32_t runCycles = hostCycles() - start;
+
+    printf("%-26s %10.1f cycles\n", "arm", (double)armCycles / n);
+    printf("%-26s %10.1f cycles\n", "cancel", (double)cancelCycles / ((n + 1) / 2));
+    printf("%-26s %10.1f cycles\n", "sorted insert", (double)sortedCycles / n);
+    printf("%-26s %10.1f cycles\n", "next + run, per expiry", (double)runCycles / jumps);
+    printf("fired %u of %u, %u late, %u out of order, over %.1f days\n", wheelFired, n / 2,
+           wheelLate, wheelOutOfOrder, (wheelNow - SIM_START_MS) / 86400000.0);
+    free(timers);
+    free(delays);
+    free(sorted);
+    return wheelLate || wheelOutOfOrder || wheelFired != n / 2;
+}
+
+/**
+ * Temperature to raw ADC reading, the NTC table inverted.
+ */
+static constexpr CalibrationPoint NTC_INVERSE_POINTS[] = {
+    {-1000, 3495}, {0, 3156}, {1000, 2738}, {2000, 2278},
+    {3000, 1825}, {4000, 1419}, {5000, 1081}, {6000, 815},
+};
+static constexpr CalibrationTable NTC_INVERSE = calibrationTable(NTC_INVERSE_POINTS);
+
+/**
+ * Runs the ULP program's emulation over the synthetic temperature, read through the NTC
+ * table, for a sweep of wake thresholds. Reports main core wakes against one per sample,
+ * how long samples wait in the buffer, and the error of the drained temperatures.
+ */
+static int commandUlpSim(int argc, char **argv) {
+    uint32_t hours = argc > 0 ? atoi(argv[0]) : 24;
+    const uint32_t periodMs = SIM_SENSORS[SENSOR_TEMPERATURE].periodMs;
+    static const uint16_t THRESHOLDS[] = {ULP_THRESHOLD_OFF, 80, 40, 20, 10};
+
+    printf("%10s %10s %10s %10s %12s %12s %10s\n", "threshold", "wakes/day", "on change",
+           "reduction", "mean wait s", "max wait s", "max err");
+    printf("%10s %10.0f %10s %10s %12.1f %12.1f %10s  (wake per sample)\n", "-",
+           86400000.0 / periodMs, "", "1x", 0.0, 0.0, "");
+    for (uint16_t threshold : THRESHOLDS) {
+        const uint64_t end = SIM_START_MS + hours * 3600000ull;
+        uint16_t raw = calibrationApply(NTC_INVERSE, workloadSample(SENSOR_TEMPERATURE, SIM_START_MS));
+        ulpSamplerReset(threshold, raw);
+
+        uint32_t samples = 0, wakes = 0, onChange = 0, maxErr = 0;
+        uint64_t waitSum = 0, waitMax = 0;
+        int16_t truth[ULP_BUFFER];
+        uint16_t drained[ULP_BUFFER];
+        for (uint64_t ms = SIM_START_MS; ms < end; ms += periodMs, samples++) {
+            int16_t value = workloadSample(SENSOR_TEMPERATURE, ms);
+            uint16_t buffered = ulpSamplerMemory()[ULP_VAR_COUNT];
+            truth[buffered] = value;
+            bool full = buffered + 1 == ULP_BUFFER;
+            if (!ulpSamplerEmulate(calibrationApply(NTC_INVERSE, value))) continue;
+
+            wakes++;
+            if (!full) onChange++;
+            uint8_t n = ulpSamplerDrain(drained);
+            for (uint8_t i = 0; i < n; i++) {
+                uint32_t err = abs(calibrationApply(ULP_NTC_TABLE, drained[i]) - truth[i]);
+                if (err > maxErr) maxErr = err;
+                uint64_t wait = (uint64_t)(n - 1 - i) * periodMs;
+                waitSum += wait;
+                if (wait > waitMax) waitMax = wait;
+            }
+        }
+
+        char name[12];
+        snprintf(name, sizeof(name), threshold == ULP_THRESHOLD_OFF ? "off" : "%u", threshold);
+        printf("%10s %10.0f %10.0f %9.0fx %12.1f %12.1f %10u\n", name, wakes * 24.0 / hours,
+               onChange * 24.0 / hours, wakes ? (double)samples / wakes : 0.0,
+               samples ? waitSum / 1000.0 / samples : 0.0, waitMax / 1000.0, maxErr);
+    }
+    return 0;
+}
+
+/**
+ * A day of settings and counters against the fake NVS: a wake counter bumped every duty
+ * cycle (2 s awake, 2 s asleep), a calibration session of four sensors in the first hour
+ * and a seed set every 6 hours. Flash wear assumes a small blob is 3 NVS entries of 32
+ * bytes, 126 to a 4 KB page, spread over the 5 pages of the nvs partition with 100k
+ * erase cycles each.
+ */
+static int commandPersistSim(int argc, char **argv) {
+    uint32_t hours = argc > 0 ? atoi(argv[0]) : 24;
+    static const uint32_t DIRTY_MS[] = {0, 60000, PERSIST_DIRTY_MS, 3600000};
+    const uint32_t CYCLE_MS = 4000;
+
+    printf("%10s %10s %12s %12s %14s %12s\n", "dirty s", "puts/day", "commits/day",
+           "writes/day", "erases/day", "wear years");
+    for (uint32_t dirtyMs : DIRTY_MS) {
+        persistReset();
+        persistBegin(dirtyMs);
+        uint32_t wakes = 0;
+        for (uint64_t ms = 0; ms < hours * 3600000ull; ms += CYCLE_MS) {
+            persistGet("wakes", &wakes, sizeof(wakes));
+            wakes++;
+            persistPut("wakes", &wakes, sizeof(wakes), ms);
+            if (ms / CYCLE_MS == 600) {
+                for (uint8_t i = 0; i < 4; i++) {
+                    CalibrationPoint points[] = {{0, (int16_t)(10 * i)}, {1000, 1000}};
+                    char key[] = "pts0";
+                    key[3] += i;
+                    persistPut(key, points, sizeof(points), ms);
+                }
+            }
+            if (ms % (6 * 3600000ull) == 0) {
+                uint32_t seed = ms / 3600000;
+                persistPut("seed", &seed, sizeof(seed), ms);
+            }
+            persistPoll(ms + CYCLE_MS / 2);  // before sleeping
+        }
+        persistFlush();
+
+        const PersistStats &st = persistStats();
+        double perDay = 24.0 / hours, erases = st.writes * 3 * perDay / 126;
+        printf("%10u %10.0f %12.0f %12.0f %14.2f %12.0f\n", dirtyMs / 1000, st.puts * perDay,
+               st.commits * perDay, st.writes * perDay, erases,
+               erases > 0 ? 100000.0 * 5 / erases / 365 : 0.0);
+    }
+    return 0;
+}
+
+struct CrashSimResult {
+    uint32_t boots;      // while the fault lasted
+    double faultMah;     // charge drawn while the fault lasted
+    uint64_t recoverMs;  // from the fault clearing to the next full window
+};
+
+/**
+ * A node whose radio start browns out (a weak battery, say) for faultMs, then recovers.
+ * Rough M5Stack Core figures: a full window is 2 s at 100 mA and a brown-out comes 1.2 s
+ * into one at 120 mA; a degraded boot is 0.4 s at 50 mA; deep sleep draws 1 mA.
+ */
+static CrashSimResult simulateCrashes(uint64_t faultMs, uint64_t endMs, bool recovery) {
+    const double SLEEP_MA = 1, WINDOW_MA = 100, CRASH_MA = 120, DEGRADED_MA = 50;
+    const uint32_t WINDOW_MS = 2000, CRASH_MS = 1200, DEGRADED_MS = 400, SLEEP_MS = 2000;
+
+    CrashSimResult result = {};
+    double mAms = 0;
+    RecoveryReset reason = RECOVERY_RESET_POWER_ON;
+    for (uint64_t ms = 0; ms < endMs;) {
+        bool fault = ms < faultMs;
+        if (ms >= faultMs && !result.recoverMs && faultMs) result.recoverMs = 1;
+        if (fault) result.boots++;
+
+        uint32_t awakeMs, sleepMs;
+        double mA;
+        if (recoveryBegin(reason) == RECOVERY_DEGRADED && recovery) {
+            awakeMs = DEGRADED_MS;
+            mA = DEGRADED_MA;
+            sleepMs = recoveryBackoffMs();
+            recoverySleep();
+            reason = RECOVERY_RESET_DEEP_SLEEP;
+        } else if (fault) {
+            recoveryPhase(RECOVERY_PHASE_RADIO);
+            awakeMs = CRASH_MS;
+            mA = CRASH_MA;
+            sleepMs = 0;
+            reason = RECOVERY_RESET_BROWNOUT;
+        } else {
+            awakeMs = WINDOW_MS;
+            mA = WINDOW_MA;
+            sleepMs = SLEEP_MS;
+            recoverySleep();
+            reason = RECOVERY_RESET_DEEP_SLEEP;
+            if (result.recoverMs == 1) result.recoverMs = ms - faultMs + 1;
+        }
+        if (fault) mAms += awakeMs * mA + sleepMs * SLEEP_MA;
+        ms += awakeMs + sleepMs;
+    }
+    result.faultMah = mAms / 3600000.0;
+    if (result.recoverMs) result.recoverMs--;
+    return result;
+}
+
+/**
+ * Charge spent in a brown-out loop, and how soon the node is back once it ends, with and
+ * without the degraded path and its backoff.
+ */
+static int commandCrashSim(int argc, char **argv) {
+    static const double FAULT_HOURS[] = {0.1, 1, 8, 24};
+    double only = argc > 0 ? atof(argv[0]) : 0;
+
+    printf("%8s %-12s %10s %12s %12s\n", "fault h", "recovery", "boots", "fault mAh",
+           "back after s");
+    for (double hours : FAULT_HOURS) {
+        if (only > 0) hours = only;
+        uint64_t faultMs = hours * 3600000;
+        for (int recovery = 0; recovery <= 1; recovery++) {
+            recoveryBegin(RECOVERY_RESET_POWER_ON);
+            CrashSimResult r = simulateCrashes(faultMs, faultMs + 2 * RECOVERY_BACKOFF_MAX_MS,
+                                               recovery);
+            printf("%8.1f %-12s %10u %12.1f %12.0f\n", hours, recovery ? "backoff" : "none",
+                   r.boots, r.faultMah, r.recoverMs / 1000.0);
+        }
+        if (only > 0) break;
+    }
+    return 0;
+}
+
+/**
+ * One awake window as the firmware runs it: boot, then BLE init, then advertising with
+ * the loop mostly blocked, optionally a connection at its end; the LCD stays asleep.
+ * Without an awake time there is no radio, only a short run. Returns the next wake.
+ */
+static uint64_t energyWindow(uint64_t now, uint32_t awakeMs, uint32_t connectedMs,
+                             uint32_t sleepMs) {
+    const uint32_t BOOT_MS = 300, INIT_MS = 500, SAMPLE_MS = 50, RUN_MS = 5, TICK_MS = 100;
+
+    energyWake(now += BOOT_MS, BOOT_MS);
+    if (!awakeMs) {
+        energySleep(now += SAMPLE_MS);
+        return now + sleepMs;
+    }
+    energyEnter(ENERGY_RADIO_INIT, now);
+    energyEnter(ENERGY_RADIO_ADVERTISING, now += INIT_MS);
+    for (uint32_t at = 0; at < awakeMs; at += TICK_MS) {
+        if (at == awakeMs - connectedMs) energyEnter(ENERGY_RADIO_CONNECTED, now);
+        energyEnter(ENERGY_CPU_RUN, now);
+        energyEnter(ENERGY_CPU_IDLE, now += RUN_MS);
+        now += TICK_MS - RUN_MS;
+    }
+    energySleep(now);
+    return now + sleepMs;
+}
+
+/**
+ * mAh per day of each power state in a few operating modes, with the default current
+ * table. Connected windows are the gateway's, one a minute for a second.
+ */
+static int commandEnergySim(int argc, char **argv) {
+    uint32_t hours = argc > 0 ? atoi(argv[0]) : 24;
+    const uint64_t end = SIM_START_MS + hours * 3600000ull;
+    static const char *MODES[] = {"always on", "duty 2s/2s", "+ gateway", "sensors only"};
+    const uint8_t MODE_COUNT = sizeof(MODES) / sizeof(MODES[0]);
+    double mAh[MODE_COUNT][ENERGY_STATES + ENERGY_COMPONENTS + 1];
+
+    for (uint8_t mode = 0; mode < MODE_COUNT; mode++) {
+        energyBegin(SIM_START_MS);
+        energyReset(SIM_START_MS);
+        uint64_t now = SIM_START_MS;
+        if (mode == 0) {
+            // Never sleeps: the panel is lit by a press once an hour and steps down.
+            energyWake(now, 0);
+            energyEnter(ENERGY_RADIO_ADVERTISING, now);
+            while (now < end) {
+                uint32_t sincePress = (now - SIM_START_MS) % 3600000;
+                if (sincePress == 0) energyEnter(ENERGY_LCD_ACTIVE, now);
+                if (sincePress == DISPLAY_ACTIVE_MS) energyEnter(ENERGY_LCD_DIM, now);
+                if (sincePress == DISPLAY_ACTIVE_MS + DISPLAY_DIM_MS) energyEnter(ENERGY_LCD_OFF, now);
+                if (sincePress == DISPLAY_ACTIVE_MS + DISPLAY_DIM_MS + DISPLAY_OFF_MS) {
+                    energyEnter(ENERGY_LCD_SLEEP, now);
+                }
+                energyEnter(ENERGY_CPU_RUN, now);
+                energyEnter(ENERGY_CPU_IDLE, now += 5);
+                now += 95;
+            }
+        }
+        for (uint64_t cycle = 0; mode > 0 && now < end; cycle++) {
+            if (mode == 3) {
+                now = energyWindow(now, 0, 0, 10000);  // no radio, a wake per sample
+            } else {
+                bool poll = mode == 2 && cycle % 15 == 0;
+                now = energyWindow(now, 2000, poll ? 1000 : 0, 2000);
+            }
+        }
+
+        for (uint8_t s = 0; s < ENERGY_STATES; s++) {
+            mAh[mode][s] = energyTotals((EnergyState)s, now).chargeMa10Ms * 2.4 / (now - SIM_START_MS);
+        }
+        for (uint8_t c = 0; c <= ENERGY_COMPONENTS; c++) {
+            mAh[mode][ENERGY_STATES + c] = energyMicroAhPerDay((EnergyComponent)c, now) / 1000.0;
+        }
+    }
+
+    printf("%-18s", "mAh/day");
+    for (const char *m : MODES) printf(" %12s", m);
+    printf("\n");
+    static const char *TOTALS[] = {"= cpu", "= radio", "= lcd", "= total"};
+    for (uint8_t row = 0; row < ENERGY_STATES + ENERGY_COMPONENTS + 1; row++) {
+        printf("%-18s", row < ENERGY_STATES ? energyStateName((EnergyState)row)
+                                            : TOTALS[row - ENERGY_STATES]);
+        for (uint8_t mode = 0; mode < MODE_COUNT; mode++) printf(" %12.1f", mAh[mode][row]);
+        printf("\n");
+    }
+    return 0;
+}
+
+/**
+ * One timer wake as the boot instrumentation sees it: the sleep, then wakeMs at the
+ * currents of the path taken, folded into the mode's cost.
+ */
+static uint64_t sleepWake(uint64_t now, SleepMode mode, uint32_t sleepMs, uint32_t bootMs,
+                          uint32_t initMs) {
+    energySleep(now);
+    if (mode == SLEEP_MODE_LIGHT) energyEnter(ENERGY_CPU_LIGHT_SLEEP, now);
+    sleepModeStart(mode, now, sleepMs, energyChargeMa10Ms(now));
+    now += sleepMs + bootMs;
+    energyWake(now, mode == SLEEP_MODE_LIGHT ? 0 : bootMs);
+    if (mode != SLEEP_MODE_STUB) energyEnter(ENERGY_RADIO_INIT, now);
+    now += initMs;
+    if (mode != SLEEP_MODE_STUB) energyEnter(ENERGY_RADIO_ADVERTISING, now);
+    sleepModeWoke(now, energyChargeMa10Ms(now), true);
+    return now;
+}
+
+static void printBreakEvens(const char *label) {
+    printf("%-22s light %8u ms   stub %8u ms   deep %8u ms\n", label,
+           sleepModeBreakEvenMs(SLEEP_MODE_LIGHT, SLEEP_MODE_AWAKE),
+           sleepModeBreakEvenMs(SLEEP_MODE_STUB, SLEEP_MODE_LIGHT),
+           sleepModeBreakEvenMs(SLEEP_MODE_DEEP, SLEEP_MODE_LIGHT));
+}
+
+static int commandSleepSim(int argc, char **argv) {
+    uint32_t bootMs = argc > 0 ? atoi(argv[0]) : 450;
+    static const char *NAMES[SLEEP_MODES] = {"awake", "light", "stub", "deep"};
+
+    energyBegin(SIM_START_MS);
+    energyReset(SIM_START_MS);
+    sleepModeReset();
+    sleepModeBegin();
+    printBreakEvens("estimated:");
+
+    // The boots measured here are slower than the estimates, and light sleep pays for the
+    // BLE controller restart.
+    uint64_t now = SIM_START_MS;
+    for (uint8_t i = 0; i < 8; i++) {
+        now = sleepWake(now, SLEEP_MODE_LIGHT, 2000, 0, 30);
+        now = sleepWake(now, SLEEP_MODE_STUB, 10000, bootMs, 60);
+        now = sleepWake(now, SLEEP_MODE_DEEP, 60000, bootMs, 600);
+    }
+    printBreakEvens("measured:");
+    for (uint8_t m = SLEEP_MODE_LIGHT; m < SLEEP_MODES; m++) {
+        const SleepModeCost &c = sleepModeCost((SleepMode)m);
+        printf("  %-6s wake %5u ms %8.2f uAh, floor %5.1f mA\n", NAMES[m], c.wakeMs,
+               c.wakeChargeMa10Ms / 36000.0, c.floorMa10 / 10.0);
+    }
+
+    // mAh per day were every gap this long, the choice for a wake for the radio and for
+    // samples alone.
+    static const uint32_t GAPS[] = {10, 50, 200, 1000, 2000, 10000, 30000, 60000, 300000, 3600000};
+    const uint8_t ALL = sleepModeBit(SLEEP_MODE_LIGHT) | sleepModeBit(SLEEP_MODE_STUB) |
+                        sleepModeBit(SLEEP_MODE_DEEP);
+    printf("\n%10s", "gap ms");
+    for (const char *n : NAMES) printf(" %9s", n);
+    printf(" %7s %7s %9s\n", "radio", "samples", "vs deep");
+    for (uint32_t gap : GAPS) {
+        printf("%10u", gap);
+        for (uint8_t m = 0; m < SLEEP_MODES; m++) {
+            uint64_t charge = sleepModeChargeMa10Ms((SleepMode)m, gap);
+            if (charge == UINT64_MAX) {
+                printf(" %9s", "-");
+            } else {
+                printf(" %9.1f", charge * 2.4 / gap);
+            }
+        }
+        SleepMode radio = sleepModeSelect(gap, ALL & ~sleepModeBit(SLEEP_MODE_STUB));
+        SleepMode samples = sleepModeSelect(gap, ALL);
+        uint64_t deep = sleepModeChargeMa10Ms(SLEEP_MODE_DEEP, gap);
+        printf(" %7s %7s", NAMES[radio], NAMES[samples]);
+        if (deep == UINT64_MAX) {
+            printf(" %9s\n", "-");
+        } else {
+            printf(" %8.0f%%\n", 100.0 * sleepModeChargeMa10Ms(radio, gap) / deep);
+        }
+    }
+    return 0;
+}
+
+/**
+ * The awake window after the radio is up: the loop runs 5 ms in every 100 and is blocked
+ * otherwise, idling or dozing, while the radio advertises and then holds a connection.
+ * Returns the charge drawn.
+ */
+static uint64_t dozeWindow(uint64_t &now, uint32_t windowMs, uint32_t connectedMs, bool doze) {
+    uint64_t before = energyChargeMa10Ms(now);
+    energyEnter(ENERGY_RADIO_ADVERTISING, now);
+    for (uint32_t at = 0; at < windowMs; at += 100) {
+        if (at == windowMs - connectedMs) energyEnter(ENERGY_RADIO_CONNECTED, now);
+        energyEnter(ENERGY_CPU_RUN, now);
+        energyEnter(doze ? ENERGY_CPU_DOZE : ENERGY_CPU_IDLE, now += 5);
+        now += 95;
+    }
+    return energyChargeMa10Ms(now) - before;
+}
+
+static int commandDozeSim(int argc, char **argv) {
+    uint32_t windowMs = argc > 0 ? atoi(argv[0]) : 2000;
+    const uint32_t activityMs = 8000, cycleSleepMs = 2000;
+    static const char *ROWS[] = {"advertising", "+ 1 s connection", "activity timeout"};
+
+    printf("%-18s %12s %12s %8s\n", "uAh per window", "idle", "doze", "saved");
+    for (uint8_t row = 0; row < 3; row++) {
+        double uAh[2];
+        for (uint8_t doze = 0; doze < 2; doze++) {
+            energyBegin(SIM_START_MS);
+            energyReset(SIM_START_MS);
+            uint64_t now = SIM_START_MS;
+            energyWake(now, 0);
+            uint32_t ms = row == 2 ? activityMs : windowMs;
+            uAh[doze] = dozeWindow(now, ms, row == 1 ? 1000 : 0, doze) / 36000.0;
+        }
+        printf("%-18s %12.2f %12.2f %7.0f%%\n", ROWS[row], uAh[0], uAh[1],
+               100.0 * (uAh[0] - uAh[1]) / uAh[0]);
+    }
+
+    // A duty cycle of the window and a light sleep, and where light sleep starts to pay.
+    sleepModeReset();
+    printf("\n%-18s %12s %12s\n", "", "idle", "doze");
+    double mAh[2];
+    uint32_t breakEven[2];
+    for (uint8_t doze = 0; doze < 2; doze++) {
+        energyBegin(SIM_START_MS);
+        energyReset(SIM_START_MS);
+        sleepModeBegin();
+        sleepModeSetDoze(doze);
+        uint64_t now = SIM_START_MS, charge = 0;
+        energyWake(now, 0);
+        charge += dozeWindow(now, windowMs, 0, doze);
+        charge += sleepModeChargeMa10Ms(SLEEP_MODE_LIGHT, cycleSleepMs);
+        mAh[doze] = charge * 2.4 / (windowMs + cycleSleepMs);
+        breakEven[doze] = sleepModeBreakEvenMs(SLEEP_MODE_LIGHT, SLEEP_MODE_AWAKE);
+    }
+    printf("%-18s %12.1f %12.1f\n", "duty mAh/day", mAh[0], mAh[1]);
+    printf("%-18s %12u %12u\n", "light sleep be ms", breakEven[0], breakEven[1]);
+    return 0;
+}
+
+static int ptyMaster = -1;
+static bool ptyQuit = false;
+
+static void ptyWrite(const uint8_t *data, size_t len) {
+    while (len) {
+        ssize_t n = write(ptyMaster, data, len);
+        if (n <= 0) return;
+        data += n;
+        len -= n;
+    }
+}
+
+static void ptyLine(const char *line) {
+    fprintf(stderr, "serve-pty: line \"%s\"\n", line);
+    if (strcmp(line, "quit") == 0) ptyQuit = true;
+}
+
+/**
+ * Emulates a node's serial console on a pseudo terminal, so host tools can be run
+ * against the real protocol code. Prints the pty path, then serves until "quit".
+ */
+static int commandServePty(int argc, char **argv) {
+    uint16_t records = argc > 0 ? atoi(argv[0]) : HISTORY_CAPACITY;
+
+    historyReset();
+    for (uint16_t i = 0; i < records; i++) {
+        historyAppend(1600000000 + i * 60, 1800 + (int16_t)((i * 37) % 500) - 250);
+    }
+    diagSet("sim.records", records);
+
+    ptyMaster = posix_openpt(O_RDWR | O_NOCTTY);
+    if (ptyMaster < 0 || grantpt(ptyMaster) || unlockpt(ptyMaster)) {
+        perror("serve-pty");
+        return 1;
+    }
+
+    // Hold the slave open in raw mode so the line discipline passes bytes through and the
+    // master does not see EOF between host tool runs.
+    const char *path = ptsname(ptyMaster);
+    int slave = open(path, O_RDWR | O_NOCTTY);
+    struct termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+
+    printf("%s\n", path);
+    fflush(stdout);
+
+    protocolBegin(ptyWrite, ptyLine);
+    uint8_t buf[256];
+    while (!ptyQuit) {
+        ssize_t n = read(ptyMaster, buf, sizeof(buf));
+        if (n <= 0) break;
+        protocolFeed(buf, n);
+    }
+
+    close(slave);
+    close(ptyMaster);
+    return 0;
+}
+
+struct Command {
+    const char *name;
+    int (*run)(int argc, char **argv);
+    const char *help;
+};
+
+static const Command COMMANDS[] = {
+    {"snapshot", commandSnapshot, "<out.ppm> [golden.ppm]  render the dashboard scene"},
+    {"bench-render", commandBenchRender, "[updates]  dashboard SPI and render cost"},
+    {"sched-sim", commandSchedSim, "[hours]  sensor wakes with and without grouping"},
+    {"coalesce-sweep", commandCoalesceSweep, "[hours]  notifications and latency per budget"},
+    {"poll-sim", commandPollSim, "[hours]  gateway polls caught, fixed vs predicted wakes"},
+    {"clock-sim", commandClockSim, "[hours]  wall clock error between syncs, drift corrected"},
+    {"workload", commandWorkload, "[seed] [hours] [period s] [csv|trace]  synthetic sensor trace"},
+    {"replay", commandReplay, "<trace.csv|-> [speed]  feed a recorded trace through the pipeline"},
+    {"bench-calib", commandBenchCalib, "[samples]  calibration cycles, fixed point vs polynomial"},
+    {"bench-wheel", commandBenchWheel, "[timers]  timer wheel arm, cancel and run cycles"},
+    {"energy-sim", commandEnergySim, "[hours]  mAh/day per power state and operating mode"},
+    {"sleep-sim", commandSleepSim, "[boot ms]  sleep mode break-even points and choice per gap"},
+    {"doze-sim", commandDozeSim, "[window ms]  awake window charge, idle vs modem sleep doze"},
+    {"crash-sim", commandCrashSim, "[fault hours]  brown-out loop charge, with and without backoff"},
+    {"persist-sim", commandPersistSim, "[hours]  NVS commits and wear per commit policy"},
+    {"ulp-sim", commandUlpSim, "[hours]  main core wakes with the ULP buffering samples"},
+    {"serve-pty", commandServePty, "[records]  serial console on a pty for host tools"},
+};
+
+int main(int argc, char **argv) {
+    if (argc >= 2) {
+        for (const Command &c : COMMANDS) {
+            if (strcmp(argv[1], c.name) == 0) return c.run(argc - 2, argv + 2);
+        }
+    }
+
+    fprintf(stderr, "usage: %s <command> [args]\n", argv[0]);
+    for (const Command &c : COMMANDS) fprintf(stderr, "  %-14s %s\n", c.name, c.help);
+    return 2;
+}
@@ -14,23 +14,48 @@
 #include <BLEUtils.h>
 #include <M5Stack.h>
 
+#include "buttons.h"
+#include "calibration.h"
+#include "coalesce.h"
+#include "console.h"
+#include "critical.h"
+#include "dashboard.h"
 #include "debug.h"
+#include "delivery.h"
+#include "diagnostics.h"
+#include "display.h"
+#include "energy.h"
+#include "gateway.h"
+#include "gatt.h"
+#include "history.h"
+#include "hotpath.h"
+#include "persist.h"
+#include "protocol.h"
+#include "recovery.h"
+#include "sensors.h"
+#include "sleepmode.h"
+#include "stream.h"
+#include "timerwheel.h"
+#include "timesync.h"
+#include "trace.h"
+#include "ulpsampler.h"
+#include "workload.h"
 
 /**
  * BLE Related stuff
  * 
  * <https://btprodspecificationrefs.blob.core.windows.net/assigned-values/16-bit%20UUID%20Numbers%20Document.pdf>
  */
-static BLEUUID serviceUUID = BLEUUID("224c9411-d6cb-4b2e-b4cb-ab687eb7de23");
-static BLEUUID tempCharacteristicUUID = ((uint16_t)0x2A6E);
-
-BLEDescriptor tempDescriptor(BLEUUID((uint16_t)0x2901));
-BLECharacteristic tempCharacteristic(tempCharacteristicUUID, BLECharacteristic::PROPERTY_READ);
+static const char *DEVICE_NAME = "m5-temperature-1";
+static const char *SERVICE_UUID = "224c9411-d6cb-4b2e-b4cb-ab687eb7de23";
+static const char *CTS_UUID = "1805";  // Current Time Service
 
 BLEServer *pServer = NULL;
 BLEService *pService = NULL;
 
 bool deviceConnected = false;
+bool doze = false;  // light sleeping between radio events, see sleepmode.h
+bool lightSleepOk = false;  // the controller can stay up through a light sleep
 
 /**
  * Duty Cycling Timeouts
@@ -38,20 +63,35 @@ bool deviceConnected = false;
 const int DUTY_CYCLE_AWAKE = 2;  // seconds awake
 const int DUTY_CYCLE_SLEEP = 2;  // seconds asleep
 const int ACTIVITY_TIMEOUT = 8;  // seconds after BLE activity
+const uint32_t AWAKE_POLL_MS = 1000;  // longest loop wait with duty cycling off
+
+/**
+ * Button timings.
+ */
+const uint32_t STREAM_HOLD_MS = 1500;  // BtnB held this long toggles UART streaming
+
+/**
+ * Staged settings and counters are committed below this battery level (the power IC
+ * reports quarters), while there is still charge to do it.
+ */
+const int16_t BATTERY_LOW_PERCENT = 25;
+
+/**
+ * Deadlines, on the timer wheel (see timerwheel.h) and the monotonic clock so a time sync
+ * cannot move them. The window is open while its timer is armed; the others are refiled
+ * from their modules after every run, and rebuilt on every boot.
+ */
+WheelTimer windowTimer;
+WheelTimer sampleTimer;
+WheelTimer flushTimer;
 
 /**
  * Safe memory (persistent through deepSleeps).
  */
-RTC_DATA_ATTR time_t timestamp = 0;
-RTC_DATA_ATTR time_t sleepTarget = 0;
 RTC_DATA_ATTR bool dutyCycle = false;
 
-// Safe previous reading buffers for persistent readings.
-RTC_DATA_ATTR int8_t curTemp = 0;
-
 void prolongSleep(int seconds) {
-    time(&sleepTarget);
-    sleepTarget += seconds;
+    timerWheelArm(&windowTimer, timeSyncMonotonicMs() + seconds * 1000);
 }
 
 /**
@@ -59,12 +99,16 @@ void prolongSleep(int seconds) {
  */
 class MyServerCallbacks : public BLEServerCallbacks {
     /**
-     * Upon connection prolong activity timeout and remember connected state.
+     * Upon connection prolong activity timeout and remember connected state and client.
      */
-    void onConnect(BLEServer *pServer) {
+    void onConnect(BLEServer *pServer, esp_ble_gatts_cb_param_t *param) {
         prolongSleep(ACTIVITY_TIMEOUT);
+        energyEnter(ENERGY_RADIO_CONNECTED, timeSyncMonotonicMs());
+        gatewayConnected(timeSyncMonotonicMs());
+        deliveryConnect(param->connect.remote_bda);
         DEBUG_MSG_LN(2, "client connected");
         deviceConnected = true;
+        dashboardSetConnected(true);
     };
 
     /**
@@ -73,82 +117,505 @@ class MyServerCallbacks : public BLEServerCallbacks {
     void onDisconnect(BLEServer *pServer) {
         DEBUG_MSG_LN(2, "client disconnected");
         deviceConnected = false;
+        coalesceDiscard();
+        deliveryDisconnect();
+        dashboardSetConnected(false);
         pServer->startAdvertising();
+        energyEnter(ENERGY_RADIO_ADVERTISING, timeSyncMonotonicMs());
     }
 };
 
 /**
- * Generate a random temperature within boundaries, then update and return temp buffer address.
+ * ULP sampling (see ulpsampler.h): a thermistor on port B (GPIO36, ADC1 channel 0), read
+ * every temperature period. A move of about half a degree wakes the node early.
+ */
+const uint8_t ULP_ADC_CHANNEL = 0;
+const uint32_t ULP_PERIOD_MS = 10000;
+const uint16_t ULP_WAKE_THRESHOLD = 20;  // raw, about 0.5°C near room temperature
+
+/**
+ * Read the temperature in hundredths of a degree, without side effects. The node has no
+ * sensors, so it runs as a demo: the traces (see workload.h) follow the wall clock and the
+ * workload seed, set from the console with "seed <n>". With ULP sampling this is the
+ * latest raw thermistor reading instead; the factory calibration converts it.
+ */
+int16_t sampleTemperature() {
+    if (ULP_SAMPLING) return ulpSamplerLatest();
+    return workloadSample(SENSOR_TEMPERATURE, timeSyncWallMs());
+}
+
+/**
+ * Read the (synthetic) relative humidity in hundredths of a percent.
+ */
+int16_t sampleHumidity() {
+    return workloadSample(SENSOR_HUMIDITY, timeSyncWallMs());
+}
+
+/**
+ * Read the (synthetic) air pressure in tenths of a hectopascal.
+ */
+int16_t samplePressure() {
+    return workloadSample(SENSOR_PRESSURE, timeSyncWallMs());
+}
+
+/**
+ * Read the battery level in percent, 0 if the power IC cannot report it.
+ */
+int16_t sampleBattery() {
+    int8_t level = M5.Power.getBatteryLevel();
+    return level < 0 ? 0 : level;
+}
+
+/**
+ * Sensor registry, indexed by SensorId. Values are corrected by the unit's calibration,
+ * recorded in the history unit and scaled into the characteristic's unit when read. In
+ * DRAM, as every sample and read looks it up (see hotpath.h).
+ */
+static constexpr SensorSpec SENSORS[SENSOR_COUNT] HOT_DRAM_ATTR = {
+    // name, uuid16, size, scale, description, periodMs, slackMs, read
+    {"temperature", 0x2A6E, 2, 1, "Temp: [-10,40]°C", ULP_SAMPLING ? 0 : 10000, 2500,
+     calibratedRead<SENSOR_TEMPERATURE, sampleTemperature>},
+    {"humidity", 0x2A6F, 2, 1, "Humidity: %", 30000, 7500,
+     calibratedRead<SENSOR_HUMIDITY, sampleHumidity>},
+    {"pressure", 0x2A6D, 4, 100, "Pressure: Pa", 60000, 15000,
+     calibratedRead<SENSOR_PRESSURE, samplePressure>},
+    {"battery", 0x2A19, 1, 1, "Battery: %", 300000, 75000, sampleBattery},
+};
+
+/**
+ * Calibration for units without their own in NVS, indexed by SensorId.
+ */
+static constexpr CalibrationTable FACTORY_CALIBRATION[SENSOR_COUNT] = {ULP_NTC_TABLE, {}, {}, {}};
+
+/**
+ * Records the samples the ULP buffered, each at the time of its place in the buffer.
  */
-int8_t *updateRandTemp() {
+void drainUlp() {
+    uint16_t raw[ULP_BUFFER], dropped = 0;
+    uint8_t n = ulpSamplerDrain(raw, &dropped);
+    uint64_t now = sensorsNowMs();
+    for (uint8_t i = 0; i < n; i++) {
+        int16_t value = calibrationCorrect(SENSOR_TEMPERATURE, raw[i]);
+        sensorRecord(SENSOR_TEMPERATURE, value, now - (uint64_t)(n - 1 - i) * ULP_PERIOD_MS);
+    }
+    if (n) diagAdd("ulp.samples", n);
+    if (dropped) diagAdd("ulp.dropped", dropped);
+}
+
+/**
+ * Advertises the latest temperature and its sequence number as manufacturer data (company
+ * 0xFFFF, reserved for testing): [u32 seq] [i16 value]. Passive scanners can then see
+ * samples, and gaps, without connecting. The name and CTS are in the scan response.
+ */
+void advertiseSample(uint32_t seq, int16_t value) {
+    uint8_t data[] = {0xFF, 0xFF, (uint8_t)seq, (uint8_t)(seq >> 8), (uint8_t)(seq >> 16),
+                      (uint8_t)(seq >> 24), (uint8_t)value, (uint8_t)(value >> 8)};
+    BLEAdvertisementData adv;
+    adv.setFlags(ESP_BLE_ADV_FLAG_GEN_DISC | ESP_BLE_ADV_FLAG_BREDR_NOT_SPT);
+    adv.setCompleteServices(BLEUUID(SERVICE_UUID));
+    adv.setManufacturerData(std::string((const char *)data, sizeof(data)));
+    pServer->getAdvertising()->setAdvertisementData(adv);
+}
+
+/**
+ * Records each new sample on the display and advertisement (temperature), the
+ * notification batch while a client is connected, the trace when recording, and debug
+ * output. A low battery commits staged settings.
+ */
+void onSample(SensorId id, uint32_t seq, int16_t value) {
+    if (id == SENSOR_BATTERY) {
+        displayPostBattery(value);
+        if (value > 0 && value <= BATTERY_LOW_PERCENT) persistFlush();
+    }
+    if (!streamActive()) traceRecord(id, value, timeSyncWallMs());  // the stream owns the UART
+    if (id == SENSOR_TEMPERATURE) {
+        displayPostSample(value);
+        if (pServer) advertiseSample(seq, value);
+    }
+    if (deviceConnected) {
+        coalesceSetMtu(pServer->getPeerMTU(pServer->getConnId()));
+        coalesceAdd(id, seq, value, timeSyncMonotonicMs(), timeSyncWallMs());
+    }
+    DEBUG_MSG_F(2, "%s #%u %d\n", SENSORS[id].name, seq, value);
+}
+
+/**
+ * A client reading a sensor counts as activity, and as delivery of the latest sample.
+ */
+template <SensorId Id>
+size_t readSensor(uint8_t *out, size_t max) {
     prolongSleep(ACTIVITY_TIMEOUT);
-    curTemp = (int8_t)(rand() % 40) - 10;
-    DEBUG_MSG_LN(2, curTemp);
-    return &curTemp;
+    deliveryRecord(Id, sensorSeq(Id));
+    return sensorReadCharacteristic<Id>(out, max);
 }
 
 /**
- * Callback invoked when the Temp charactersitic is read.
+ * The latest value of every sensor with its sequence number (see sensorsEncodeLatest()),
+ * since the standard characteristics above have no room for one.
  */
-class TempCallBacks : public BLECharacteristicCallbacks {
-    /**
-     * Generate random temperature and respond to client.
-     */
-    void onRead(BLECharacteristic *pCharacteristic) {
-        pCharacteristic->setValue((uint8_t *)updateRandTemp(), 2);
+size_t HOT_IRAM_ATTR readLatest(uint8_t *out, size_t max) {
+    size_t len = sensorsEncodeLatest(out, max);
+    for (uint8_t i = 0; len && i < SENSOR_COUNT; i++) deliveryRecord(i, sensorSeq((SensorId)i));
+    prolongSleep(ACTIVITY_TIMEOUT);
+    return len;
+}
+
+/**
+ * History is served in the same chunks as the serial dump (see protocol.h). A client
+ * writes a u16 start index and optionally a u8 channel (sensor id), then each read
+ * returns the next chunk until one is empty.
+ */
+const uint8_t HISTORY_BLE_RECORDS = 16;
+static uint16_t historyCursor = 0;
+static uint8_t historyChannel = SENSOR_TEMPERATURE;
+
+void writeHistoryCursor(const uint8_t *data, size_t len) {
+    if (len >= 2) historyCursor = data[0] | data[1] << 8;
+    historyChannel = len >= 3 && data[2] < SENSOR_COUNT ? data[2] : SENSOR_TEMPERATURE;
+    prolongSleep(ACTIVITY_TIMEOUT);
+}
+
+size_t readHistoryChunk(uint8_t *out, size_t max) {
+    uint8_t records = (max - HISTORY_CHUNK_HEADER) / HISTORY_CHUNK_RECORD;
+    size_t len = historyEncodeChunk(historyCursor, records, out, historyChannel);
+    uint32_t seq = out[3] | out[4] << 8 | out[5] << 16 | (uint32_t)out[6] << 24;
+    deliveryRecord(historyChannel, seq, out[2]);
+    historyCursor += out[2];
+    prolongSleep(ACTIVITY_TIMEOUT);
+    return len;
+}
+
+/**
+ * Samples are notified in coalesced packets (see coalesce.h). Reading returns the last
+ * packet sent; writing a u32 sets the latency budget in milliseconds.
+ */
+static uint8_t batchPacket[COALESCE_MTU_MAX - 3];
+static size_t batchLen = 0;
+CRITICAL_DECLARE(batchMux);  // written on the loop, read from the BLE task
+
+size_t readBatch(uint8_t *out, size_t max) {
+    CRITICAL_ENTER(batchMux);
+    size_t len = batchLen < max ? batchLen : max;
+    memcpy(out, batchPacket, len);
+    CRITICAL_EXIT(batchMux);
+    return len;
+}
+
+void writeBatchBudget(const uint8_t *data, size_t len) {
+    if (len < 4) return;
+    coalesceSetBudget(data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24);
+}
+
+void notifyBatch(const uint8_t *packet, size_t len);
+
+/**
+ * GATT schema of the node service, one characteristic per sensor (in SensorId order)
+ * followed by the history, the notification batch and the latest samples.
+ */
+const size_t CHAR_HISTORY = SENSOR_COUNT;
+const size_t CHAR_BATCH = SENSOR_COUNT + 1;
+const size_t CHAR_LATEST = SENSOR_COUNT + 2;
+
+static constexpr GattCharacteristic NODE_SERVICE[] = {
+    sensorCharacteristic<SENSOR_TEMPERATURE>(SENSORS, GATT_READ, readSensor<SENSOR_TEMPERATURE>),
+    sensorCharacteristic<SENSOR_HUMIDITY>(SENSORS, GATT_READ, readSensor<SENSOR_HUMIDITY>),
+    sensorCharacteristic<SENSOR_PRESSURE>(SENSORS, GATT_READ, readSensor<SENSOR_PRESSURE>),
+    sensorCharacteristic<SENSOR_BATTERY>(SENSORS, GATT_READ, readSensor<SENSOR_BATTERY>),
+    // uuid16, uuid128, properties, maxLen, description, read, write
+    {0, "224c9412-d6cb-4b2e-b4cb-ab687eb7de23", GATT_READ | GATT_WRITE,
+     HISTORY_CHUNK_HEADER + HISTORY_BLE_RECORDS * HISTORY_CHUNK_RECORD, NULL, readHistoryChunk,
+     writeHistoryCursor},
+    {0, "224c9413-d6cb-4b2e-b4cb-ab687eb7de23", GATT_READ | GATT_WRITE | GATT_NOTIFY,
+     sizeof(batchPacket), NULL, readBatch, writeBatchBudget},
+    {0, "224c9414-d6cb-4b2e-b4cb-ab687eb7de23", GATT_READ, SENSOR_COUNT * SENSOR_LATEST_RECORD,
+     NULL, readLatest, NULL},
+};
+static_assert(gattIndex(NODE_SERVICE, SENSORS[SENSOR_BATTERY].uuid16) == SENSOR_BATTERY &&
+                  CHAR_LATEST + 1 == sizeof(NODE_SERVICE) / sizeof(NODE_SERVICE[0]),
+              "one characteristic per sensor, in SensorId order");
+
+GATT_SERVICE(nodeService, NODE_SERVICE);
+
+/**
+ * Current Time Service. A client (typically the gateway) writes the time to sync the
+ * node; history is timestamped from it and the drift estimated across syncs.
+ */
+void writeCurrentTime(const uint8_t *data, size_t len);
+
+static constexpr GattCharacteristic CTS_SERVICE[] = {
+    // uuid16, uuid128, properties, maxLen, description, read, write
+    {0x2A2B, NULL, GATT_READ | GATT_WRITE | GATT_NOTIFY, CTS_CURRENT_TIME_LEN, NULL,
+     timeSyncReadCts, writeCurrentTime},
+};
+
+GATT_SERVICE(ctsService, CTS_SERVICE);
+
+void writeCurrentTime(const uint8_t *data, size_t len) {
+    timeSyncWriteCts(data, len);
+    ctsService.notify(0);
+    prolongSleep(ACTIVITY_TIMEOUT);
+}
+
+void notifyBatch(const uint8_t *packet, size_t len) {
+    CRITICAL_ENTER(batchMux);
+    memcpy(batchPacket, packet, len);
+    batchLen = len;
+    CRITICAL_EXIT(batchMux);
+    nodeService.notify(CHAR_BATCH);
+    if (!nodeService.subscribed(CHAR_BATCH)) return;
+
+    for (const uint8_t *p = packet + COALESCE_HEADER; p < packet + len; p += COALESCE_SAMPLE) {
+        deliveryRecord(p[0], historySeqExpand(p[1] | p[2] << 8, p[0]));
+    }
+}
+
+void onSampleDue(void *) {
+    uint32_t start = hotPathStart();
+    sensorsRunDue(sensorsNowMs());
+    hotPathEnd(HOT_PATH_SAMPLE, start);
+}
+
+void onFlushDue(void *) {
+    coalescePoll(timeSyncMonotonicMs());
+}
+
+void armIn(WheelTimer *timer, uint64_t now, uint32_t ms) {
+    if (ms == UINT32_MAX) {
+        timerWheelCancel(timer);
+    } else {
+        timerWheelArm(timer, now + ms);
     }
+}
+
+/**
+ * Files the next sample and batch deadlines, after anything that may have moved them.
+ */
+void armDeadlines() {
+    uint64_t now = timeSyncMonotonicMs();
+    armIn(&sampleTimer, now, sensorsMsUntilDue(now));
+    armIn(&flushTimer, now, coalesceMsUntilFlush(now));
+}
+
+void deadlinesBegin() {
+    timerWheelBegin(timeSyncMonotonicMs());
+    timerWheelInit(&windowTimer, NULL);
+    timerWheelInit(&sampleTimer, onSampleDue);
+    timerWheelInit(&flushTimer, onFlushDue);
+}
+
+/**
+ * Stays up long enough to cover the expected gateway poll's jitter.
+ */
+void openAwakeWindow() {
+    prolongSleep(max(DUTY_CYCLE_AWAKE, (int)((gatewayWindowMs() + 999) / 1000)));
+}
+
+/**
+ * The gap until the next deadline, the gateway's expected poll (or a dithered
+ * DUTY_CYCLE_SLEEP while it is still being learnt) or the wheel's next timer, and the
+ * cheapest allowed way to spend it. Only a wake for samples alone can take the stub path.
+ */
+struct SleepPlan {
+    SleepMode mode;
+    uint32_t sleepMs;
+    bool radio;  // the wake is for the gateway
 };
 
+SleepPlan planSleep(uint64_t now, uint8_t allowed) {
+    uint32_t radioMs = gatewayMsUntilWake(now, DUTY_CYCLE_SLEEP * 1000);
+    uint32_t timerMs = timerWheelMsUntilNext(now);
+    SleepPlan plan;
+    plan.radio = radioMs <= timerMs;
+    plan.sleepMs = max(min(radioMs, timerMs), (uint32_t)1);  // 0 would disable the timer wakeup
+    if (plan.radio) allowed &= ~sleepModeBit(SLEEP_MODE_STUB);
+    plan.mode = sleepModeSelect(plan.sleepMs, allowed);
+    return plan;
+}
+
+/**
+ * Ends the window in deep sleep, woken by the timer, the buttons or the ULP. The panel,
+ * if it was set up, is put to sleep first; M5.Power.deepSleep() is not used, as it sets
+ * its own wake sources and never returns.
+ */
+void enterDeepSleep(SleepMode mode, uint32_t sleepMs, bool lcd) {
+    uint64_t now = timeSyncMonotonicMs();
+    recoverySleep();
+    energySleep(now);
+    sleepModeStart(mode, now, sleepMs, energyChargeMa10Ms(now));
+    buttonsEnableWakeup();
+    if (ULP_SAMPLING) ulpSamplerEnableWakeup();
+    if (lcd) displaySuspend();  // the display task's frame, then brightness 0 and LCD sleep
+    esp_sleep_enable_timer_wakeup(SLEEP_MSEC(sleepMs));
+    esp_deep_sleep_start();
+}
+
+/**
+ * Light sleeps through a gap too short to pay for a reboot. RAM, tasks and, with modem
+ * sleep, the BLE controller and bluedroid survive, so the GATT server and advertising
+ * data stay as they are; advertising only pauses. The display task is let finish its
+ * frame and the panel put to sleep first. Returns false if the sleep could not start.
+ */
+bool lightSleep(uint32_t sleepMs) {
+    uint64_t now = timeSyncMonotonicMs();
+    pServer->getAdvertising()->stop();
+    displaySuspend();
+    energyEnter(ENERGY_RADIO_OFF, now);
+    energyEnter(ENERGY_CPU_LIGHT_SLEEP, now);
+    sleepModeStart(SLEEP_MODE_LIGHT, now, sleepMs, energyChargeMa10Ms(now));
+
+    buttonsEnableWakeup();
+    if (ULP_SAMPLING) ulpSamplerEnableWakeup();
+    esp_sleep_enable_timer_wakeup(SLEEP_MSEC(sleepMs));
+    bool slept = esp_light_sleep_start() == ESP_OK;
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+    buttonsWoke();
+
+    energyWake(timeSyncMonotonicMs(), 0);
+    displayResume();
+    if (buttonsWokeNode()) displayWake();
+    pServer->startAdvertising();
+    now = timeSyncMonotonicMs();
+    energyEnter(ENERGY_RADIO_ADVERTISING, now);
+    sleepModeWoke(now, energyChargeMa10Ms(now), slept && esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER);
+    return slept;
+}
+
+/**
+ * Fast path after repeated crashes or brown-outs (see recovery.h): no display, radio or
+ * console, just the sensors due, then a sleep that doubles with every further failure.
+ */
+void degradedWake() {
+    M5.begin(false, false, false);  // no LCD, SD or second Serial.begin()
+    M5.Power.begin();
+    DEBUG_MSG_F(1, "degraded: %u failures\n", recoveryInfo().failures);  // also rec.failures
+
+    calibrationBegin(ULP_SAMPLING ? FACTORY_CALIBRATION : NULL);
+    sensorsBegin(SENSORS, NULL);
+    sensorsRunDue(sensorsNowMs());
+
+    // The panel is not set up, so it is left alone. The next wake is a full attempt.
+    enterDeepSleep(SLEEP_MODE_DEEP, recoveryBackoffMs(), false);
+}
+
+/**
+ * Wake for samples due before the gateway's next poll (see sleepmode.h): no display,
+ * radio or console, the samples go into history for the next full wake, then back to
+ * sleep. Samples due sooner than another sleep could wake for are waited for here.
+ */
+void stubWake() {
+    M5.begin(false, false, false);
+    M5.Power.begin();
+    calibrationBegin(ULP_SAMPLING ? FACTORY_CALIBRATION : NULL);
+    sensorsBegin(SENSORS, onSample);
+    if (ULP_SAMPLING) drainUlp();
+    sensorsRunDue(sensorsNowMs());
+    armDeadlines();
+    uint64_t now = timeSyncMonotonicMs();
+    sleepModeWoke(now, energyChargeMa10Ms(now), true);
+
+    uint8_t allowed = sleepModeBit(SLEEP_MODE_STUB) | sleepModeBit(SLEEP_MODE_DEEP);
+    SleepPlan plan = planSleep(now, allowed);
+    while (plan.mode == SLEEP_MODE_AWAKE && !plan.radio) {
+        delay(plan.sleepMs);
+        timerWheelRun(timeSyncMonotonicMs());
+        armDeadlines();
+        plan = planSleep(timeSyncMonotonicMs(), allowed);
+    }
+    enterDeepSleep(plan.mode == SLEEP_MODE_AWAKE ? SLEEP_MODE_DEEP : plan.mode, plan.sleepMs, false);
+}
+
 /**
  * Configures the critical sensor node peripherals such as screen and BLE server.
  */
 void setup() {
-    // Initialize device
+    // Initialize device, unless this boot follows repeated failures. Energy accounting
+    // charges the sleep just ended, and the boot, before anything else.
+    energyBegin(timeSyncMonotonicMs());
+    energyWake(timeSyncMonotonicMs(), millis());
+    sleepModeBegin();
+    deadlinesBegin();
     Serial.begin(115200);
+    if (recoveryBegin(recoveryResetReason()) == RECOVERY_DEGRADED) degradedWake();
+    bool timerWake = esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER;
+    if (timerWake && sleepModeLast() == SLEEP_MODE_STUB) stubWake();
     M5.begin();
     M5.Power.begin();
-    if (DEBUG) {
-        M5.Lcd.clear();
-        M5.Lcd.setBrightness(75);
-    }
+    recoveryPhase(RECOVERY_PHASE_INIT);
+    buttonsBegin();
+    if (DEBUG) M5.Lcd.clear();
     DEBUG_MSG_LN(1, "Temperature node starting...");
+    if (!dashboardBegin()) DEBUG_MSG_LN(1, "dashboard: out of memory");
 
-    // Create BLE server with callbacks.
-    BLEDevice::init("m5-temperature-1");
-    pServer = BLEDevice::createServer();
-    pServer->setCallbacks(new MyServerCallbacks());
-    pService = pServer->createService(serviceUUID);
+    // Settings and counters come from NVS, through the write-coalescing layer; the
+    // workload seed only needs reading after a cold boot, RTC memory keeps it otherwise.
+    bool coldBoot = esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_UNDEFINED;
+    persistBegin();
+    uint32_t wakes = 0, seed;
+    persistGet("wakes", &wakes, sizeof(wakes));
+    wakes++;
+    persistPut("wakes", &wakes, sizeof(wakes), timeSyncMonotonicMs());
+    diagSet("node.wakes", wakes);
+    if (coldBoot && persistGet("seed", &seed, sizeof(seed)) == sizeof(seed)) workloadSetSeed(seed);
 
-    // Add descriptor values.
-    tempDescriptor.setValue("Temp: [-10,40]°C");
+    // Sensor deadlines persist in RTC memory; a cold boot samples everything at once.
+    // Per-unit calibration comes from NVS.
+    calibrationBegin(ULP_SAMPLING ? FACTORY_CALIBRATION : NULL);
+    sensorsBegin(SENSORS, onSample);
+    coalesceBegin(notifyBatch);
 
-    // Update characteristics with descriptors.
-    tempCharacteristic.addDescriptor(&tempDescriptor);
+    // The ULP keeps sampling through deep sleep, so it is only loaded on a cold boot.
+    if (ULP_SAMPLING && coldBoot && !ulpSamplerBegin(ULP_ADC_CHANNEL, ULP_PERIOD_MS, ULP_WAKE_THRESHOLD)) {
+        DEBUG_MSG_LN(1, "ulp: cannot load program");
+    }
 
-    // Add callback handlers to characteristics.
-    tempCharacteristic.setCallbacks(new TempCallBacks());
+    // Only light the panel when someone is likely to be looking at it.
+    displayBegin(DEBUG || coldBoot || buttonsWokeNode());
 
-    // Display advertised UUIDs for debbugging.
-    DEBUG_MSG_F(1, "- Serv-UUID: %s\n", serviceUUID.toString().c_str());
-    DEBUG_MSG_F(1, "- Temp-UUID: %s\n", tempCharacteristic.getUUID().toString().c_str());
+    // Create BLE server with callbacks. A larger MTU lets more samples share a notification.
+    recoveryPhase(RECOVERY_PHASE_RADIO);
+    energyEnter(ENERGY_RADIO_INIT, timeSyncMonotonicMs());
+    BLEDevice::init(DEVICE_NAME);
+    BLEDevice::setMTU(185);
+    pServer = BLEDevice::createServer();
+    pServer->setCallbacks(new MyServerCallbacks());
 
-    // Add characteristics to service.
-    pService->addCharacteristic(&tempCharacteristic);
+    // Register the schema's characteristics and descriptors, then start the service.
+    pService = nodeService.begin(pServer, SERVICE_UUID);
+    ctsService.begin(pServer, CTS_UUID);
 
-    // Start service and begin advertising.
-    pService->start();
-    pServer->getAdvertising()->addServiceUUID(serviceUUID);
+    // Display advertised UUIDs for debbugging.
+    BLECharacteristic *temp = nodeService.characteristic(SENSOR_TEMPERATURE);
+    DEBUG_MSG_F(1, "- Serv-UUID: %s\n", pService->getUUID().toString().c_str());
+    DEBUG_MSG_F(1, "- Temp-UUID: %s\n", temp->getUUID().toString().c_str());
+
+    // Begin advertising, the latest sample in the advertisement and the rest in the scan
+    // response (31 bytes each).
+    BLEAdvertisementData response;
+    response.setName(DEVICE_NAME);
+    response.setPartialServices(BLEUUID(CTS_UUID));
+    pServer->getAdvertising()->setScanResponseData(response);
+    // Take any first samples here, so a client's read never samples from the BLE task.
+    sensorsRunDue(sensorsNowMs());
+    advertiseSample(sensorSeq(SENSOR_TEMPERATURE), sensorLatest(SENSOR_TEMPERATURE));
     pServer->startAdvertising();
+    energyEnter(ENERGY_RADIO_ADVERTISING, timeSyncMonotonicMs());
 
-    prolongSleep(DUTY_CYCLE_AWAKE);
-}
+    // Doze between radio events for the rest of the window. The buttons are polled then,
+    // as their edges are lost while the chip sleeps.
+    lightSleepOk = sleepModeLightBegin();
+    if (!lightSleepOk) DEBUG_MSG_LN(1, "bt: no modem sleep, light sleep disabled");
+    if (BLE_MODEM_SLEEP) doze = sleepModeDozeBegin();
+    if (BLE_MODEM_SLEEP && !doze) DEBUG_MSG_LN(1, "pm: no automatic light sleep in this framework");
+    buttonsSetPolling(doze);
 
-/**
- * Clears the display and resets cursor position.
- */
-void clearDisplay() {
-    M5.Lcd.clear(BLACK);
-    M5.Lcd.setCursor(0, 0);
+    streamBegin(calibratedRead<SENSOR_TEMPERATURE, sampleTemperature>);
+    consoleBegin();
+
+    // The boot just measured is what a deep sleep costs to wake from.
+    openAwakeWindow();
+    armDeadlines();
+    sleepModeWoke(timeSyncMonotonicMs(), energyChargeMa10Ms(timeSyncMonotonicMs()), timerWake);
+    recoveryPhase(RECOVERY_PHASE_RUN);
 }
 
 /**
@@ -157,23 +624,72 @@ void clearDisplay() {
 void toggleDutyCycle() {
     dutyCycle = !dutyCycle;
     DEBUG_MSG_LN(1, "SET DUTY_CYCLE " + String(dutyCycle));
+    // Re-arming the window bounds the loop's next wait, so turning duty cycling on takes
+    // effect when it closes rather than at the next sensor or batch deadline.
     prolongSleep(DUTY_CYCLE_AWAKE);
 }
 
 /**
- * Main event loop, listens for buttons and checks duty cycle based on timestamps.
+ * Main event loop, blocks on button presses and the wheel's next timer, and sleeps once
+ * the awake window has closed.
  */
 void loop() {
-    M5.update();
+    ButtonEvent event;
+    uint32_t wait = timerWheelMsUntilNext(timeSyncMonotonicMs());
+    // Without duty cycling the window is not re-armed, so the wheel may hold nothing but
+    // far deadlines; keep polling staged settings and energy accounting regardless.
+    if (!dutyCycle && wait > AWAKE_POLL_MS) wait = AWAKE_POLL_MS;
 
     // Handle button presses.
-    if (M5.BtnA.wasReleasefor(5)) clearDisplay();
-    if (M5.BtnB.wasReleasefor(5)) toggleDutyCycle();
-    if (M5.BtnC.wasReleasefor(5)) M5.Power.reset();
-
-    time(&timestamp);
-    // Trigger duty cycle sleep only after threshold.
-    if (dutyCycle && timestamp > sleepTarget) {
-        M5.Power.deepSleep(SLEEP_SEC(DUTY_CYCLE_SLEEP));
+    energyEnter(doze ? ENERGY_CPU_DOZE : ENERGY_CPU_IDLE, timeSyncMonotonicMs());
+    bool pressed = buttonsWait(&event, wait);
+    energyEnter(ENERGY_CPU_RUN, timeSyncMonotonicMs());
+    // A press on a dark panel only wakes it.
+    if (pressed && displayDark()) {
+        displayWake();
+    } else if (pressed) {
+        if (event.button != BUTTON_A) displayWake();
+        if (event.button == BUTTON_A) displayNextScreen();
+        if (event.button == BUTTON_B && event.heldMs >= STREAM_HOLD_MS) {
+            streamActive() ? streamStop() : (void)streamStart(STREAM_DEFAULT_HZ);
+        } else if (event.button == BUTTON_B) {
+            toggleDutyCycle();
+        }
+        if (event.button == BUTTON_C) {
+            persistFlush();
+            recoveryPhase(RECOVERY_PHASE_RESET);
+            M5.Power.reset();
+        }
+    }
+
+    // Run the timers due: every sensor whose window is open in one go, then the batch.
+    // Staged settings are not a deadline to wake for, so they are only polled.
+    if (ULP_SAMPLING) drainUlp();
+    timerWheelRun(timeSyncMonotonicMs());
+    armDeadlines();
+    persistPoll(timeSyncMonotonicMs());
+    energyPublish(timeSyncMonotonicMs());
+
+    // Trigger duty cycle sleep once the window closes, in whichever mode costs least until
+    // the next deadline (see sleepmode.h). A gap too short for any sleep is blocked through.
+    // The batch goes out first, so its deadline does not hold the node awake.
+    if (dutyCycle && !timerWheelArmed(&windowTimer) && !streamActive()) {
+        coalesceFlush(timeSyncMonotonicMs());
+        timerWheelCancel(&flushTimer);
+        uint64_t now = timeSyncMonotonicMs();
+        // A connection would time out in a light sleep; deep sleep ends it.
+        uint8_t allowed = sleepModeBit(SLEEP_MODE_STUB) | sleepModeBit(SLEEP_MODE_DEEP);
+        if (lightSleepOk && !deviceConnected) allowed |= sleepModeBit(SLEEP_MODE_LIGHT);
+        SleepPlan plan = planSleep(now, allowed);
+        if (plan.mode == SLEEP_MODE_AWAKE) {
+            timerWheelArm(&windowTimer, now + plan.sleepMs);
+            return;
+        }
+
+        if (plan.mode != SLEEP_MODE_LIGHT) enterDeepSleep(plan.mode, plan.sleepMs, true);
+        if (!lightSleep(plan.sleepMs)) enterDeepSleep(SLEEP_MODE_DEEP, plan.sleepMs, true);
+
+        // A wake for samples alone goes straight back to sleep once they are taken.
+        if (plan.radio || esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_TIMER) openAwakeWindow();
     }
 }
@@ -0,0 +1,74 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+/**
+ * Tests for the debug macros on the host Serial stand-in:
+ *
+ *   pio test -e native
+ */
+#undef DEBUG
+#define DEBUG 1
+
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#include "debug.h"
+
+static char captured[128];
+
+void setUp() {
+    Serial.out = tmpfile();
+}
+
+void tearDown() {
+    fclose(Serial.out);
+    Serial.out = stderr;
+}
+
+/**
+ * Reads back what the macros wrote.
+ */
+static const char *output() {
+    rewind(Serial.out);
+    size_t n = fread(captured, 1, sizeof(captured) - 1, Serial.out);
+    captured[n] = '\0';
+    return captured;
+}
+
+void testMessagesAtOrBelowTheLevelAreWritten() {
+    DEBUG_MSG(1, "ble: ");
+    DEBUG_MSG_LN(1, 42);
+    DEBUG_MSG_F(1, "%s #%u %d\n", "temperature", 7u, -150);
+    TEST_ASSERT_EQUAL_INT32(0, strcmp(output(), "ble: 42\r\ntemperature #7 -150\n"));
+}
+
+void testVerboseMessagesAreDropped() {
+    DEBUG_MSG_LN(2, "client connected");
+    DEBUG_MSG_F(2, "%d\n", 1);
+    TEST_ASSERT_EQUAL_INT32(0, strcmp(output(), ""));
+}
+
+void testMacrosAreSingleStatements() {
+    bool connected = false;
+    if (connected)
+        DEBUG_MSG_LN(1, "connected");
+    else
+        DEBUG_MSG_LN(1, "idle");
+    TEST_ASSERT_EQUAL_INT32(0, strcmp(output(), "idle\r\n"));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(testMessagesAtOrBelowTheLevelAreWritten);
+    RUN_TEST(testVerboseMessagesAreDropped);
+    RUN_TEST(testMacrosAreSingleStatements);
+    return UNITY_END();
+}
@@ -0,0 +1,137 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+/**
+ * Tests for the binary history protocol, fed the same frames tools/history_dump.py sends:
+ *
+ *   pio test -e native
+ */
+#include <string.h>
+#include <unity.h>
+
+#include "cobs.h"
+#include "gatt.h"
+#include "history.h"
+#include "protocol.h"
+
+static uint8_t sent[4096];
+static size_t sentLen = 0;
+static char line[64];
+
+static void onWrite(const uint8_t *data, size_t len) {
+    TEST_ASSERT_TRUE(sentLen + len <= sizeof(sent));
+    memcpy(&sent[sentLen], data, len);
+    sentLen += len;
+}
+
+static void onLine(const char *text) {
+    strncpy(line, text, sizeof(line) - 1);
+}
+
+/**
+ * Sends a request as a host does: a zero, then the frame.
+ */
+static void request(const uint8_t *payload, size_t len) {
+    uint8_t frame[cobsMaxEncoded(PROTOCOL_PAYLOAD_MAX + 2) + 2] = {0};
+    size_t n = frameEncode(payload, len, &frame[1]);
+    protocolFeed(frame, n + 1);
+}
+
+/**
+ * Decodes the next response frame in place. Returns its payload, or NULL when none is left.
+ */
+static uint8_t *response(size_t *at, int *len) {
+    if (*at >= sentLen) return NULL;
+    uint8_t *frame = &sent[*at];
+    size_t n = strnlen((const char *)frame, sentLen - *at);
+    *at += n + 1;
+    *len = frameDecode(frame, n);
+    return frame;
+}
+
+void setUp() {
+    sentLen = 0;
+    line[0] = '\0';
+    historyReset();
+    protocolBegin(onWrite, onLine);
+}
+
+void tearDown() {}
+
+void testDumpReturnsEveryRecord() {
+    const uint16_t RECORDS = HISTORY_CHUNK_MAX + 5;
+    for (uint16_t i = 0; i < RECORDS; i++) historyAppend(1000 + i, i * 3 - 40);
+
+    uint8_t dump[5] = {CMD_DUMP};
+    gattPut16(&dump[1], 0);
+    gattPut16(&dump[3], RECORDS);
+    request(dump, sizeof(dump));
+
+    size_t at = 0;
+    int len;
+    uint16_t records = 0;
+    uint8_t *p;
+    while ((p = response(&at, &len)) && p[1] == STATUS_MORE) {
+        TEST_ASSERT_EQUAL_INT32(CMD_DUMP | PROTOCOL_RESPONSE, p[0]);
+        TEST_ASSERT_EQUAL_INT32(records, gattGet16(&p[2]));
+        for (uint8_t i = 0; i < p[4]; i++, records++) {
+            uint8_t expected[HISTORY_CHUNK_RECORD];
+            gattPut32(expected, 1000 + records);
+            gattPut16(&expected[4], records * 3 - 40);
+            const uint8_t *r = &p[2 + HISTORY_CHUNK_HEADER + i * HISTORY_CHUNK_RECORD];
+            TEST_ASSERT_EQUAL_INT32(0, memcmp(expected, r, sizeof(expected)));
+        }
+    }
+    TEST_ASSERT_TRUE(p != NULL);
+    TEST_ASSERT_EQUAL_INT32(STATUS_OK, p[1]);
+    TEST_ASSERT_EQUAL_INT32(RECORDS, gattGet16(&p[2]));
+    TEST_ASSERT_EQUAL_INT32(RECORDS, records);
+    TEST_ASSERT_TRUE(response(&at, &len) == NULL);
+}
+
+void testCorruptFrameIsRejected() {
+    uint8_t frame[8] = {0};
+    uint8_t stats[1] = {CMD_STATS};
+    size_t n = frameEncode(stats, sizeof(stats), &frame[1]);
+    frame[2] ^= 0x10;
+    protocolFeed(frame, n + 1);
+
+    size_t at = 0;
+    int len;
+    uint8_t *p = response(&at, &len);
+    TEST_ASSERT_TRUE(p != NULL);
+    TEST_ASSERT_EQUAL_INT32(STATUS_BAD_FRAME, p[1]);
+}
+
+void testTextLinesPassThrough() {
+    const char *text = "diag\r\n";
+    protocolFeed((const uint8_t *)text, strlen(text));
+    TEST_ASSERT_EQUAL_INT32(0, strcmp(line, "diag"));
+    TEST_ASSERT_EQUAL_INT32(0, sentLen);
+}
+
+void testBinaryUntilTheNextTextLine() {
+    uint8_t stats[1] = {CMD_STATS};
+    request(stats, sizeof(stats));
+    TEST_ASSERT_TRUE(protocolBinary());
+
+    const char *text = "record\n";
+    protocolFeed((const uint8_t *)text, strlen(text));
+    TEST_ASSERT_TRUE(!protocolBinary());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(testDumpReturnsEveryRecord);
+    RUN_TEST(testCorruptFrameIsRejected);
+    RUN_TEST(testTextLinesPassThrough);
+    RUN_TEST(testBinaryUntilTheNextTextLine);
+    return UNITY_END();
+}
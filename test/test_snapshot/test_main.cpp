@@ -0,0 +1,64 @@
+/**
+ *   ___  ___ ___ | |_| |_ ______ _  ___| |__ / |
+ *  / __|/ __/ _ \| __| __|_  / _` |/ __| '_ \| |
+ *  \__ \ (_| (_) | |_| |_ / / (_| | (__| | | | |
+ *  |___/\___\___/ \__|\__/___\__,_|\___|_| |_|_|
+ *
+ *       Zac Scott (github.com/scottzach1)
+ *
+ * M5StackTemperature - BLE Server for Temperature Sensor
+ */
+/**
+ * Golden image tests for the dashboard, run on the host framebuffer LCD:
+ *
+ *   pio test -e native
+ *
+ * After an intended change to the dashboard, regenerate the golden image with the
+ * simulator's snapshot command and review the new image before committing it.
+ */
+#include <unity.h>
+
+#include "dashboard.h"
+#include "history.h"
+#include "lcd.h"
+
+static const char *GOLDEN = "test/golden/dashboard.ppm";
+static const char *SCRATCH = ".pio/snapshot.ppm";
+
+void setUp() {
+    TEST_ASSERT_TRUE(dashboardLoadScene());
+    dashboardInvalidate();
+    dashboardRefresh();
+}
+
+void tearDown() {}
+
+/**
+ * A full repaint of the scene matches the golden image pixel for pixel.
+ */
+void testFullRepaintMatchesGolden() {
+    TEST_ASSERT_EQUAL_INT32(0, mockLcd.diffPpm(GOLDEN));
+}
+
+/**
+ * Only changed tiles are pushed on a sample update, so the panel must end up as a full
+ * repaint of the same state would leave it.
+ */
+void testSampleUpdateMatchesRepaint() {
+    historyAppend(SPARKLINE_SAMPLES * 60, 2275);
+    dashboardSetTemperature(2275);
+    dashboardRefresh();
+    TEST_ASSERT_TRUE(mockLcd.dumpPpm(SCRATCH));
+
+    dashboardInvalidate();
+    dashboardRefresh();
+    TEST_ASSERT_EQUAL_INT32(0, mockLcd.diffPpm(SCRATCH));
+    TEST_ASSERT_NOT_EQUAL(0, mockLcd.diffPpm(GOLDEN));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(testFullRepaintMatchesGolden);
+    RUN_TEST(testSampleUpdateMatchesRepaint);
+    return UNITY_END();
+}
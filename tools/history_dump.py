@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+"""
+M5StackTemperature - pull history and diagnostics from a node over Serial.
+
+Speaks the binary command protocol in lib/MyNWEN/protocol.h and reports throughput.
+
+    tools/history_dump.py /dev/ttyUSB0 dump history.csv
+    tools/history_dump.py /dev/ttyUSB0 stats
+    tools/history_dump.py /dev/ttyUSB0 diag
+    tools/history_dump.py /dev/ttyUSB0 clients
+    tools/history_dump.py /dev/ttyUSB0 reset
+
+The native simulator can stand in for a node (`program serve-pty`), so the same commands
+run against the pty it prints.
+"""
+import argparse
+import os
+import struct
+import sys
+import time
+
+from m5frame import FrameReader, encode_frame, open_serial
+
+CMD_DUMP, CMD_STATS, CMD_RESET, CMD_DIAG, CMD_CLIENTS = 0x01, 0x02, 0x03, 0x04, 0x05
+STATUS_OK, STATUS_MORE = 0, 1
+STATUS_NAMES = {2: "bad frame", 3: "unknown command", 4: "bad arguments"}
+RESPONSE = 0x80
+
+
+class ProtocolError(Exception):
+    pass
+
+
+def request(fd, cmd, args=b"", timeout=2.0):
+    """Sends one command and returns the data of each response frame, in order."""
+    os.write(fd, b"\x00" + encode_frame(bytes([cmd]) + args))
+    reader = FrameReader(fd)
+    parts = []
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        for payload in reader.frames():
+            if payload is None or len(payload) < 2:
+                raise ProtocolError("corrupt response frame")
+            if payload[0] != cmd | RESPONSE:
+                raise ProtocolError("response to 0x%02x, expected 0x%02x" % (payload[0] & 0x7F, cmd))
+            status = payload[1]
+            if status not in (STATUS_OK, STATUS_MORE):
+                raise ProtocolError(STATUS_NAMES.get(status, "status %d" % status))
+            parts.append(payload[2:])
+            if status == STATUS_OK:
+                return parts, reader.bytes
+            deadline = time.monotonic() + timeout
+    raise ProtocolError("timed out")
+
+
+def decode_chunk(chunk):
+    first, n, seq = struct.unpack_from("<HBI", chunk)
+    return [(first + i, seq + i) + struct.unpack_from("<Ih", chunk, 7 + 6 * i) for i in range(n)]
+
+
+def command_dump(fd, args):
+    started = time.monotonic()
+    parts, nbytes = request(fd, CMD_DUMP, struct.pack("<HHB", args.first, args.count, args.channel))
+    elapsed = time.monotonic() - started
+
+    rows = [row for chunk in parts[:-1] for row in decode_chunk(chunk)]
+    (sent,) = struct.unpack("<H", parts[-1])
+    if sent != len(rows):
+        raise ProtocolError("node sent %d records, received %d" % (sent, len(rows)))
+
+    with open(args.output, "w") as f:
+        f.write("index,seq,time,value\n")
+        for row in rows:
+            f.write("%d,%d,%d,%d\n" % row)
+
+    print("records      %d" % len(rows))
+    if rows:
+        print("sequence     %d .. %d" % (rows[0][1], rows[-1][1]))
+    print("elapsed      %.3f s" % elapsed)
+    print("throughput   %.0f records/s, %.1f kB/s" % (len(rows) / elapsed, nbytes / elapsed / 1000))
+
+
+def command_stats(fd, args):
+    parts, _ = request(fd, CMD_STATS, bytes([args.channel]))
+    count, capacity, oldest, newest, lo, hi, mean, seq = struct.unpack("<HHIIhhhI", parts[0])
+    print("records      %d / %d" % (count, capacity))
+    print("produced     %d (%d rolled out)" % (seq, seq - count))
+    if count:
+        print("time         %d .. %d" % (oldest, newest))
+        print("min/max/mean %d / %d / %d" % (lo, hi, mean))
+
+
+def command_reset(fd, args):
+    request(fd, CMD_RESET)
+    print("history cleared")
+
+
+def command_diag(fd, args):
+    parts, _ = request(fd, CMD_DIAG)
+    for data in parts:
+        i = 0
+        while i < len(data):
+            n = data[i]
+            key = data[i + 1:i + 1 + n].decode()
+            (value,) = struct.unpack_from("<i", data, i + 1 + n)
+            print("%-24s %d" % (key, value))
+            i += 1 + n + 4
+
+
+def command_clients(fd, args):
+    parts, _ = request(fd, CMD_CLIENTS)
+    data = parts[0]
+    print("%-17s %10s %10s %8s" % ("address", "produced", "delivered", "ratio"))
+    for i in range(0, len(data), 14):
+        produced, delivered = struct.unpack_from("<II", data, i + 6)
+        address = ":".join("%02x" % b for b in data[i:i + 6])
+        ratio = "%.1f%%" % (100.0 * delivered / produced) if produced else "-"
+        print("%-17s %10d %10d %8s" % (address, produced, delivered, ratio))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("port")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--channel", type=int, default=0, help="history channel (sensor id)")
+    sub = parser.add_subparsers(dest="command", required=True)
+    dump = sub.add_parser("dump")
+    dump.add_argument("output")
+    dump.add_argument("--first", type=int, default=0)
+    dump.add_argument("--count", type=int, default=0xFFFF)
+    dump.set_defaults(run=command_dump)
+    sub.add_parser("stats").set_defaults(run=command_stats)
+    sub.add_parser("reset").set_defaults(run=command_reset)
+    sub.add_parser("diag").set_defaults(run=command_diag)
+    sub.add_parser("clients").set_defaults(run=command_clients)
+    args = parser.parse_args()
+
+    fd = open_serial(args.port, args.baud)
+    try:
+        args.run(fd, args)
+    except ProtocolError as e:
+        print("error: %s" % e, file=sys.stderr)
+        return 1
+    finally:
+        os.close(fd)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
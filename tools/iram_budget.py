@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""
+M5StackTemperature - check the firmware's hot code and data against their RAM budgets.
+
+Functions marked HOT_IRAM_ATTR and tables marked HOT_DRAM_ATTR (see lib/MyNWEN/hotpath.h)
+are linked into sections of their own. This sums them by object from the linker map and
+fails when they outgrow HOT_IRAM_BUDGET or HOT_DRAM_BUDGET, or when the whole image
+leaves less than IRAM_HEADROOM of IRAM free, so a placement cannot silently crowd out
+the BLE controller or a framework update.
+
+PlatformIO runs it after every firmware link (extra_scripts in platformio.ini); it can
+also be run on a map and, optionally, the ELF:
+
+    tools/iram_budget.py .pio/build/m5stack-core-esp32/firmware.map \\
+        --elf .pio/build/m5stack-core-esp32/firmware.elf
+"""
+import argparse
+import os
+import re
+import struct
+import sys
+
+IRAM_START, IRAM_SIZE = 0x40080000, 0x20000  # iram0_0_seg, cache on both cores
+IRAM_HEADROOM = 2048
+SHF_ALLOC = 0x2
+
+HEADER = "lib/MyNWEN/hotpath.h"
+KINDS = (("iram", ".iram1.hot", "HOT_IRAM_BUDGET"), ("dram", ".dram1.hot", "HOT_DRAM_BUDGET"))
+SECTION = re.compile(r"^ (\.(?:iram1|dram1)\.hot)\.\d+(?:\s+0x[0-9a-f]+\s+0x([0-9a-f]+)\s+(\S+))?$")
+CONTINUATION = re.compile(r"^\s+0x[0-9a-f]+\s+0x([0-9a-f]+)\s+(\S+)$")
+
+
+def read_budgets(project):
+    with open(os.path.join(project, HEADER)) as f:
+        text = f.read()
+    budgets = {}
+    for kind, _, name in KINDS:
+        m = re.search(r"const uint16_t %s = (\d+);" % name, text)
+        if not m:
+            raise ValueError("%s not found in %s" % (name, HEADER))
+        budgets[kind] = int(m.group(1))
+    return budgets
+
+
+def hot_sections(map_text):
+    """Bytes of each kind of hot section by object, from a GNU ld map."""
+    sizes = {kind: {} for kind, _, _ in KINDS}
+    prefixes = {prefix: kind for kind, prefix, _ in KINDS}
+    # Sections the linker dropped are listed before the memory map; skip them.
+    lines = map_text.split("Linker script and memory map", 1)[-1].splitlines()
+    for i, line in enumerate(lines):
+        m = SECTION.match(line)
+        if not m:
+            continue
+        size, obj = m.group(2), m.group(3)
+        if size is None:  # a long name, with the rest on the next line
+            c = CONTINUATION.match(lines[i + 1]) if i + 1 < len(lines) else None
+            if not c:
+                continue
+            size, obj = c.group(1), c.group(2)
+        by_object = sizes[prefixes[m.group(1)]]
+        by_object[os.path.basename(obj)] = by_object.get(os.path.basename(obj), 0) + int(size, 16)
+    return sizes
+
+
+def iram_used(elf_path):
+    """Bytes of allocated sections in IRAM, from the ELF section headers (32 bit, LE)."""
+    with open(elf_path, "rb") as f:
+        elf = f.read()
+    shoff, = struct.unpack_from("<I", elf, 0x20)
+    shentsize, shnum = struct.unpack_from("<HH", elf, 0x2E)
+    used = 0
+    for i in range(shnum):
+        _, _, flags, addr, _, size = struct.unpack_from("<6I", elf, shoff + i * shentsize)
+        if flags & SHF_ALLOC and IRAM_START <= addr < IRAM_START + IRAM_SIZE:
+            used += size
+    return used
+
+
+def check(map_path, elf_path, project):
+    budgets = read_budgets(project)
+    with open(map_path) as f:
+        sizes = hot_sections(f.read())
+
+    ok = True
+    for kind, _, name in KINDS:
+        total = sum(sizes[kind].values())
+        for obj, size in sorted(sizes[kind].items(), key=lambda item: -item[1]):
+            print("  hot %s %6d  %s" % (kind, size, obj))
+        print("hot %s %d of %d bytes (%s)" % (kind, total, budgets[kind], name))
+        if total > budgets[kind]:
+            print("error: hot %s over budget by %d bytes" % (kind, total - budgets[kind]), file=sys.stderr)
+            ok = False
+
+    if elf_path:
+        free = IRAM_SIZE - iram_used(elf_path)
+        print("iram free %d bytes (headroom %d)" % (free, IRAM_HEADROOM))
+        if free < IRAM_HEADROOM:
+            print("error: iram headroom below %d bytes" % IRAM_HEADROOM, file=sys.stderr)
+            ok = False
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("map")
+    parser.add_argument("--elf", help="firmware ELF, for the IRAM headroom")
+    parser.add_argument("--project", default=os.path.join(os.path.dirname(__file__), os.pardir))
+    args = parser.parse_args()
+    return 0 if check(args.map, args.elf, args.project) else 1
+
+
+def register(env):
+    """As a PlatformIO extra script: link with a map, check it after every link."""
+    map_path = env.subst("$BUILD_DIR/firmware.map")
+    env.Append(LINKFLAGS=["-Wl,-Map," + map_path])
+
+    def action(target, source, env):
+        return 0 if check(map_path, str(target[0]), env.subst("$PROJECT_DIR")) else 1
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", action)
+
+
+try:
+    Import  # noqa: F821, defined when PlatformIO runs this as an extra script
+except NameError:
+    sys.exit(main())
+Import("env")  # noqa: F821
+register(env)  # noqa: F821
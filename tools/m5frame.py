@@ -0,0 +1,103 @@
+"""
+M5StackTemperature - serial helpers shared by the host tools.
+
+Frames are COBS(payload + CRC-16/CCITT-FALSE little endian) followed by a 0x00, matching
+lib/MyNWEN/cobs.h. Only the Python standard library is used (Linux termios).
+"""
+import os
+import termios
+
+BAUDS = {115200: termios.B115200, 921600: termios.B921600}
+
+
+def open_serial(path, baud):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    set_baud(fd, baud)
+    return fd
+
+
+def set_baud(fd, baud):
+    iflag, oflag, cflag, lflag, _, _, cc = termios.tcgetattr(fd)
+    iflag = 0
+    oflag = 0
+    lflag = 0
+    cflag = termios.CS8 | termios.CREAD | termios.CLOCAL
+    cc[termios.VMIN] = 0
+    cc[termios.VTIME] = 1  # 100 ms read timeout
+    speed = BAUDS[baud]
+    termios.tcsetattr(fd, termios.TCSANOW, [iflag, oflag, cflag, lflag, speed, speed, cc])
+
+
+def crc16(data, crc=0xFFFF):
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        i += 1
+        if code == 0 or i + code - 1 > len(data):
+            return None
+        out += data[i:i + code - 1]
+        i += code - 1
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def decode_frame(frame):
+    """Returns the payload of a frame (without delimiter), or None if it is corrupt."""
+    raw = cobs_decode(frame)
+    if raw is None or len(raw) < 2:
+        return None
+    payload, crc = raw[:-2], raw[-2] | raw[-1] << 8
+    return payload if crc16(payload) == crc else None
+
+
+
+
+def cobs_encode(data):
+    out = bytearray()
+    block = bytearray()
+    for byte in data:
+        if byte == 0:
+            out.append(len(block) + 1)
+            out += block
+            block = bytearray()
+            continue
+        block.append(byte)
+        if len(block) == 254:
+            out.append(255)
+            out += block
+            block = bytearray()
+    out.append(len(block) + 1)
+    out += block
+    return bytes(out)
+
+
+def encode_frame(payload):
+    crc = crc16(payload)
+    return cobs_encode(bytes(payload) + bytes([crc & 0xFF, crc >> 8])) + b"\x00"
+
+
+class FrameReader:
+    """Splits a byte stream on 0x00 delimiters and yields decoded payloads (None if corrupt)."""
+
+    def __init__(self, fd):
+        self.fd = fd
+        self.buf = bytearray()
+        self.bytes = 0
+
+    def frames(self):
+        chunk = os.read(self.fd, 65536)
+        self.bytes += len(chunk)
+        self.buf += chunk
+        *frames, self.buf = self.buf.split(b"\x00")
+        return [decode_frame(bytes(f)) for f in frames if f]
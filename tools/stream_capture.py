@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+"""
+M5StackTemperature - capture a high rate binary stream from the node over UART.
+
+Asks the node to start streaming ("stream <hz>" at 115200 baud), switches to the stream
+baud rate, decodes COBS frames with CRC-16 and writes the samples as a columnar file:
+
+    b"M5COL1\\n" + one JSON header line + each column as a contiguous little endian array
+
+Columns: seq (u4), time_us (u8, unwrapped), value (i2, hundredths of a degree).
+
+    tools/stream_capture.py /dev/ttyUSB1 capture.m5col --hz 1000 --seconds 10
+
+Only the Python standard library is used (Linux termios).
+"""
+import argparse
+import array
+import json
+import os
+import struct
+import sys
+import termios
+import time
+
+from m5frame import BAUDS, decode_frame, open_serial, set_baud
+
+RECORD = struct.Struct("<IIh")
+
+
+class Columns:
+    def __init__(self):
+        self.seq = array.array("I")
+        self.time_us = array.array("Q")
+        self.value = array.array("h")
+        self._last_time = None
+        self._time_high = 0
+
+    def append(self, seq, time_us, value):
+        # The node sends the low 32 bits of its microsecond clock.
+        if self._last_time is not None and time_us < self._last_time:
+            self._time_high += 1 << 32
+        self._last_time = time_us
+        self.seq.append(seq)
+        self.time_us.append(self._time_high + time_us)
+        self.value.append(value)
+
+    def write(self, path):
+        columns = [("seq", "u4", self.seq), ("time_us", "u8", self.time_us), ("value", "i2", self.value)]
+        header = {
+            "format": "m5col",
+            "version": 1,
+            "rows": len(self.seq),
+            "columns": [{"name": n, "type": t} for n, t, _ in columns],
+        }
+        with open(path, "wb") as f:
+            f.write(b"M5COL1\n")
+            f.write(json.dumps(header).encode() + b"\n")
+            for _, _, col in columns:
+                if sys.byteorder != "little":
+                    col = array.array(col.typecode, col)
+                    col.byteswap()
+                col.tofile(f)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("port")
+    parser.add_argument("output")
+    parser.add_argument("--hz", type=int, default=500)
+    parser.add_argument("--seconds", type=float, default=10.0)
+    parser.add_argument("--baud", type=int, default=921600, choices=sorted(BAUDS))
+    args = parser.parse_args()
+
+    fd = open_serial(args.port, 115200)
+    os.write(fd, b"stream %d\n" % args.hz)
+    time.sleep(0.2)
+    termios.tcdrain(fd)
+    set_baud(fd, args.baud)
+    termios.tcflush(fd, termios.TCIFLUSH)
+
+    cols = Columns()
+    buf = bytearray()
+    total_bytes = bad = gaps = 0
+    last_seq = None
+    started = time.monotonic()
+
+    try:
+        while time.monotonic() - started < args.seconds:
+            chunk = os.read(fd, 65536)
+            total_bytes += len(chunk)
+            buf += chunk
+            *frames, buf = buf.split(b"\x00")
+            for frame in frames:
+                payload = decode_frame(bytes(frame)) if frame else None
+                if payload is None or len(payload) != RECORD.size:
+                    bad += 1
+                    continue
+                seq, time_us, value = RECORD.unpack(payload)
+                if last_seq is not None and seq != (last_seq + 1) & 0xFFFFFFFF:
+                    gaps += (seq - last_seq - 1) & 0xFFFFFFFF
+                last_seq = seq
+                cols.append(seq, time_us, value)
+    finally:
+        os.write(fd, b"q")
+        os.close(fd)
+
+    elapsed = time.monotonic() - started
+    cols.write(args.output)
+    rows = len(cols.seq)
+    print("records      %d" % rows)
+    print("rate         %.1f records/s" % (rows / elapsed))
+    print("throughput   %.1f kB/s" % (total_bytes / elapsed / 1000))
+    print("bad frames   %d" % bad)
+    print("missing seq  %d" % gaps)
+    return 0 if rows else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
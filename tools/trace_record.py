@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""
+M5StackTemperature - record a sensor trace from a node over Serial, for replay.
+
+Live, the node is put in record mode ("record" on the console) and prints every raw
+sample as it is taken. From history, the samples still held on the node are dumped
+channel by channel and merged (at one second resolution). Either way the output is a
+trace as in lib/MyNWEN/trace.h, one sample per line in time order:
+
+    <ms since the epoch>,<sensor id>,<value in the history unit>
+
+    tools/trace_record.py /dev/ttyUSB0 field.csv --seconds 3600
+    tools/trace_record.py /dev/ttyUSB0 field.csv --history
+
+The native build replays it through the same pipeline: `program replay field.csv [speed]`.
+"""
+import argparse
+import os
+import struct
+import sys
+import time
+
+from history_dump import CMD_DUMP, ProtocolError, decode_chunk, request
+from m5frame import open_serial
+
+PREFIX = b"T,"
+CHANNELS = 4
+
+
+def record_live(fd, seconds):
+    samples = []
+    os.write(fd, b"record\n")
+    buf = bytearray()
+    deadline = time.monotonic() + seconds if seconds else None
+    try:
+        while deadline is None or time.monotonic() < deadline:
+            buf += os.read(fd, 4096)
+            *lines, buf = buf.split(b"\n")
+            for line in lines:
+                line = line.strip()
+                if not line.startswith(PREFIX):
+                    continue
+                try:
+                    ms, sensor, value = (int(x) for x in line[len(PREFIX):].split(b","))
+                except ValueError:
+                    continue
+                samples.append((ms, sensor, value))
+            sys.stderr.write("\r%d samples" % len(samples))
+    except KeyboardInterrupt:
+        pass
+    finally:
+        os.write(fd, b"record off\n")
+        sys.stderr.write("\n")
+    return samples
+
+
+def record_history(fd):
+    samples = []
+    for channel in range(CHANNELS):
+        parts, _ = request(fd, CMD_DUMP, struct.pack("<HHB", 0, 0xFFFF, channel))
+        for chunk in parts[:-1]:
+            samples += [(t * 1000, channel, value) for _, _, t, value in decode_chunk(chunk)]
+    return samples
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("port")
+    parser.add_argument("output")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--seconds", type=float, default=0, help="stop after (default: Ctrl-C)")
+    parser.add_argument("--history", action="store_true", help="rebuild from history instead")
+    args = parser.parse_args()
+
+    fd = open_serial(args.port, args.baud)
+    try:
+        samples = record_history(fd) if args.history else record_live(fd, args.seconds)
+    except ProtocolError as e:
+        print("error: %s" % e, file=sys.stderr)
+        return 1
+    finally:
+        os.close(fd)
+
+    samples.sort(key=lambda s: (s[0], s[1]))
+    with open(args.output, "w") as f:
+        for sample in samples:
+            f.write("%d,%d,%d\n" % sample)
+    print("samples      %d" % len(samples))
+    if samples:
+        print("span         %.1f h" % ((samples[-1][0] - samples[0][0]) / 3600000.0))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())